@@ -63,7 +63,8 @@ public:
    */
   BucketPrioQueue(); 
 
-  void clear() { buckets.clear(); }
+  //! Removes all elements
+  void clear() { buckets.clear(); nextPop = buckets.end(); count = 0; }
 
   //! Checks whether the Queue is empty
   bool empty();
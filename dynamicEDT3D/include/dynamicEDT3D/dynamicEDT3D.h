@@ -66,6 +66,20 @@ public:
   //! update distance map to reflect the changes
   virtual void update(bool updateRealDist=true);
 
+  //! recompute the whole distance map from the current obstacles instead of propagating the changes
+  /** Uses a separable exact Euclidean distance transform in linear time, which is much faster than update()
+   *  after initialization or when large parts of the map changed. All pending changes are included and
+   *  the result seeds the incremental data, so that subsequent calls of update() continue incrementally.
+   */
+  void updateBatch(bool updateRealDist=true);
+
+  //! shift the map contents by (dx,dy,dz) cells, i.e., the cell that was at (x+dx,y+dy,z+dz) is at (x,y,z) afterwards
+  /** Cells that are shifted out of the map are dropped, newly exposed cells are free.
+   *  Existing cells are moved by rotating the slab pointers instead of copying, and only cells whose
+   *  closest obstacle left the map are scheduled for recomputation. Call update() afterwards.
+   */
+  void shiftMap(int dx, int dy, int dz);
+
   //! returns the obstacle distance at the specified location
   float getDistance( int x, int y, int z ) const;
   //! gets the closest occupied cell for that location
@@ -41,6 +41,10 @@
 #include "dynamicEDT3D.h"
 #include <octomap/OcTree.h>
 #include <octomap/OcTreeStamped.h>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
 
 /// A DynamicEDTOctomapBase object connects a DynamicEDT3D object to an octomap.
 template <class TREE>
@@ -61,6 +65,18 @@ public:
 	///If you set updateRealDist to false, computations will be faster (square root will be omitted), but you can only retrieve squared distances
 	virtual void update(bool updateRealDist=true);
 
+	///recompute the whole distance map instead of propagating the changes, which is much faster right after construction or when large parts
+	///of the octomap changed. Subsequent calls of update() continue incrementally.
+	void updateBatch(bool updateRealDist=true);
+
+	///Moves the bounding box of the distance map to a new minimum corner bbxMin while keeping its size, e.g. to keep a window around a travelling robot.
+	///Distances in the overlap of the old and new bounding box are kept, only the newly exposed slabs are read from the octomap and only
+	///cells close to them are recomputed. Call update() afterwards.
+	void moveBoundingBox(const octomap::point3d& bbxMin);
+
+	///Moves the bounding box of the distance map such that it is centered at center, see moveBoundingBox.
+	void recenter(const octomap::point3d& center);
+
 	///retrieves distance and closestObstacle (closestObstacle is to be discarded if distance is maximum distance, the method does not write closestObstacle in this case).
 	///Returns DynamicEDTOctomapBase::distanceValue_Error if point is outside the map.
 	void getDistanceAndClosestObstacle(const octomap::point3d& p, float &distance, octomap::point3d& closestObstacle) const;
@@ -105,8 +121,11 @@ public:
 	static int distanceInCellsValue_Error;
 
 private:
+	void commitOctreeChanges();
 	void initializeOcTree(octomap::point3d bbxMin, octomap::point3d bbxMax);
-	void insertMaxDepthLeafAtInitialize(octomap::OcTreeKey key);
+	void insertOccupancyInBox(const octomap::OcTreeKey& minKey, const octomap::OcTreeKey& maxKey);
+	void collectLeafBoxes(const typename TREE::NodeType* node, const octomap::OcTreeKey& nodeKey, int depth,
+			const int* gridMin, const int* gridMax, std::vector<std::pair<octomap::OcTreeKey, octomap::OcTreeKey> >& boxes) const;
 	void updateMaxDepthLeaf(octomap::OcTreeKey& key, bool occupied);
 
 	void worldToMap(const octomap::point3d &p, int &x, int &y, int &z) const;
@@ -59,6 +59,18 @@ DynamicEDTOctomapBase<TREE>::~DynamicEDTOctomapBase() {
 
 template <class TREE>
 void DynamicEDTOctomapBase<TREE>::update(bool updateRealDist){
+	commitOctreeChanges();
+	DynamicEDT3D::update(updateRealDist);
+}
+
+template <class TREE>
+void DynamicEDTOctomapBase<TREE>::updateBatch(bool updateRealDist){
+	commitOctreeChanges();
+	DynamicEDT3D::updateBatch(updateRealDist);
+}
+
+template <class TREE>
+void DynamicEDTOctomapBase<TREE>::commitOctreeChanges(){
 
 	for(octomap::KeyBoolMap::const_iterator it = octree->changedKeysBegin(), end=octree->changedKeysEnd(); it!=end; ++it){
 		//the keys in this list all go down to the lowest level!
@@ -79,8 +91,6 @@ void DynamicEDTOctomapBase<TREE>::update(bool updateRealDist){
 		updateMaxDepthLeaf(key, octree->isNodeOccupied(node));
 	}
 	octree->resetChangeDetection();
-
-	DynamicEDT3D::update(updateRealDist);
 }
 
 template <class TREE>
@@ -99,89 +109,185 @@ void DynamicEDTOctomapBase<TREE>::initializeOcTree(octomap::point3d bbxMin, octo
 
 	initializeEmpty(_sizeX, _sizeY, _sizeZ, false);
 
+	insertOccupancyInBox(boundingBoxMinKey, boundingBoxMaxKey);
+}
 
-	if(unknownOccupied == false){
-		for(typename TREE::leaf_bbx_iterator it = octree->begin_leafs_bbx(bbxMin,bbxMax), end=octree->end_leafs_bbx(); it!= end; ++it){
-			if(octree->isNodeOccupied(*it)){
-				int nodeDepth = it.getDepth();
-				if( nodeDepth == treeDepth){
-					insertMaxDepthLeafAtInitialize(it.getKey());
-				} else {
-					int cubeSize = 1 << (treeDepth - nodeDepth);
-					octomap::OcTreeKey key=it.getIndexKey();
-					for(int dx = 0; dx < cubeSize; dx++)
-						for(int dy = 0; dy < cubeSize; dy++)
-							for(int dz = 0; dz < cubeSize; dz++){
-								unsigned short int tmpx = key[0]+dx;
-								unsigned short int tmpy = key[1]+dy;
-								unsigned short int tmpz = key[2]+dz;
-
-								if(boundingBoxMinKey[0] > tmpx || boundingBoxMinKey[1] > tmpy || boundingBoxMinKey[2] > tmpz)
-									continue;
-								if(boundingBoxMaxKey[0] < tmpx || boundingBoxMaxKey[1] < tmpy || boundingBoxMaxKey[2] < tmpz)
-									continue;
-
-								insertMaxDepthLeafAtInitialize(octomap::OcTreeKey(tmpx, tmpy, tmpz));
+template <class TREE>
+void DynamicEDTOctomapBase<TREE>::insertOccupancyInBox(const octomap::OcTreeKey& minKey, const octomap::OcTreeKey& maxKey){
+	//occupancy of the box and a margin of one cell, which is needed to find obstacles that are surrounded by obstacles.
+	//Cells not covered by any leaf are unknown.
+	int gridMin[3], gridMax[3], gridSize[3];
+	for(unsigned int i=0; i<3; i++){
+		gridMin[i] = (int) minKey[i] - 1;
+		gridMax[i] = (int) maxKey[i] + 1;
+		gridSize[i] = gridMax[i] - gridMin[i] + 1;
+	}
+	std::vector<char> grid((size_t) gridSize[0]*gridSize[1]*gridSize[2], unknownOccupied ? 1 : 0);
+
+	//rasterize all leaves that differ from unknown space, whole subtrees of unknown space are skipped
+	std::vector<std::pair<octomap::OcTreeKey, octomap::OcTreeKey> > boxes;
+	if(octree->getRoot()){
+		octomap::OcTreeKey rootKey(1 << (treeDepth-1), 1 << (treeDepth-1), 1 << (treeDepth-1));
+		collectLeafBoxes(octree->getRoot(), rootKey, 0, gridMin, gridMax, boxes);
+	}
+
+	char leafValue = unknownOccupied ? 0 : 1;
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(guided)
+#endif
+	for(int i=0; i<(int) boxes.size(); i++){
+		const octomap::OcTreeKey& boxMin = boxes[i].first;
+		const octomap::OcTreeKey& boxMax = boxes[i].second;
+		for(int kx=boxMin[0]; kx<=boxMax[0]; kx++)
+			for(int ky=boxMin[1]; ky<=boxMax[1]; ky++){
+				char* column = &grid[((size_t) (kx-gridMin[0])*gridSize[1] + (ky-gridMin[1]))*gridSize[2]];
+				for(int kz=boxMin[2]; kz<=boxMax[2]; kz++)
+					column[kz-gridMin[2]] = leafValue;
+			}
+	}
+
+	//obstacles that are surrounded by obstacles do not need to be put in the queues
+	//and are written directly, the others are collected per slice to keep their order
+	int sliceStride = gridSize[1]*gridSize[2];
+	int rowStride = gridSize[2];
+	std::vector<std::vector<INTPOINT3D> > queuedObstacles(gridSize[0]-2);
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(guided)
+#endif
+	for(int gx=1; gx<gridSize[0]-1; gx++){
+		for(int gy=1; gy<gridSize[1]-1; gy++){
+			for(int gz=1; gz<gridSize[2]-1; gz++){
+				const char* cell = &grid[((size_t) gx*gridSize[1] + gy)*gridSize[2] + gz];
+				if(!*cell)
+					continue;
+
+				bool isSurrounded = true;
+				for(int dx=-1; dx<=1 && isSurrounded; dx++)
+					for(int dy=-1; dy<=1 && isSurrounded; dy++)
+						for(int dz=-1; dz<=1; dz++){
+							if(!cell[dx*sliceStride + dy*rowStride + dz]){
+								isSurrounded = false;
+								break;
 							}
+						}
+
+				int x = gridMin[0] + gx + offsetX;
+				int y = gridMin[1] + gy + offsetY;
+				int z = gridMin[2] + gz + offsetZ;
+				if(isSurrounded){
+					dataCell c;
+					c.obstX = x;
+					c.obstY = y;
+					c.obstZ = z;
+					c.sqdist = 0;
+					c.dist = 0.0;
+					c.queueing = fwProcessed;
+					c.needsRaise = false;
+					data[x][y][z] = c;
+				} else {
+					queuedObstacles[gx-1].push_back(INTPOINT3D(x, y, z));
 				}
 			}
 		}
-	} else {
-		octomap::OcTreeKey key;
-		for(int dx=0; dx<sizeX; dx++){
-			key[0] = boundingBoxMinKey[0] + dx;
-			for(int dy=0; dy<sizeY; dy++){
-				key[1] = boundingBoxMinKey[1] + dy;
-				for(int dz=0; dz<sizeZ; dz++){
-					key[2] = boundingBoxMinKey[2] + dz;
-
-					typename TREE::NodeType* node = octree->search(key);
-					if(!node || octree->isNodeOccupied(node)){
-						insertMaxDepthLeafAtInitialize(key);
-					}
-				}
-			}
+	}
+
+	for(unsigned int i=0; i<queuedObstacles.size(); i++)
+		for(unsigned int j=0; j<queuedObstacles[i].size(); j++)
+			setObstacle(queuedObstacles[i][j].x, queuedObstacles[i][j].y, queuedObstacles[i][j].z);
+}
+
+template <class TREE>
+void DynamicEDTOctomapBase<TREE>::collectLeafBoxes(const typename TREE::NodeType* node, const octomap::OcTreeKey& nodeKey, int depth,
+		const int* gridMin, const int* gridMax, std::vector<std::pair<octomap::OcTreeKey, octomap::OcTreeKey> >& boxes) const {
+	//the cube of a node at depth covers size keys per axis, starting half a cube below its center key
+	int size = 1 << (treeDepth - depth);
+	octomap::OcTreeKey boxMin, boxMax;
+	for(unsigned int i=0; i<3; i++){
+		int cubeMin = (int) nodeKey[i] - (size >> 1);
+		int lo = std::max(cubeMin, gridMin[i]);
+		int hi = std::min(cubeMin + size - 1, gridMax[i]);
+		if(lo > hi)
+			return;
+		boxMin[i] = lo;
+		boxMax[i] = hi;
+	}
+
+	if(!octree->nodeHasChildren(node)){
+		if(octree->isNodeOccupied(node) != unknownOccupied)
+			boxes.push_back(std::make_pair(boxMin, boxMax));
+		return;
+	}
+
+	octomap::key_type center_offset_key = (1 << (treeDepth-1)) >> (depth+1);
+	for(unsigned int i=0; i<8; i++){
+		if(octree->nodeChildExists(node, i)){
+			octomap::OcTreeKey childKey;
+			octomap::computeChildKey(i, center_offset_key, nodeKey, childKey);
+			collectLeafBoxes(octree->getNodeChild(node, i), childKey, depth+1, gridMin, gridMax, boxes);
 		}
 	}
 }
 
 template <class TREE>
-void DynamicEDTOctomapBase<TREE>::insertMaxDepthLeafAtInitialize(octomap::OcTreeKey key){
-	bool isSurrounded = true;
+void DynamicEDTOctomapBase<TREE>::moveBoundingBox(const octomap::point3d& bbxMin){
+	octomap::OcTreeKey minKey;
+	if(!octree->coordToKeyChecked(bbxMin, minKey))
+		return;
+
+	int shift[3];
+	octomap::OcTreeKey maxKey;
+	int size[3] = {sizeX, sizeY, sizeZ};
+	for(unsigned int i=0; i<3; i++){
+		//keep the bounding box inside the key range of the tree
+		int maxStart = std::numeric_limits<octomap::key_type>::max() - size[i] + 1;
+		if(minKey[i] > maxStart)
+			minKey[i] = maxStart;
+		maxKey[i] = minKey[i] + size[i] - 1;
+		shift[i] = (int) minKey[i] - (int) boundingBoxMinKey[i];
+	}
+	if(shift[0] == 0 && shift[1] == 0 && shift[2] == 0)
+		return;
 
+	shiftMap(shift[0], shift[1], shift[2]);
 
-	for(int dx=-1; dx<=1; dx++)
-		for(int dy=-1; dy<=1; dy++)
-			for(int dz=-1; dz<=1; dz++){
-				if(dx==0 && dy==0 && dz==0)
-					continue;
-				typename TREE::NodeType* node = octree->search(octomap::OcTreeKey(key[0]+dx, key[1]+dy, key[2]+dz));
-				if((!unknownOccupied && node==NULL) || ((node!=NULL) && (octree->isNodeOccupied(node)==false))){
-					isSurrounded = false;
-					break;
-				}
-			}
+	octomap::OcTreeKey oldMinKey = boundingBoxMinKey;
+	octomap::OcTreeKey oldMaxKey = boundingBoxMaxKey;
+	boundingBoxMinKey = minKey;
+	boundingBoxMaxKey = maxKey;
+	offsetX = -boundingBoxMinKey[0];
+	offsetY = -boundingBoxMinKey[1];
+	offsetZ = -boundingBoxMinKey[2];
 
-	if(isSurrounded){
-		//obstacles that are surrounded by obstacles do not need to be put in the queues,
-		//hence this initialization
-		dataCell c;
-		int x = key[0]+offsetX;
-		int y = key[1]+offsetY;
-		int z = key[2]+offsetZ;
-		c.obstX = x;
-		c.obstY = y;
-		c.obstZ = z;
-		c.sqdist = 0;
-		c.dist = 0.0;
-		c.queueing = fwProcessed;
-		c.needsRaise = false;
-		data[x][y][z] = c;
-	} else {
-		setObstacle(key[0]+offsetX, key[1]+offsetY, key[2]+offsetZ);
+	//read the newly exposed cells as disjoint slabs: the one along x first, then
+	//the remainder along y and z
+	octomap::OcTreeKey boxMin = minKey;
+	octomap::OcTreeKey boxMax = maxKey;
+	for(unsigned int i=0; i<3; i++){
+		if(shift[i] == 0)
+			continue;
+		octomap::OcTreeKey slabMin = boxMin;
+		octomap::OcTreeKey slabMax = boxMax;
+		if(shift[i] > 0){
+			slabMin[i] = std::max((int) oldMaxKey[i] + 1, (int) boxMin[i]);
+			boxMax[i] = slabMin[i] - 1;
+		} else {
+			slabMax[i] = std::min((int) oldMinKey[i] - 1, (int) boxMax[i]);
+			boxMin[i] = slabMax[i] + 1;
+		}
+		insertOccupancyInBox(slabMin, slabMax);
+
+		//no overlap with the old bounding box left
+		if(boxMin[i] > boxMax[i])
+			break;
 	}
 }
 
+template <class TREE>
+void DynamicEDTOctomapBase<TREE>::recenter(const octomap::point3d& center){
+	octomap::point3d halfSize(sizeX*treeResolution/2.0, sizeY*treeResolution/2.0, sizeZ*treeResolution/2.0);
+	moveBoundingBox(center - halfSize);
+}
+
 template <class TREE>
 void DynamicEDTOctomapBase<TREE>::updateMaxDepthLeaf(octomap::OcTreeKey& key, bool occupied){
 	if(occupied)
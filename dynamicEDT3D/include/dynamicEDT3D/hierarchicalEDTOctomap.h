@@ -0,0 +1,143 @@
+/**
+* dynamicEDT3D:
+* A library for incrementally updatable Euclidean distance transforms in 3D.
+* @author C. Sprunk, B. Lau, W. Burgard, University of Freiburg, Copyright (C) 2011.
+* @see http://octomap.sourceforge.net/
+* License: New BSD License
+*/
+
+/*
+ * Copyright (c) 2011-2012, C. Sprunk, B. Lau, W. Burgard, University of Freiburg
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HIERARCHICALEDTOCTOMAP_H_
+#define HIERARCHICALEDTOCTOMAP_H_
+
+#include <octomap/OcTree.h>
+#include <octomap/OcTreeStamped.h>
+#include <algorithm>
+#include <vector>
+
+/// A HierarchicalEDTOctomapBase object answers distance queries directly on an octomap, without a dense grid.
+template <class TREE>
+class HierarchicalEDTOctomapBase {
+public:
+    /** Create a HierarchicalEDTOctomapBase object that answers distance queries in the bounding box given by bbxMin, bbxMax and clamps distances at maxdist.
+     *  treatUnknownAsOccupied configures the treatment of unknown cells in the distance computation. The interface is the same as the one of DynamicEDTOctomapBase, so both can be exchanged.
+     *
+     *  In contrast to DynamicEDTOctomapBase, no occupancy data is copied and no grid is allocated, the memory needed is that of the octree itself.
+     *  Each query searches the octree for the closest obstacle in a branch-and-bound manner: pruned leaves are treated as whole cubes and inner nodes that
+     *  cannot contain an obstacle (their occupancy is the maximum of their children) are skipped. The cost of a query thus depends on the tree structure
+     *  within maxdist of the query point, not on the extent of the map. Distances are exact Euclidean distances between voxel centers.
+     *
+     *  The occupancy of inner nodes has to be up to date, call octree->updateInnerOccupancy() after lazy updates.
+     *
+     *  When unknown space is treated as occupied, free inner nodes may still contain unknown cells. The subtrees that are completely known and free
+     *  are therefore collected when constructing the object and on every call of update(), and the search skips them. Call update() after changing the octomap in this case.
+     */
+	HierarchicalEDTOctomapBase(float maxdist, TREE* _octree, octomap::point3d bbxMin, octomap::point3d bbxMax, bool treatUnknownAsOccupied);
+
+	virtual ~HierarchicalEDTOctomapBase();
+
+	///Queries always reflect the current state of the octomap, so there is nothing to update unless unknown space is treated as occupied.
+	///In that case, the subtrees that are completely known and free are collected again, the queries skip them.
+	virtual void update(bool updateRealDist=true);
+
+	///retrieves distance and closestObstacle (closestObstacle is to be discarded if distance is maximum distance, the method does not write closestObstacle in this case).
+	///Returns HierarchicalEDTOctomapBase::distanceValue_Error if point is outside the map.
+	void getDistanceAndClosestObstacle(const octomap::point3d& p, float &distance, octomap::point3d& closestObstacle) const;
+
+	///retrieves distance at point. Returns HierarchicalEDTOctomapBase::distanceValue_Error if point is outside the map.
+	float getDistance(const octomap::point3d& p) const;
+
+	///retrieves distance at key. Returns HierarchicalEDTOctomapBase::distanceValue_Error if key is outside the map.
+	float getDistance(const octomap::OcTreeKey& k) const;
+
+	///retrieves squared distance in cells at point. Returns HierarchicalEDTOctomapBase::distanceInCellsValue_Error if point is outside the map.
+	int getSquaredDistanceInCells(const octomap::point3d& p) const;
+
+	//variant of getDistanceAndClosestObstacle that ommits the check whether p is inside the area of the distance map. Use only if you are certain that p is covered by the distance map and if you need to save the time of the check.
+	void getDistanceAndClosestObstacle_unsafe(const octomap::point3d& p, float &distance, octomap::point3d& closestObstacle) const;
+
+	//variant of getDistance that ommits the check whether p is inside the area of the distance map. Use only if you are certain that p is covered by the distance map and if you need to save the time of the check.
+	float getDistance_unsafe(const octomap::point3d& p) const;
+
+	//variant of getDistance that ommits the check whether p is inside the area of the distance map. Use only if you are certain that p is covered by the distance map and if you need to save the time of the check.
+	float getDistance_unsafe(const octomap::OcTreeKey& k) const;
+
+	//variant of getSquaredDistanceInCells that ommits the check whether p is inside the area of the distance map. Use only if you are certain that p is covered by the distance map and if you need to save the time of the check.
+	int getSquaredDistanceInCells_unsafe(const octomap::point3d& p) const;
+
+	///retrieve maximum distance value
+	float getMaxDist() const {
+	  return maxDist*octree->getResolution();
+	}
+
+	///retrieve squared maximum distance value in grid cells
+	int getSquaredMaxDistCells() const {
+	  return maxDist_squared;
+	}
+
+	///Brute force method used for debug purposes. Checks consistency between octomap and the data the queries rely on: the occupancy of all inner nodes
+	///covers their occupied children, and the collected free subtrees (only if unknown space is treated as occupied) match the octomap.
+	bool checkConsistency() const;
+
+	///distance value returned when requesting distance for a cell outside the map
+	static float distanceValue_Error;
+	///distance value returned when requesting distance in cell units for a cell outside the map
+	static int distanceInCellsValue_Error;
+
+private:
+	typedef typename TREE::NodeType NodeType;
+
+	bool inBoundingBox(const octomap::OcTreeKey& key) const;
+	int findClosestObstacle(const octomap::OcTreeKey& key, octomap::OcTreeKey& closest) const;
+	void searchChildren(const NodeType* node, const octomap::OcTreeKey& nodeKey, int depth, const octomap::OcTreeKey& key, int& bestSqDist, octomap::OcTreeKey& closest) const;
+	bool clampToCube(const octomap::OcTreeKey& nodeKey, int depth, const octomap::OcTreeKey& key, octomap::OcTreeKey& clamped, int& sqdist) const;
+	bool checkInnerOccupancy(const NodeType* node) const;
+	bool collectKnownFree(const NodeType* node, std::vector<const NodeType*>& knownFree) const;
+	bool isKnownFree(const NodeType* node) const;
+
+	TREE* octree;
+	bool unknownOccupied;
+	int treeDepth;
+	double treeResolution;
+	octomap::OcTreeKey boundingBoxMinKey;
+	octomap::OcTreeKey boundingBoxMaxKey;
+	double maxDist;
+	int maxDist_squared;
+	//maximal inner nodes whose subtrees are completely known and free, sorted by address
+	std::vector<const NodeType*> knownFreeNodes;
+};
+
+typedef HierarchicalEDTOctomapBase<octomap::OcTree> HierarchicalEDTOctomap;
+typedef HierarchicalEDTOctomapBase<octomap::OcTreeStamped> HierarchicalEDTOctomapStamped;
+
+#include "hierarchicalEDTOctomap.hxx"
+
+#endif /* HIERARCHICALEDTOCTOMAP_H_ */
@@ -0,0 +1,309 @@
+/**
+* dynamicEDT3D:
+* A library for incrementally updatable Euclidean distance transforms in 3D.
+* @author C. Sprunk, B. Lau, W. Burgard, University of Freiburg, Copyright (C) 2011.
+* @see http://octomap.sourceforge.net/
+* License: New BSD License
+*/
+
+/*
+ * Copyright (c) 2011-2012, C. Sprunk, B. Lau, W. Burgard, University of Freiburg
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+
+template <class TREE>
+float HierarchicalEDTOctomapBase<TREE>::distanceValue_Error = -1.0;
+
+template <class TREE>
+int HierarchicalEDTOctomapBase<TREE>::distanceInCellsValue_Error = -1;
+
+template <class TREE>
+HierarchicalEDTOctomapBase<TREE>::HierarchicalEDTOctomapBase(float maxdist, TREE* _octree, octomap::point3d bbxMin, octomap::point3d bbxMax, bool treatUnknownAsOccupied)
+: octree(_octree), unknownOccupied(treatUnknownAsOccupied)
+{
+	treeDepth = octree->getTreeDepth();
+	treeResolution = octree->getResolution();
+	int maxDistCells = (int) (maxdist/treeResolution+1);
+	maxDist_squared = maxDistCells*maxDistCells;
+	maxDist = sqrt((double) maxDist_squared);
+	boundingBoxMinKey = octree->coordToKey(bbxMin);
+	boundingBoxMaxKey = octree->coordToKey(bbxMax);
+	update();
+}
+
+template <class TREE>
+HierarchicalEDTOctomapBase<TREE>::~HierarchicalEDTOctomapBase() {
+
+}
+
+template <class TREE>
+void HierarchicalEDTOctomapBase<TREE>::update(bool /*updateRealDist*/){
+	knownFreeNodes.clear();
+	if(!unknownOccupied)
+		return;
+
+	const NodeType* root = octree->getRoot();
+	if(root != NULL && octree->nodeHasChildren(root) && collectKnownFree(root, knownFreeNodes))
+		knownFreeNodes.push_back(root);
+	std::sort(knownFreeNodes.begin(), knownFreeNodes.end());
+}
+
+template <class TREE>
+bool HierarchicalEDTOctomapBase<TREE>::collectKnownFree(const NodeType* node, std::vector<const NodeType*>& knownFree) const {
+	//returns whether the subtree of node is completely known and free, only the topmost of those subtrees are collected
+	if(!octree->nodeHasChildren(node))
+		return !octree->isNodeOccupied(node);
+
+	bool free[8];
+	bool allFree = true;
+	for(unsigned int i=0; i<8; i++){
+		free[i] = octree->nodeChildExists(node, i) && collectKnownFree(octree->getNodeChild(node, i), knownFree);
+		allFree = allFree && free[i];
+	}
+
+	if(!allFree){
+		for(unsigned int i=0; i<8; i++){
+			if(free[i] && octree->nodeHasChildren(octree->getNodeChild(node, i)))
+				knownFree.push_back(octree->getNodeChild(node, i));
+		}
+	}
+	return allFree;
+}
+
+template <class TREE>
+bool HierarchicalEDTOctomapBase<TREE>::isKnownFree(const NodeType* node) const {
+	return std::binary_search(knownFreeNodes.begin(), knownFreeNodes.end(), node);
+}
+
+template <class TREE>
+bool HierarchicalEDTOctomapBase<TREE>::inBoundingBox(const octomap::OcTreeKey& key) const {
+	return key[0] >= boundingBoxMinKey[0] && key[1] >= boundingBoxMinKey[1] && key[2] >= boundingBoxMinKey[2]
+	    && key[0] <= boundingBoxMaxKey[0] && key[1] <= boundingBoxMaxKey[1] && key[2] <= boundingBoxMaxKey[2];
+}
+
+template <class TREE>
+bool HierarchicalEDTOctomapBase<TREE>::clampToCube(const octomap::OcTreeKey& nodeKey, int depth, const octomap::OcTreeKey& key, octomap::OcTreeKey& clamped, int& sqdist) const {
+	//the cube of a node at depth covers size keys per axis, starting half a cube below its center key
+	int size = 1 << (treeDepth - depth);
+	sqdist = 0;
+	for(unsigned int i=0; i<3; i++){
+		//only the part of the cube inside the bounding box is considered
+		int cubeMin = std::max((int) nodeKey[i] - (size >> 1), (int) boundingBoxMinKey[i]);
+		int cubeMax = std::min((int) nodeKey[i] - (size >> 1) + size - 1, (int) boundingBoxMaxKey[i]);
+		if(cubeMin > cubeMax)
+			return false;
+
+		int c = std::min(std::max((int) key[i], cubeMin), cubeMax);
+		clamped[i] = c;
+		sqdist += (c - key[i])*(c - key[i]);
+	}
+	return true;
+}
+
+template <class TREE>
+int HierarchicalEDTOctomapBase<TREE>::findClosestObstacle(const octomap::OcTreeKey& key, octomap::OcTreeKey& closest) const {
+	int bestSqDist = maxDist_squared;
+	const NodeType* root = octree->getRoot();
+	if(root == NULL){
+		//the whole tree is unknown
+		int sqdist;
+		octomap::OcTreeKey rootKey(1 << (treeDepth-1), 1 << (treeDepth-1), 1 << (treeDepth-1));
+		octomap::OcTreeKey clamped;
+		if(unknownOccupied && clampToCube(rootKey, 0, key, clamped, sqdist) && sqdist < bestSqDist){
+			bestSqDist = sqdist;
+			closest = clamped;
+		}
+		return bestSqDist;
+	}
+
+	if(octree->nodeHasChildren(root)){
+		octomap::OcTreeKey rootKey(1 << (treeDepth-1), 1 << (treeDepth-1), 1 << (treeDepth-1));
+		searchChildren(root, rootKey, 0, key, bestSqDist, closest);
+	} else if(octree->isNodeOccupied(root)){
+		//pruned to a single occupied cube, every cell is an obstacle
+		bestSqDist = 0;
+		closest = key;
+	}
+	return bestSqDist;
+}
+
+template <class TREE>
+void HierarchicalEDTOctomapBase<TREE>::searchChildren(const NodeType* node, const octomap::OcTreeKey& nodeKey, int depth, const octomap::OcTreeKey& key, int& bestSqDist, octomap::OcTreeKey& closest) const {
+	//an inner node stores the maximum occupancy of its children, if it is free there is no obstacle below.
+	//With unknown space as obstacles, the subtree additionally has to be completely known.
+	if(!octree->isNodeOccupied(node) && (!unknownOccupied || isKnownFree(node)))
+		return;
+
+	octomap::key_type center_offset_key = (1 << (treeDepth-1)) >> (depth+1);
+	octomap::OcTreeKey childKeys[8];
+	octomap::OcTreeKey clamped[8];
+	int sqdists[8];
+	unsigned int order[8];
+	unsigned int numChildren = 0;
+
+	for(unsigned int i=0; i<8; i++){
+		octomap::computeChildKey(i, center_offset_key, nodeKey, childKeys[i]);
+		int sqdist;
+		if(!clampToCube(childKeys[i], depth+1, key, clamped[i], sqdist) || sqdist >= bestSqDist)
+			continue;
+		sqdists[i] = sqdist;
+
+		//insertion sort, closest children are searched first to tighten the bound early
+		unsigned int pos = numChildren++;
+		while(pos > 0 && sqdists[order[pos-1]] > sqdist){
+			order[pos] = order[pos-1];
+			pos--;
+		}
+		order[pos] = i;
+	}
+
+	for(unsigned int j=0; j<numChildren; j++){
+		unsigned int i = order[j];
+		if(sqdists[i] >= bestSqDist)
+			break;
+
+		if(!octree->nodeChildExists(node, i)){
+			//unknown space
+			if(unknownOccupied){
+				bestSqDist = sqdists[i];
+				closest = clamped[i];
+			}
+			continue;
+		}
+
+		const NodeType* child = octree->getNodeChild(node, i);
+		if(octree->nodeHasChildren(child)){
+			searchChildren(child, childKeys[i], depth+1, key, bestSqDist, closest);
+		} else if(octree->isNodeOccupied(child)){
+			bestSqDist = sqdists[i];
+			closest = clamped[i];
+		}
+	}
+}
+
+template <class TREE>
+bool HierarchicalEDTOctomapBase<TREE>::checkInnerOccupancy(const NodeType* node) const {
+	bool occupied = octree->isNodeOccupied(node);
+	for(unsigned int i=0; i<8; i++){
+		if(!octree->nodeChildExists(node, i))
+			continue;
+		const NodeType* child = octree->getNodeChild(node, i);
+		if(octree->isNodeOccupied(child) && !occupied)
+			return false;
+		if(octree->nodeHasChildren(child) && !checkInnerOccupancy(child))
+			return false;
+	}
+	return true;
+}
+
+template <class TREE>
+void HierarchicalEDTOctomapBase<TREE>::getDistanceAndClosestObstacle(const octomap::point3d& p, float &distance, octomap::point3d& closestObstacle) const {
+	octomap::OcTreeKey key;
+	if(octree->coordToKeyChecked(p, key) && inBoundingBox(key)){
+		getDistanceAndClosestObstacle_unsafe(p, distance, closestObstacle);
+	} else {
+	  distance = distanceValue_Error;
+	}
+}
+
+template <class TREE>
+void HierarchicalEDTOctomapBase<TREE>::getDistanceAndClosestObstacle_unsafe(const octomap::point3d& p, float &distance, octomap::point3d& closestObstacle) const {
+	octomap::OcTreeKey closest;
+	int sqdist = findClosestObstacle(octree->coordToKey(p), closest);
+
+	distance = sqrt((double) sqdist)*treeResolution;
+	if(sqdist < maxDist_squared){
+		closestObstacle = octree->keyToCoord(closest);
+	} else {
+		//If we are at maxDist, there is no valid closest obstacle data for this cell, this is not an error.
+	}
+}
+
+template <class TREE>
+float HierarchicalEDTOctomapBase<TREE>::getDistance(const octomap::point3d& p) const {
+  octomap::OcTreeKey key;
+  if(octree->coordToKeyChecked(p, key) && inBoundingBox(key)){
+      return getDistance_unsafe(key);
+  } else {
+      return distanceValue_Error;
+  }
+}
+
+template <class TREE>
+float HierarchicalEDTOctomapBase<TREE>::getDistance_unsafe(const octomap::point3d& p) const {
+  return getDistance_unsafe(octree->coordToKey(p));
+}
+
+template <class TREE>
+float HierarchicalEDTOctomapBase<TREE>::getDistance(const octomap::OcTreeKey& k) const {
+  if(inBoundingBox(k)){
+      return getDistance_unsafe(k);
+  } else {
+      return distanceValue_Error;
+  }
+}
+
+template <class TREE>
+float HierarchicalEDTOctomapBase<TREE>::getDistance_unsafe(const octomap::OcTreeKey& k) const {
+  octomap::OcTreeKey closest;
+  return sqrt((double) findClosestObstacle(k, closest))*treeResolution;
+}
+
+template <class TREE>
+int HierarchicalEDTOctomapBase<TREE>::getSquaredDistanceInCells(const octomap::point3d& p) const {
+  octomap::OcTreeKey key;
+  if(octree->coordToKeyChecked(p, key) && inBoundingBox(key)){
+    octomap::OcTreeKey closest;
+    return findClosestObstacle(key, closest);
+  } else {
+    return distanceInCellsValue_Error;
+  }
+}
+
+template <class TREE>
+int HierarchicalEDTOctomapBase<TREE>::getSquaredDistanceInCells_unsafe(const octomap::point3d& p) const {
+  octomap::OcTreeKey closest;
+  return findClosestObstacle(octree->coordToKey(p), closest);
+}
+
+template <class TREE>
+bool HierarchicalEDTOctomapBase<TREE>::checkConsistency() const {
+	const NodeType* root = octree->getRoot();
+	if(root == NULL || !octree->nodeHasChildren(root))
+		return knownFreeNodes.empty();
+
+	if(!checkInnerOccupancy(root))
+		return false;
+
+	std::vector<const NodeType*> knownFree;
+	if(unknownOccupied && collectKnownFree(root, knownFree))
+		knownFree.push_back(root);
+	std::sort(knownFree.begin(), knownFree.end());
+	return knownFree == knownFreeNodes;
+}
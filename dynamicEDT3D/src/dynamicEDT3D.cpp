@@ -39,6 +39,8 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <vector>
 
 #define FOR_EACH_NEIGHBOR_WITH_CHECK(function, p, ...) \
 	int x=p.x;\
@@ -335,6 +337,251 @@ void DynamicEDT3D::update(bool updateRealDist) {
 		}
 }
 
+// exact 1D squared distance transform of the sampled function f of length n (lower envelope of
+// parabolas, Felzenszwalb and Huttenlocher), values >= inf are no sites. Writes the squared distance
+// and the position of the closest site to d and arg (inf and -1 if there is none), v and zb are buffers
+// of length n and n+1.
+static void distanceTransform1D(const int* f, int n, int inf, int* d, int* arg, int* v, double* zb) {
+	int k = -1;
+	for (int q=0; q<n; q++) {
+		if (f[q] >= inf) continue;
+		double s = 0.0;
+		while (k >= 0) {
+			int p = v[k];
+			s = ((f[q] + q*q) - (f[p] + p*p)) / (2.0*(q-p));
+			if (s > zb[k]) break;
+			k--;
+		}
+		k++;
+		v[k] = q;
+		zb[k] = (k==0) ? -HUGE_VAL : s;
+		zb[k+1] = HUGE_VAL;
+	}
+
+	if (k < 0) {
+		for (int q=0; q<n; q++) {
+			d[q] = inf;
+			arg[q] = -1;
+		}
+		return;
+	}
+
+	int j = 0;
+	for (int q=0; q<n; q++) {
+		while (zb[j+1] < q) j++;
+		int p = v[j];
+		int dist = (q-p)*(q-p) + f[p];
+		if (dist >= inf) {
+			d[q] = inf;
+			arg[q] = -1;
+		} else {
+			d[q] = dist;
+			arg[q] = p;
+		}
+	}
+}
+
+void DynamicEDT3D::updateBatch(bool updateRealDist) {
+	// pending changes are already reflected by the obstacle data of the cells
+	addList.clear();
+	removeList.clear();
+	open.clear();
+
+	// distances are only needed below maxDist_squared, larger values can be treated as "no site"
+	const int inf = maxDist_squared;
+
+	// pass 1: along z, sqdist and obstZ hold the distance to the closest obstacle in the same column
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(guided)
+#endif
+	for (int x=0; x<sizeX; x++) {
+		std::vector<int> f(sizeZ), d(sizeZ), arg(sizeZ), v(sizeZ);
+		std::vector<double> zb(sizeZ+1);
+		for (int y=0; y<sizeY; y++) {
+			dataCell* column = data[x][y];
+			for (int z=0; z<sizeZ; z++)
+				f[z] = isOccupied(x,y,z,column[z]) ? 0 : inf;
+			distanceTransform1D(&f[0], sizeZ, inf, &d[0], &arg[0], &v[0], &zb[0]);
+			for (int z=0; z<sizeZ; z++) {
+				column[z].sqdist = d[z];
+				column[z].obstZ = arg[z];
+			}
+		}
+	}
+
+	// pass 2: along y, obstY and obstZ now hold the closest obstacle in the same x slice
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(guided)
+#endif
+	for (int x=0; x<sizeX; x++) {
+		std::vector<int> f(sizeY), d(sizeY), arg(sizeY), v(sizeY), featZ(sizeY);
+		std::vector<double> zb(sizeY+1);
+		for (int z=0; z<sizeZ; z++) {
+			for (int y=0; y<sizeY; y++) {
+				f[y] = data[x][y][z].sqdist;
+				featZ[y] = data[x][y][z].obstZ;
+			}
+			distanceTransform1D(&f[0], sizeY, inf, &d[0], &arg[0], &v[0], &zb[0]);
+			for (int y=0; y<sizeY; y++) {
+				dataCell &c = data[x][y][z];
+				c.sqdist = d[y];
+				c.obstY = arg[y];
+				c.obstZ = (arg[y] >= 0) ? featZ[arg[y]] : -1;
+			}
+		}
+	}
+
+	// pass 3: along x, yields the exact distance and closest obstacle, then the cells are
+	// set to the state the incremental update leaves them in
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(guided)
+#endif
+	for (int y=0; y<sizeY; y++) {
+		std::vector<int> f(sizeX), d(sizeX), arg(sizeX), v(sizeX), featY(sizeX), featZ(sizeX);
+		std::vector<double> zb(sizeX+1);
+		for (int z=0; z<sizeZ; z++) {
+			for (int x=0; x<sizeX; x++) {
+				f[x] = data[x][y][z].sqdist;
+				featY[x] = data[x][y][z].obstY;
+				featZ[x] = data[x][y][z].obstZ;
+			}
+			distanceTransform1D(&f[0], sizeX, inf, &d[0], &arg[0], &v[0], &zb[0]);
+			for (int x=0; x<sizeX; x++) {
+				dataCell &c = data[x][y][z];
+				c.needsRaise = false;
+				if (arg[x] >= 0) {
+					c.sqdist = d[x];
+					c.obstX = arg[x];
+					c.obstY = featY[arg[x]];
+					c.obstZ = featZ[arg[x]];
+					if (updateRealDist) c.dist = sqrt((double) d[x]);
+					c.queueing = fwProcessed;
+				} else {
+					c.sqdist = maxDist_squared;
+					c.obstX = invalidObstData;
+					c.obstY = invalidObstData;
+					c.obstZ = invalidObstData;
+					if (updateRealDist) c.dist = maxDist;
+					c.queueing = fwNotQueued;
+				}
+			}
+		}
+	}
+}
+
+// rotates a 3D grid in place such that the element at (x+dx,y+dy,z+dz) ends up at (x,y,z),
+// the x and y dimensions only rotate pointers
+template <class T>
+static void rotateGrid(T*** grid, int sizeX, int sizeY, int sizeZ, int dx, int dy, int dz) {
+	if (dx != 0)
+		std::rotate(grid, grid + (dx+sizeX)%sizeX, grid + sizeX);
+	for (int x=0; x<sizeX; x++) {
+		if (dy != 0)
+			std::rotate(grid[x], grid[x] + (dy+sizeY)%sizeY, grid[x] + sizeY);
+		if (dz != 0) {
+			for (int y=0; y<sizeY; y++)
+				std::rotate(grid[x][y], grid[x][y] + (dz+sizeZ)%sizeZ, grid[x][y] + sizeZ);
+		}
+	}
+}
+
+// shifts a list of cell coordinates and drops the ones that left the map
+static void shiftPointList(std::vector<INTPOINT3D>& points, int dx, int dy, int dz, int sizeX, int sizeY, int sizeZ) {
+	unsigned int kept = 0;
+	for (unsigned int i=0; i<points.size(); i++) {
+		INTPOINT3D p(points[i].x-dx, points[i].y-dy, points[i].z-dz);
+		if (p.x<0 || p.x>=sizeX || p.y<0 || p.y>=sizeY || p.z<0 || p.z>=sizeZ) continue;
+		points[kept++] = p;
+	}
+	points.resize(kept);
+}
+
+void DynamicEDT3D::shiftMap(int dx, int dy, int dz) {
+	if (dx==0 && dy==0 && dz==0) return;
+
+	dataCell emptyCell;
+	emptyCell.dist = maxDist;
+	emptyCell.sqdist = maxDist_squared;
+	emptyCell.obstX = invalidObstData;
+	emptyCell.obstY = invalidObstData;
+	emptyCell.obstZ = invalidObstData;
+	emptyCell.queueing = fwNotQueued;
+	emptyCell.needsRaise = false;
+
+	if (abs(dx)>=sizeX || abs(dy)>=sizeY || abs(dz)>=sizeZ) {
+		// nothing of the old map remains
+		for (int x=0; x<sizeX; x++)
+			for (int y=0; y<sizeY; y++)
+				for (int z=0; z<sizeZ; z++) {
+					data[x][y][z] = emptyCell;
+					if (gridMap) gridMap[x][y][z] = 0;
+				}
+		addList.clear();
+		removeList.clear();
+		lastObstacles.clear();
+		return;
+	}
+
+	// cells queued by a previous shift that was not followed by update()
+	std::vector<INTPOINT3D> queued;
+	while (!open.empty()) queued.push_back(open.pop());
+	shiftPointList(queued, dx, dy, dz, sizeX, sizeY, sizeZ);
+
+	rotateGrid(data, sizeX, sizeY, sizeZ, dx, dy, dz);
+	if (gridMap) rotateGrid(gridMap, sizeX, sizeY, sizeZ, dx, dy, dz);
+
+	shiftPointList(addList, dx, dy, dz, sizeX, sizeY, sizeZ);
+	shiftPointList(removeList, dx, dy, dz, sizeX, sizeY, sizeZ);
+	shiftPointList(lastObstacles, dx, dy, dz, sizeX, sizeY, sizeZ);
+
+	// the last layer of old cells before the exposed ones needs to propagate into them
+	int borderX = dx>0 ? sizeXm1-dx : -dx;
+	int borderY = dy>0 ? sizeYm1-dy : -dy;
+	int borderZ = dz>0 ? sizeZm1-dz : -dz;
+
+	for (int x=0; x<sizeX; x++) {
+		bool exposedX = (x+dx<0 || x+dx>=sizeX);
+		for (int y=0; y<sizeY; y++) {
+			bool exposedXY = exposedX || (y+dy<0 || y+dy>=sizeY);
+			bool borderXY = (dx!=0 && x==borderX) || (dy!=0 && y==borderY);
+			dataCell* column = data[x][y];
+			for (int z=0; z<sizeZ; z++) {
+				if (exposedXY || z+dz<0 || z+dz>=sizeZ) {
+					// recycled cell from the opposite border
+					column[z] = emptyCell;
+					if (gridMap) gridMap[x][y][z] = 0;
+					continue;
+				}
+
+				dataCell &c = column[z];
+				if (c.obstX == invalidObstData) continue;
+				c.obstX -= dx;
+				c.obstY -= dy;
+				c.obstZ -= dz;
+				if (c.obstX<0 || c.obstX>=sizeX || c.obstY<0 || c.obstY>=sizeY || c.obstZ<0 || c.obstZ>=sizeZ) {
+					// the closest obstacle left the map, raise the cell on the next update
+					c.obstX = invalidObstData;
+					c.obstY = invalidObstData;
+					c.obstZ = invalidObstData;
+					c.queueing = bwQueued;
+					removeList.push_back(INTPOINT3D(x,y,z));
+				} else if (borderXY || (dz!=0 && z==borderZ)) {
+					// not marked as fwQueued, the cell may still become an obstacle before update()
+					open.push(c.sqdist, INTPOINT3D(x,y,z));
+					c.queueing = fwNotQueued;
+				}
+			}
+		}
+	}
+
+	for (unsigned int i=0; i<queued.size(); i++) {
+		INTPOINT3D &p = queued[i];
+		dataCell &c = data[p.x][p.y][p.z];
+		if (c.obstX != invalidObstData)
+			open.push(c.sqdist, p);
+	}
+}
+
 void DynamicEDT3D::raiseCell(INTPOINT3D &p, dataCell &c, bool updateRealDist){
 	/*
 	for (int dx=-1; dx<=1; dx++) {
@@ -71,9 +71,12 @@ int main( int argc, char *argv[] ) {
   //- arguments 3 and 4 can be used to restrict the distance map to a subarea
   //- argument 5 defines whether unknown space is treated as occupied or free
   //The constructor copies data but does not yet compute the distance map
+  //For very large maps, HierarchicalEDTOctomap (hierarchicalEDTOctomap.h) offers the same interface,
+  //it answers each query directly on the octree instead of allocating a dense grid
   DynamicEDTOctomap distmap(maxDist, tree, min, max, unknownAsOccupied);
 
-  //This computes the distance map
+  //This computes the distance map. For the first computation, distmap.updateBatch() computes
+  //the same result faster, later calls of update() then continue incrementally
   distmap.update(); 
 
   //This is how you can query the map
@@ -95,6 +98,10 @@ int main( int argc, char *argv[] ) {
   //if you modify the octree via tree->insertScan() or tree->updateNode()
   //just call distmap.update() again to adapt the distance map to the changes made
 
+  //to maintain a distance map around a moving robot, create it for a window around the robot
+  //and move the window with distmap.recenter(robotPosition) followed by distmap.update().
+  //Only the newly exposed parts of the window are then read from the octree.
+
   delete tree;
 
   return 0;
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dynamicEDT3D/dynamicEDTOctomap.h>
+#include <dynamicEDT3D/hierarchicalEDTOctomap.h>
+#include "testing.h"
+
+using namespace std;
+using namespace octomap;
+
+// random obstacles in a world that is larger than the distance maps
+static const int worldX = 48, worldY = 40, worldZ = 32;
+
+static vector<bool> makeWorld(double density) {
+  srand(42);
+  vector<bool> world(worldX*worldY*worldZ);
+  for (size_t i = 0; i < world.size(); ++i)
+    world[i] = (rand() < density * RAND_MAX);
+  return world;
+}
+
+static bool worldOccupied(const vector<bool>& world, int x, int y, int z) {
+  if (x < 0 || x >= worldX || y < 0 || y >= worldY || z < 0 || z >= worldZ)
+    return false;
+  return world[(x*worldY + y)*worldZ + z];
+}
+
+// occupies all cells of the window at (ox,oy,oz) that are obstacles in the world,
+// optionally only the cells that are not in the window at (px,py,pz)
+static void occupyWindow(DynamicEDT3D& edt, const vector<bool>& world, int ox, int oy, int oz,
+                         bool onlyNew = false, int px = 0, int py = 0, int pz = 0) {
+  for (int x = 0; x < (int) edt.getSizeX(); ++x) {
+    for (int y = 0; y < (int) edt.getSizeY(); ++y) {
+      for (int z = 0; z < (int) edt.getSizeZ(); ++z) {
+        if (onlyNew) {
+          int sx = x + ox - px, sy = y + oy - py, sz = z + oz - pz;
+          if (sx >= 0 && sx < (int) edt.getSizeX() && sy >= 0 && sy < (int) edt.getSizeY()
+              && sz >= 0 && sz < (int) edt.getSizeZ())
+            continue;
+        }
+        if (worldOccupied(world, x + ox, y + oy, z + oz))
+          edt.occupyCell(x, y, z);
+      }
+    }
+  }
+}
+
+static bool sameDistances(const DynamicEDT3D& a, const DynamicEDT3D& b) {
+  for (int x = 0; x < (int) a.getSizeX(); ++x) {
+    for (int y = 0; y < (int) a.getSizeY(); ++y) {
+      for (int z = 0; z < (int) a.getSizeZ(); ++z) {
+        if (a.getSQCellDistance(x, y, z) != b.getSQCellDistance(x, y, z)) {
+          std::cerr << "distance mismatch at " << x << " " << y << " " << z << ": "
+                    << a.getSQCellDistance(x, y, z) << " != " << b.getSQCellDistance(x, y, z) << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+static void fillTree(OcTree& tree, const vector<bool>& world) {
+  for (int x = 0; x < worldX; ++x)
+    for (int y = 0; y < worldY; ++y)
+      for (int z = 0; z < worldZ; ++z)
+        if (worldOccupied(world, x, y, z))
+          tree.updateNode(point3d(x + 0.5f, y + 0.5f, z + 0.5f), true);
+}
+
+static bool sameDistances(const DynamicEDTOctomap& a, const DynamicEDTOctomap& b,
+                          const point3d& bbxMin, const point3d& bbxMax) {
+  for (float x = bbxMin.x() + 0.5f; x < bbxMax.x(); x += 1.0f) {
+    for (float y = bbxMin.y() + 0.5f; y < bbxMax.y(); y += 1.0f) {
+      for (float z = bbxMin.z() + 0.5f; z < bbxMax.z(); z += 1.0f) {
+        point3d p(x, y, z);
+        if (a.getSquaredDistanceInCells(p) != b.getSquaredDistanceInCells(p)) {
+          std::cerr << "distance mismatch at " << p << ": " << a.getSquaredDistanceInCells(p)
+                    << " != " << b.getSquaredDistanceInCells(p) << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+
+  if (argc != 2){
+    std::cerr << "Error: you need to specify a test as argument" << std::endl;
+    return 1; // exit 1 means failure
+  }
+  std::string test_name (argv[1]);
+
+
+  // ------------------------------------------------------------
+  if (test_name == "ShiftMap") {
+    vector<bool> world = makeWorld(0.01);
+    DynamicEDT3D edt (100);
+    edt.initializeEmpty(24, 20, 16);
+    occupyWindow(edt, world, 10, 10, 8);
+    edt.update();
+
+    // shifts along single axes, several axes, in both directions and without update in between
+    const int shifts[][3] = {{3,0,0}, {0,-2,0}, {0,0,5}, {-4,3,-2}, {1,1,1}, {-7,-5,-3}};
+    const int num_shifts = sizeof(shifts) / sizeof(shifts[0]);
+    int ox = 10, oy = 10, oz = 8;
+    for (int i = 0; i < num_shifts; ++i) {
+      int dx = shifts[i][0], dy = shifts[i][1], dz = shifts[i][2];
+      edt.shiftMap(dx, dy, dz);
+      occupyWindow(edt, world, ox + dx, oy + dy, oz + dz, true, ox, oy, oz);
+      ox += dx; oy += dy; oz += dz;
+      if (i == 3) // two shifts before one update
+        continue;
+      edt.update();
+
+      DynamicEDT3D fresh (100);
+      fresh.initializeEmpty(24, 20, 16);
+      occupyWindow(fresh, world, ox, oy, oz);
+      fresh.update();
+      EXPECT_TRUE (sameDistances(edt, fresh));
+    }
+
+    // a shift by more than the map size drops everything
+    edt.shiftMap(30, 0, 0);
+    occupyWindow(edt, world, ox + 30, oy, oz);
+    edt.update();
+    DynamicEDT3D fresh (100);
+    fresh.initializeEmpty(24, 20, 16);
+    occupyWindow(fresh, world, ox + 30, oy, oz);
+    fresh.update();
+    EXPECT_TRUE (sameDistances(edt, fresh));
+
+  // ------------------------------------------------------------
+  } else if (test_name == "UpdateBatch") {
+    vector<bool> world = makeWorld(0.01);
+    DynamicEDT3D edt (100);
+    edt.initializeEmpty(24, 20, 16);
+    occupyWindow(edt, world, 10, 10, 8);
+    edt.updateBatch();
+
+    DynamicEDT3D fresh (100);
+    fresh.initializeEmpty(24, 20, 16);
+    occupyWindow(fresh, world, 10, 10, 8);
+    fresh.update();
+    EXPECT_TRUE (sameDistances(edt, fresh));
+
+    // a shift queues cells, which the batch update drops
+    edt.shiftMap(3, -2, 1);
+    occupyWindow(edt, world, 13, 8, 9, true, 10, 10, 8);
+    edt.updateBatch();
+
+    // incremental updates continue from the batch result
+    edt.occupyCell(5, 5, 5);
+    edt.occupyCell(20, 3, 12);
+    edt.update();
+    edt.clearCell(20, 3, 12);
+    edt.update();
+
+    DynamicEDT3D shifted (100);
+    shifted.initializeEmpty(24, 20, 16);
+    occupyWindow(shifted, world, 13, 8, 9);
+    shifted.occupyCell(5, 5, 5);
+    shifted.update();
+    EXPECT_TRUE (sameDistances(edt, shifted));
+
+  // ------------------------------------------------------------
+  } else if (test_name == "MoveBoundingBox") {
+    vector<bool> world = makeWorld(0.01);
+    OcTree tree (1.0);
+    fillTree(tree, world);
+
+    point3d size (16.0f, 12.0f, 10.0f);
+    point3d bbxMin (8.0f, 8.0f, 6.0f);
+    DynamicEDTOctomap edt (8.0f, &tree, bbxMin, bbxMin + size, false);
+    edt.update();
+
+    point3d moves[] = {point3d(3.0f, 0.0f, 0.0f), point3d(-2.0f, 4.0f, 1.0f), point3d(0.0f, -3.0f, -5.0f)};
+    for (int i = 0; i < 3; ++i) {
+      bbxMin += moves[i];
+      edt.moveBoundingBox(bbxMin);
+      edt.update();
+      DynamicEDTOctomap fresh (8.0f, &tree, bbxMin, bbxMin + size, false);
+      fresh.update();
+      EXPECT_TRUE (sameDistances(edt, fresh, bbxMin, bbxMin + size));
+    }
+
+    point3d center (20.0f, 21.0f, 14.0f);
+    edt.recenter(center);
+    edt.update();
+    // the map covers one more cell than size along each axis
+    bbxMin = center - (size + point3d(1.0f, 1.0f, 1.0f)) * 0.5f;
+    DynamicEDTOctomap fresh (8.0f, &tree, bbxMin, bbxMin + size, false);
+    fresh.update();
+    EXPECT_TRUE (sameDistances(edt, fresh, bbxMin, bbxMin + size));
+
+  // ------------------------------------------------------------
+  } else if (test_name == "HierarchicalEDT") {
+    vector<bool> world = makeWorld(0.002);
+    OcTree tree (1.0);
+    // known free space in one part of the world, the rest stays unknown
+    for (int x = 0; x < 32; ++x)
+      for (int y = 0; y < 32; ++y)
+        for (int z = 0; z < 16; ++z)
+          if (!worldOccupied(world, x, y, z))
+            tree.updateNode(point3d(x + 0.5f, y + 0.5f, z + 0.5f), false);
+    fillTree(tree, world);
+
+    point3d bbxMin (2.0f, 3.0f, 1.0f);
+    point3d bbxMax (37.0f, 30.0f, 20.0f);
+    for (int unknown_occupied = 0; unknown_occupied < 2; ++unknown_occupied) {
+      DynamicEDTOctomap dense (6.0f, &tree, bbxMin, bbxMax, unknown_occupied == 1);
+      dense.update();
+      HierarchicalEDTOctomap hierarchical (6.0f, &tree, bbxMin, bbxMax, unknown_occupied == 1);
+      EXPECT_TRUE (hierarchical.checkConsistency());
+      EXPECT_EQ (dense.getSquaredMaxDistCells(), hierarchical.getSquaredMaxDistCells());
+
+      for (float x = bbxMin.x() + 0.5f; x < bbxMax.x() + 1.0f; x += 1.0f) {
+        for (float y = bbxMin.y() + 0.5f; y < bbxMax.y() + 1.0f; y += 1.0f) {
+          for (float z = bbxMin.z() + 0.5f; z < bbxMax.z() + 1.0f; z += 1.0f) {
+            point3d p(x, y, z);
+            EXPECT_EQ (dense.getSquaredDistanceInCells(p), hierarchical.getSquaredDistanceInCells(p));
+            EXPECT_FLOAT_EQ (dense.getDistance(p), hierarchical.getDistance(p));
+          }
+        }
+      }
+      EXPECT_EQ (hierarchical.getSquaredDistanceInCells(bbxMax + point3d(1.0f, 1.0f, 1.0f)),
+                 HierarchicalEDTOctomap::distanceInCellsValue_Error);
+    }
+
+    // the free subtrees are collected again after changing the octomap
+    HierarchicalEDTOctomap hierarchical (6.0f, &tree, bbxMin, bbxMax, true);
+    point3d obstacle (10.5f, 10.5f, 10.5f);
+    tree.updateNode(obstacle, true);
+    hierarchical.update();
+    EXPECT_TRUE (hierarchical.checkConsistency());
+    EXPECT_FLOAT_EQ (hierarchical.getDistance(obstacle), 0.0f);
+
+  // ------------------------------------------------------------
+  } else {
+    std::cerr << "Invalid test name specified: " << test_name << std::endl;
+    return 1;
+
+  }
+
+  std::cerr << "Test successful.\n";
+  return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OCTOMAP_INDEXED_SCANGRAPH_H
+#define OCTOMAP_INDEXED_SCANGRAPH_H
+
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+
+#include "ScanGraph.h"
+
+
+namespace octomap {
+
+  /**
+   * Read-only access to scan graph files which are too large to be kept in
+   * memory. Node poses and edges are read when opening the file, the point
+   * clouds stay in the file (memory-mapped where supported) and are only read
+   * on request with readScan(). Iterating over all scans thus needs memory for
+   * a single scan at a time:
+   *
+   * \code
+   * IndexedScanGraph graph("log.igraph");
+   * Pointcloud scan;
+   * for (size_t i = 0; i < graph.size(); ++i) {
+   *   graph.readScan(i, scan);
+   *   tree.insertPointCloud(scan, point3d(0,0,0), graph.getNode(i).pose);
+   * }
+   * \endcode
+   *
+   * Both regular binary ScanGraph files (.graph) and the indexed format written
+   * by write() are supported. Regular files are indexed on open() by skipping
+   * over the scans. The indexed format stores the points with single precision
+   * (less than half the size) followed by an index of all nodes and edges:
+   *
+   * header | scan_1 | ... | scan_n | n | node_1 | ... | node_n | m | edge_1 | ... | edge_m | index offset
+   *
+   * Reading with the memory mapping is thread-safe, the fallback reading from
+   * a file stream (where mapping is not available) is not.
+   */
+  class IndexedScanGraph {
+  public:
+
+    /// index entry of a ScanNode, the scan itself remains in the file
+    struct NodeInfo {
+      unsigned int id;
+      pose6d pose; ///< 6D pose from which the scan was performed
+      uint64_t num_points;
+      uint64_t offset; ///< file offset of the first point
+    };
+
+    /// a ScanEdge, the nodes are referenced by their ids
+    struct EdgeInfo {
+      unsigned int first_id;
+      unsigned int second_id;
+      pose6d constraint;
+      double weight;
+    };
+
+    IndexedScanGraph();
+    /// opens filename, check with isOpen()
+    IndexedScanGraph(const std::string& filename);
+    ~IndexedScanGraph();
+
+    /// Reads the index of a .graph or indexed graph file, previously opened files are closed
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const { return format != FORMAT_NONE; }
+    /// \return true if the opened file is in the indexed format (and not a regular .graph)
+    bool isIndexedFormat() const { return format == FORMAT_INDEXED; }
+    /// \return true if the scans are read from a memory mapping, which is thread-safe
+    bool isMapped() const { return mapped_data != NULL; }
+
+    /// number of nodes
+    size_t size() const { return nodes.size(); }
+    /// index entry of the node at index (0..size()-1), in file order
+    const NodeInfo& getNode(size_t index) const { return nodes[index]; }
+    /// \return index of the node with the given id, or size() if there is none
+    size_t findNode(unsigned int id) const;
+    /// number of points in all scans up to and including the one with max_id (see ScanGraph::getNumPoints)
+    size_t getNumPoints(unsigned int max_id = -1) const;
+
+    size_t numEdges() const { return edges.size(); }
+    const EdgeInfo& getEdge(size_t index) const { return edges[index]; }
+
+    /**
+     * Reads the scan of the node at index from the file, in the node's local
+     * coordinates. The mapped pages are released afterwards, so memory stays
+     * bounded when streaming through the graph.
+     *
+     * @param index of the node (0..size()-1)
+     * @param scan replaced by the points of the node
+     * @return false on read errors
+     */
+    bool readScan(size_t index, Pointcloud& scan) const;
+    /// Reads the node at index including its scan, the caller takes ownership (NULL on errors)
+    ScanNode* readNode(size_t index) const;
+    /// Reads the node with the given id including its scan, the caller takes ownership (NULL on errors)
+    ScanNode* readNodeByID(unsigned int id) const;
+
+    /// Reads all nodes and edges into graph (which is cleared before), node ids are kept
+    bool readScanGraph(ScanGraph& graph) const;
+
+    /// Writes the opened graph in the indexed format, scan by scan
+    bool write(const std::string& filename) const;
+    /// Writes graph in the indexed format
+    static bool write(const ScanGraph& graph, const std::string& filename);
+
+  protected:
+    enum Format {
+      FORMAT_NONE,
+      FORMAT_GRAPH,   ///< regular binary ScanGraph
+      FORMAT_INDEXED
+    };
+
+    bool readGraphIndex(std::istream& s);
+    bool readIndexedIndex(std::istream& s);
+    bool mapFile(const std::string& filename);
+    bool readBytes(uint64_t offset, uint64_t length, char* data) const;
+    void releaseBytes(uint64_t offset, uint64_t length) const;
+
+    static std::ostream& writeHeader(std::ostream& s);
+    static std::ostream& writeScan(std::ostream& s, const Pointcloud& scan);
+    static std::ostream& writeIndex(std::ostream& s, const std::vector<NodeInfo>& nodes,
+                                    const std::vector<EdgeInfo>& edges);
+
+    Format format;
+    std::vector<NodeInfo> nodes;
+    std::vector<EdgeInfo> edges;
+    std::map<unsigned int, size_t> node_index; ///< node id -> index in nodes
+
+    const char* mapped_data;
+    uint64_t mapped_size;
+    mutable std::ifstream file; ///< used for reading scans if mapping fails
+
+  private:
+    // not copyable, owns the file mapping
+    IndexedScanGraph(const IndexedScanGraph&);
+    IndexedScanGraph& operator=(const IndexedScanGraph&);
+  };
+
+} // end namespace
+
+#endif
@@ -351,5 +351,23 @@ namespace octomap {
 		point3d(-1, 1, 0),
 	};
 
+	/// Corners of the unit cube as numbered in the tables
+	static const unsigned int cornerOffsets[8][3] =
+	{
+		{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+		{0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}
+	};
+
+	/// Corners of the edges as numbered in the tables, from the lower to the upper corner along the edge
+	static const unsigned int edgeCorners[12][2] =
+	{
+		{0, 1}, {1, 2}, {3, 2}, {0, 3},
+		{4, 5}, {5, 6}, {7, 6}, {4, 7},
+		{0, 4}, {1, 5}, {2, 6}, {3, 7}
+	};
+
+	/// Axis of the edges as numbered in the tables
+	static const unsigned int edgeAxis[12] = {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2};
+
  }
 #endif
@@ -40,6 +40,7 @@
 #include <iterator>
 #include <stack>
 #include <bitset>
+#include <vector>
 
 #include "octomap_types.h"
 #include "OcTreeKey.h"
@@ -51,6 +52,14 @@ namespace octomap {
   // forward declaration for NODE children array
   class AbstractOcTreeNode;
 
+  /// Cube of unknown space (a node which does not exist), see OcTreeBaseImpl::getUnknownCubes()
+  struct UnknownCube {
+    /// key of the cube's center at its depth, see OcTreeBaseImpl::keyToCoord(const OcTreeKey&, unsigned)
+    OcTreeKey key;
+    /// depth of the cube, its edge length is OcTreeBaseImpl::getNodeSize(depth)
+    unsigned int depth;
+  };
+
 
   /**
    * OcTree base class, to be used with with any kind of OcTreeDataNode.
@@ -274,9 +283,33 @@ namespace octomap {
 
     // -- access tree nodes  ------------------
 
-    /// return centers of leafs that do NOT exist (but could) in a given bounding box
+    /**
+     * Return centers of leafs at the given depth that do NOT exist (but could)
+     * in a given bounding box (including pmin and pmax). Based on
+     * getUnknownCubes(), the runtime depends on the tree and the number of
+     * returned centers instead of the volume of the bounding box.
+     */
     void getUnknownLeafCenters(point3d_list& node_centers, point3d pmin, point3d pmax, unsigned int depth = 0) const;
 
+    /**
+     * Extracts the maximal cubes of unknown space intersecting a bounding box,
+     * i.e., the missing children of existing nodes at any depth (or the whole
+     * tree when it is empty), in a single traversal of the tree. Cubes are
+     * returned as a whole, they may extend over the bounding box.
+     *
+     * @param cubes unknown cubes are appended to this vector
+     * @param bbx_min minimum key of the bounding box (included)
+     * @param bbx_max maximum key of the bounding box (included)
+     * @param max_depth maximum depth of returned cubes, smaller unknown cubes are
+     *   skipped (minimum size getNodeSize(max_depth)). Default (0) = tree depth.
+     */
+    void getUnknownCubes(std::vector<UnknownCube>& cubes, const OcTreeKey& bbx_min, const OcTreeKey& bbx_max,
+                         unsigned int max_depth = 0) const;
+
+    /// Same as getUnknownCubes(std::vector<UnknownCube>&, const OcTreeKey&, const OcTreeKey&, unsigned int) with a metric bounding box
+    void getUnknownCubes(std::vector<UnknownCube>& cubes, const point3d& bbx_min, const point3d& bbx_max,
+                         unsigned int max_depth = 0) const;
+
 
     // -- raytracing  -----------------------
 
@@ -349,6 +382,48 @@ namespace octomap {
     /// @return end of the tree as iterator to all nodes (incl. inner)
     const tree_iterator end_tree() const {return tree_iterator_end;}
 
+    /// Root node of a subtree with its key and depth, see getSubtrees()
+    typedef typename iterator_base::StackElement Subtree;
+
+    /**
+     * Splits a traversal of the tree into independent ranges: the roots of at least
+     * num_subtrees subtrees (if the tree is deep enough), in depth-first order. The tree is
+     * split at the smallest depth with enough nodes, leafs above that depth are subtrees on
+     * their own. Iterators over the subtrees (e.g. leaf_iterator(tree, subtree, maxDepth))
+     * traverse disjoint parts of the tree, which together contain all leafs.
+     *
+     * @param subtrees vector to store the subtree roots
+     * @param num_subtrees minimum number of subtrees
+     * @param maxDepth maximum depth of the subtree roots, should be the same as for the
+     *   iterators. 0 (default): tree depth
+     */
+    void getSubtrees(std::vector<Subtree>& subtrees, size_t num_subtrees, unsigned char maxDepth=0) const;
+
+    /// Same as getSubtrees(std::vector<Subtree>&, size_t, unsigned char), only subtrees intersecting the bounding box (keys included)
+    void getSubtrees(std::vector<Subtree>& subtrees, size_t num_subtrees, const OcTreeKey& min, const OcTreeKey& max,
+                     unsigned char maxDepth=0) const;
+
+    /**
+     * Calls functor(it) for all leafs of the tree, with it as the iterator_base of a leaf
+     * iterator at the leaf. The subtrees (see getSubtrees()) are traversed in parallel with
+     * OpenMP. Each thread calls its own copy of functor, so the functor needs no locking,
+     * and the copies are merged with combine(result, thread_functor) into a copy of functor,
+     * which is returned. As in an OpenMP reduction, functor should be in its initial state,
+     * e.g. a counter at 0, and combine needs to be associative and commutative.
+     */
+    template <class FUNCTOR, class COMBINE>
+    FUNCTOR parallel_for_each_leaf(const FUNCTOR& functor, COMBINE combine, unsigned char maxDepth=0) const;
+
+    /// Same as parallel_for_each_leaf(const FUNCTOR&, COMBINE, unsigned char) for the leafs in a bounding box (keys included, see leaf_bbx_iterator)
+    template <class FUNCTOR, class COMBINE>
+    FUNCTOR parallel_for_each_leaf(const OcTreeKey& min, const OcTreeKey& max, const FUNCTOR& functor, COMBINE combine,
+                                   unsigned char maxDepth=0) const;
+
+    /// Same as parallel_for_each_leaf(const FUNCTOR&, COMBINE, unsigned char) for the leafs in a bounding box (see leaf_bbx_iterator)
+    template <class FUNCTOR, class COMBINE>
+    FUNCTOR parallel_for_each_leaf(const point3d& min, const point3d& max, const FUNCTOR& functor, COMBINE combine,
+                                   unsigned char maxDepth=0) const;
+
     //
     // Key / coordinate conversion functions
     //
@@ -531,6 +606,11 @@ namespace octomap {
     
     size_t getNumLeafNodesRecurs(const NODE* parent) const;
 
+    /// recursive call of getUnknownCubes(), node_min is the minimum key within node
+    void getUnknownCubesRecurs(const NODE* node, unsigned int depth, const OcTreeKey& node_min,
+                               const OcTreeKey& bbx_min, const OcTreeKey& bbx_max, unsigned int max_depth,
+                               std::vector<UnknownCube>& cubes) const;
+
   private:
     /// Assignment operator is private: don't (re-)assign octrees
     /// (const-parameters can't be changed) -  use the copy constructor instead.
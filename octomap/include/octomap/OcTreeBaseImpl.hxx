@@ -1048,36 +1048,108 @@ namespace octomap {
     assert(depth <= tree_depth);
     if (depth == 0)
       depth = tree_depth;
-    
-    point3d pmin_clamped = this->keyToCoord(this->coordToKey(pmin, depth), depth);
-    point3d pmax_clamped = this->keyToCoord(this->coordToKey(pmax, depth), depth);    
-    
-    float diff[3];
-    unsigned int steps[3];
-    float step_size = this->resolution * pow(2, tree_depth-depth);
-    for (int i=0;i<3;++i) {
-      diff[i] = pmax_clamped(i) - pmin_clamped(i);
-      steps[i] = floor(diff[i] / step_size);
-      //      std::cout << "bbx " << i << " size: " << diff[i] << " " << steps[i] << " steps\n";
+
+    OcTreeKey bbx_min, bbx_max;
+    if (!this->coordToKeyChecked(pmin, bbx_min) || !this->coordToKeyChecked(pmax, bbx_max)) {
+      OCTOMAP_ERROR_STR("Bounding box " << pmin << " - " << pmax << " is out of the tree bounds in getUnknownLeafCenters");
+      return;
     }
-    
-    point3d p = pmin_clamped;
-    NODE* res;
-    for (unsigned int x=0; x<steps[0]; ++x) {
-      p.x() += step_size;
-      for (unsigned int y=0; y<steps[1]; ++y) {
-        p.y() += step_size;
-        for (unsigned int z=0; z<steps[2]; ++z) {
-          //          std::cout << "querying p=" << p << std::endl;
-          p.z() += step_size;
-          res = this->search(p,depth);
-          if (res == NULL) {
-            node_centers.push_back(p);
+
+    std::vector<UnknownCube> cubes;
+    getUnknownCubes(cubes, bbx_min, bbx_max, depth);
+
+    // enumerate the leafs at depth within each cube and the bounding box
+    const unsigned int leaf_size = 1 << (tree_depth - depth);
+    for (size_t c = 0; c < cubes.size(); ++c) {
+      const unsigned int cube_size = 1 << (tree_depth - cubes[c].depth);
+      unsigned int from[3], to[3];
+      for (unsigned int i = 0; i < 3; ++i) {
+        unsigned int cube_min = (cube_size == 1) ? cubes[c].key[i] : cubes[c].key[i] - cube_size/2;
+        from[i] = std::max(cube_min, (unsigned int) bbx_min[i]) / leaf_size * leaf_size;
+        to[i] = std::min(cube_min + cube_size - 1, (unsigned int) bbx_max[i]);
+      }
+      OcTreeKey key;
+      for (unsigned int x = from[0]; x <= to[0]; x += leaf_size) {
+        key[0] = (key_type) x;
+        for (unsigned int y = from[1]; y <= to[1]; y += leaf_size) {
+          key[1] = (key_type) y;
+          for (unsigned int z = from[2]; z <= to[2]; z += leaf_size) {
+            key[2] = (key_type) z;
+            node_centers.push_back(this->keyToCoord(this->adjustKeyAtDepth(key, depth), depth));
           }
         }
-        p.z() = pmin_clamped.z();
       }
-      p.y() = pmin_clamped.y();
+    }
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::getUnknownCubes(std::vector<UnknownCube>& cubes, const OcTreeKey& bbx_min,
+                                               const OcTreeKey& bbx_max, unsigned int max_depth) const {
+    assert(max_depth <= tree_depth);
+    if (max_depth == 0)
+      max_depth = tree_depth;
+
+    for (unsigned int i = 0; i < 3; ++i) {
+      if (bbx_min[i] > bbx_max[i])
+        return;
+    }
+
+    if (root == NULL) {
+      UnknownCube cube;
+      cube.key = OcTreeKey(tree_max_val, tree_max_val, tree_max_val);
+      cube.depth = 0;
+      cubes.push_back(cube);
+    }
+    else if (nodeHasChildren(root)) {
+      getUnknownCubesRecurs(root, 0, OcTreeKey(0, 0, 0), bbx_min, bbx_max, max_depth, cubes);
+    }
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::getUnknownCubes(std::vector<UnknownCube>& cubes, const point3d& bbx_min,
+                                               const point3d& bbx_max, unsigned int max_depth) const {
+    OcTreeKey min_key, max_key;
+    if (!this->coordToKeyChecked(bbx_min, min_key) || !this->coordToKeyChecked(bbx_max, max_key)) {
+      OCTOMAP_ERROR_STR("Bounding box " << bbx_min << " - " << bbx_max << " is out of the tree bounds in getUnknownCubes");
+      return;
+    }
+    getUnknownCubes(cubes, min_key, max_key, max_depth);
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::getUnknownCubesRecurs(const NODE* node, unsigned int depth, const OcTreeKey& node_min,
+                                                     const OcTreeKey& bbx_min, const OcTreeKey& bbx_max,
+                                                     unsigned int max_depth, std::vector<UnknownCube>& cubes) const {
+    assert(node && depth < max_depth);
+
+    const unsigned int child_size = 1 << (tree_depth - depth - 1);
+    for (unsigned int i = 0; i < 8; ++i) {
+      OcTreeKey child_min;
+      bool in_bbx = true;
+      for (unsigned int j = 0; j < 3; ++j) {
+        unsigned int min = node_min[j] + ((i & (1 << j)) ? child_size : 0);
+        child_min[j] = (key_type) min;
+        if (min > bbx_max[j] || min + child_size - 1 < bbx_min[j])
+          in_bbx = false;
+      }
+      if (!in_bbx)
+        continue;
+
+      if (!nodeChildExists(node, i)) {
+        UnknownCube cube;
+        cube.depth = depth + 1;
+        cube.key = child_min;
+        if (child_size > 1) {
+          for (unsigned int j = 0; j < 3; ++j)
+            cube.key[j] += child_size/2;
+        }
+        cubes.push_back(cube);
+      }
+      else if (depth + 1 < max_depth) {
+        const NODE* child = getNodeChild(node, i);
+        if (nodeHasChildren(child))
+          getUnknownCubesRecurs(child, depth + 1, child_min, bbx_min, bbx_max, max_depth, cubes);
+      }
     }
   }
 
@@ -1115,5 +1187,115 @@ namespace octomap {
     return x*y*z;
   }
 
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::getSubtrees(std::vector<Subtree>& subtrees, size_t num_subtrees,
+                                           unsigned char maxDepth) const {
+    const key_type max_key = (key_type) (2 * tree_max_val - 1);
+    getSubtrees(subtrees, num_subtrees, OcTreeKey(0, 0, 0), OcTreeKey(max_key, max_key, max_key), maxDepth);
+  }
+
+  template <class NODE,class I>
+  void OcTreeBaseImpl<NODE,I>::getSubtrees(std::vector<Subtree>& subtrees, size_t num_subtrees,
+                                           const OcTreeKey& min, const OcTreeKey& max, unsigned char maxDepth) const {
+    subtrees.clear();
+    if (root == NULL)
+      return;
+    if (maxDepth == 0 || maxDepth > tree_depth)
+      maxDepth = (unsigned char) tree_depth;
+
+    Subtree s;
+    s.node = root;
+    s.depth = 0;
+    s.key[0] = s.key[1] = s.key[2] = tree_max_val;
+    subtrees.push_back(s);
+
+    // split one level at a time, children replace their parent to keep the depth-first order
+    std::vector<Subtree> split;
+    for (unsigned int depth = 0; depth < maxDepth && subtrees.size() < num_subtrees; ++depth) {
+      split.clear();
+      const key_type center_offset_key = tree_max_val >> (depth + 1);
+      for (size_t i = 0; i < subtrees.size(); ++i) {
+        if (subtrees[i].depth < depth || !nodeHasChildren(subtrees[i].node)) {
+          split.push_back(subtrees[i]);
+          continue;
+        }
+        s.depth = (uint8_t) (depth + 1);
+        for (unsigned int j = 0; j < 8; ++j) {
+          if (!nodeChildExists(subtrees[i].node, j))
+            continue;
+          computeChildKey(j, center_offset_key, subtrees[i].key, s.key);
+          // overlap of bbx and child
+          const int size = center_offset_key ? 2 * center_offset_key : 1;
+          bool in_bbx = true;
+          for (unsigned int k = 0; k < 3; ++k) {
+            const int child_min = s.key[k] - center_offset_key;
+            if (child_min > max[k] || child_min + size - 1 < min[k])
+              in_bbx = false;
+          }
+          if (in_bbx) {
+            s.node = getNodeChild(subtrees[i].node, j);
+            split.push_back(s);
+          }
+        }
+      }
+      subtrees.swap(split);
+    }
+  }
+
+  template <class NODE,class I>
+  template <class FUNCTOR, class COMBINE>
+  FUNCTOR OcTreeBaseImpl<NODE,I>::parallel_for_each_leaf(const FUNCTOR& functor, COMBINE combine,
+                                                         unsigned char maxDepth) const {
+    const key_type max_key = (key_type) (2 * tree_max_val - 1);
+    return parallel_for_each_leaf(OcTreeKey(0, 0, 0), OcTreeKey(max_key, max_key, max_key), functor, combine, maxDepth);
+  }
+
+  template <class NODE,class I>
+  template <class FUNCTOR, class COMBINE>
+  FUNCTOR OcTreeBaseImpl<NODE,I>::parallel_for_each_leaf(const OcTreeKey& min, const OcTreeKey& max,
+                                                         const FUNCTOR& functor, COMBINE combine,
+                                                         unsigned char maxDepth) const {
+    // several subtrees per thread to balance the load
+#ifdef _OPENMP
+    const size_t num_subtrees = 16 * omp_get_max_threads();
+#else
+    const size_t num_subtrees = 1;
+#endif
+    std::vector<Subtree> subtrees;
+    getSubtrees(subtrees, num_subtrees, min, max, maxDepth);
+
+    FUNCTOR result(functor);
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+      FUNCTOR thread_functor(functor);
+#ifdef _OPENMP
+      #pragma omp for schedule(dynamic)
+#endif
+      for (int i = 0; i < (int) subtrees.size(); ++i) {
+        for (leaf_bbx_iterator it(this, subtrees[i], min, max, maxDepth), end = this->end_leafs_bbx(); it != end; ++it)
+          thread_functor(it);
+      }
+#ifdef _OPENMP
+      #pragma omp critical (parallel_for_each_leaf)
+#endif
+      combine(result, thread_functor);
+    }
+    return result;
+  }
+
+  template <class NODE,class I>
+  template <class FUNCTOR, class COMBINE>
+  FUNCTOR OcTreeBaseImpl<NODE,I>::parallel_for_each_leaf(const point3d& min, const point3d& max,
+                                                         const FUNCTOR& functor, COMBINE combine,
+                                                         unsigned char maxDepth) const {
+    OcTreeKey min_key, max_key;
+    if (!this->coordToKeyChecked(min, min_key) || !this->coordToKeyChecked(max, max_key)) {
+      OCTOMAP_ERROR_STR("Bounding box " << min << " - " << max << " is out of the tree bounds in parallel_for_each_leaf");
+      return functor;
+    }
+    return parallel_for_each_leaf(min_key, max_key, functor, combine, maxDepth);
+  }
 
 }
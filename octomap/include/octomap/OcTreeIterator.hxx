@@ -70,6 +70,27 @@
         }
       }
 
+      /**
+       * Constructor of an iterator over a subtree only (see OcTreeBaseImpl::getSubtrees()),
+       * which equals the end() iterator after the subtree was traversed.
+       *
+       * @param tree OcTreeBaseImpl on which the iterator is used on
+       * @param subtree root node of the subtree with its key and depth
+       * @param depth Maximum depth to traverse the tree. 0 (default): unlimited
+       */
+      iterator_base(OcTreeBaseImpl<NodeType,INTERFACE> const* tree, const StackElement& subtree, uint8_t depth=0)
+        : tree((tree && subtree.node) ? tree : NULL), maxDepth(depth)
+      {
+        if (this->tree){
+          if (maxDepth == 0)
+            maxDepth = tree->getTreeDepth();
+          assert(subtree.depth <= maxDepth);
+          stack.push(subtree);
+        } else{ // construct the same as "end"
+          this->maxDepth = 0;
+        }
+      }
+
       /// Copy constructor of the iterator
       iterator_base(const iterator_base& other)
       : tree(other.tree), maxDepth(other.maxDepth), stack(other.stack) {}
@@ -153,13 +174,54 @@
         uint8_t depth;
       };
 
+      /**
+       * Recursion stack of the iterator with a fixed capacity, so that iterators
+       * do not allocate memory and copying them only copies the used elements.
+       */
+      class Stack{
+      public:
+        Stack() : num_elements(0) {}
+
+        Stack(const Stack& other) : num_elements(other.num_elements) {
+          for (size_t i = 0; i < num_elements; ++i)
+            elements[i] = other.elements[i];
+        }
+
+        Stack& operator=(const Stack& other){
+          num_elements = other.num_elements;
+          for (size_t i = 0; i < num_elements; ++i)
+            elements[i] = other.elements[i];
+          return *this;
+        }
+
+        bool empty() const { return num_elements == 0; }
+        size_t size() const { return num_elements; }
+
+        StackElement& top() { assert(num_elements > 0); return elements[num_elements-1]; }
+        const StackElement& top() const { assert(num_elements > 0); return elements[num_elements-1]; }
+
+        void push(const StackElement& element){
+          assert(num_elements < MAX_SIZE);
+          elements[num_elements++] = element;
+        }
+        void pop() { assert(num_elements > 0); --num_elements; }
+
+      protected:
+        /// up to 7 siblings waiting on each of the 16 levels (key_type limits the tree depth),
+        /// the current node and the copy of the subtree root pushed by the leaf iterators
+        static const size_t MAX_SIZE = 7*16 + 2;
+
+        StackElement elements[MAX_SIZE];
+        size_t num_elements;
+      };
+
 
     protected:
       OcTreeBaseImpl<NodeType,INTERFACE> const* tree; ///< Octree this iterator is working on
       uint8_t maxDepth; ///< Maximum depth for depth-limited queries
 
-      /// Internal recursion stack. Apparently a stack of vector works fastest here.
-      std::stack<StackElement,std::vector<StackElement> > stack;
+      /// Internal recursion stack
+      Stack stack;
       
       /// One step of depth-first tree traversal.
       /// How this is used depends on the actual iterator.
@@ -215,6 +277,10 @@
        */
       tree_iterator(OcTreeBaseImpl<NodeType,INTERFACE> const* tree, uint8_t depth=0) : iterator_base(tree, depth) {};
 
+      /// Constructor of an iterator over a subtree only, see OcTreeBaseImpl::getSubtrees()
+      tree_iterator(OcTreeBaseImpl<NodeType,INTERFACE> const* tree, const typename iterator_base::StackElement& subtree,
+                    uint8_t depth=0) : iterator_base(tree, subtree, depth) {};
+
       /// postfix increment operator of iterator (it++)
       tree_iterator operator++(int){
         tree_iterator result = *this;
@@ -280,6 +346,15 @@
             }
           }
 
+          /// Constructor of an iterator over the leafs of a subtree only, see OcTreeBaseImpl::getSubtrees()
+          leaf_iterator(OcTreeBaseImpl<NodeType, INTERFACE> const* tree, const typename iterator_base::StackElement& subtree,
+                        uint8_t depth=0) : iterator_base(tree, subtree, depth) {
+            if (this->stack.size() > 0){
+              this->stack.push(this->stack.top());
+              operator ++();
+            }
+          }
+
           leaf_iterator(const leaf_iterator& other) : iterator_base(other) {};
 
           /// postfix increment operator of iterator (it++)
@@ -317,7 +392,9 @@
 
     /**
      * Bounding-box leaf iterator. This iterator will traverse all leaf nodes
-     * within a given bounding box (axis-aligned). See below for example usage.
+     * within a given bounding box (axis-aligned), including pruned leafs which
+     * only partially overlap with it. Subtrees completely within the bounding box
+     * are traversed without further checks. See below for example usage.
      * Note that the non-trivial call to tree->end_leafs_bbx() should be done only once
      * for efficiency!
      *
@@ -357,8 +434,9 @@
           assert(tree);
           if (!this->tree->coordToKeyChecked(min, minKey) || !this->tree->coordToKeyChecked(max, maxKey)){
             // coordinates invalid, set to end iterator
-            tree = NULL;
+            this->tree = NULL;
             this->maxDepth = 0;
+            this->stack.pop();
           } else{  // else: keys are generated and stored
 
             // advance from root to next valid leaf in bbx:
@@ -389,6 +467,20 @@
         }
       }
 
+      /**
+      * Constructor of an iterator over the leafs of a subtree only (see OcTreeBaseImpl::getSubtrees())
+      * in a bounding box given by exact keys (including min and max).
+      */
+      leaf_bbx_iterator(OcTreeBaseImpl<NodeType,INTERFACE> const* tree, const typename iterator_base::StackElement& subtree,
+                        const OcTreeKey& min, const OcTreeKey& max, uint8_t depth=0)
+        : iterator_base(tree, subtree, depth), minKey(min), maxKey(max)
+      {
+        if (this->stack.size() > 0){
+          this->stack.push(this->stack.top());
+          this->operator ++();
+        }
+      }
+
       leaf_bbx_iterator(const leaf_bbx_iterator& other) : iterator_base(other) {
         minKey = other.minKey;
         maxKey = other.maxKey;
@@ -410,29 +502,69 @@
 
         } else {
           this->stack.pop();
-
-          // skip forward to next leaf
-          while(!this->stack.empty()  
-              && this->stack.top().depth < this->maxDepth
-              && this->tree->nodeHasChildren(this->stack.top().node))
-          {
-            this->singleIncrement();
-          }
-          // done: either stack is empty (== end iterator) or a next leaf node is reached!
-          if (this->stack.empty())
-            this->tree = NULL;
+          skipToLeaf(AllNodes());
         }
 
-
         return *this;
       };
 
     protected:
+      /// accepts all nodes in skipToLeaf()
+      struct AllNodes{
+        bool operator()(const NodeType*) const { return true; }
+      };
+
+      /**
+       * Skips forward from the top of the stack to the next leaf in the bbx, subtrees whose
+       * root is not accepted are skipped. Either the stack is empty afterwards
+       * (== end iterator) or the next leaf node is reached.
+       */
+      template <class ACCEPT>
+      void skipToLeaf(const ACCEPT& accept){
+        while (!this->stack.empty()){
+          const typename iterator_base::StackElement& top = this->stack.top();
+          if (!accept(top.node))
+            this->stack.pop();
+          else if (top.depth < this->maxDepth && this->tree->nodeHasChildren(top.node))
+            singleIncrement();
+          else
+            break;
+        }
+        if (this->stack.empty())
+          this->tree = NULL;
+      }
+
+      /// @return whether the node of element lies completely within the bbx
+      bool isInBBX(const typename iterator_base::StackElement& element) const {
+        const int center_offset_key = this->tree->tree_max_val >> element.depth;
+        const int size = center_offset_key ? 2 * center_offset_key : 1;
+        for (unsigned int j = 0; j < 3; ++j) {
+          const int node_min = element.key[j] - center_offset_key;
+          if (node_min < minKey[j] || node_min + size - 1 > maxKey[j])
+            return false;
+        }
+        return true;
+      }
+
+      /// @return whether the node of element overlaps with the bbx
+      bool overlapsBBX(const typename iterator_base::StackElement& element) const {
+        const int center_offset_key = this->tree->tree_max_val >> element.depth;
+        const int size = center_offset_key ? 2 * center_offset_key : 1;
+        for (unsigned int j = 0; j < 3; ++j) {
+          const int node_min = element.key[j] - center_offset_key;
+          if (node_min > maxKey[j] || node_min + size - 1 < minKey[j])
+            return false;
+        }
+        return true;
+      }
 
       void singleIncrement(){
         typename iterator_base::StackElement top = this->stack.top();
         this->stack.pop();
 
+        // all children of a node within the bbx are within as well, skip their checks
+        const bool inside = isInBBX(top);
+
         typename iterator_base::StackElement s;
         s.depth = top.depth +1;
         key_type center_offset_key = this->tree->tree_max_val >> s.depth;
@@ -440,12 +572,7 @@
         for (int i=7; i>=0; --i) {
           if (this->tree->nodeChildExists(top.node, i)) {
             computeChildKey(i, center_offset_key, top.key, s.key);
-
-            // overlap of query bbx and child bbx?
-            if ((minKey[0] <= (s.key[0] + center_offset_key)) && (maxKey[0] >= (s.key[0] - center_offset_key))
-                && (minKey[1] <= (s.key[1] + center_offset_key)) && (maxKey[1] >= (s.key[1] - center_offset_key))
-                && (minKey[2] <= (s.key[2] + center_offset_key)) && (maxKey[2] >= (s.key[2] - center_offset_key)))
-            {
+            if (inside || overlapsBBX(s)) {
               s.node = this->tree->getNodeChild(top.node, i);
               this->stack.push(s);
               assert(s.depth <= this->maxDepth);
@@ -63,12 +63,20 @@ namespace octomap {
     inline void updateTimestamp() { timestamp = (unsigned int) time(NULL);}
     inline void setTimestamp(unsigned int timestamp) {this->timestamp = timestamp; }
 
-    // update occupancy and timesteps of inner nodes 
+    //! \return oldest timestamp of all children
+    unsigned int getMinChildTimestamp() const;
+
+    // update occupancy and timesteps of inner nodes: inner nodes hold the
+    // oldest timestamp below them, so that recently updated subtrees can be skipped
     inline void updateOccupancyChildren() {      
       this->setLogOdds(this->getMaxChildLogOdds());  // conservative
-      updateTimestamp();
+      this->setTimestamp(this->getMinChildTimestamp());
     }
 
+    // file I/O, stores the timestamp along with the occupancy
+    std::istream& readData(std::istream &s);
+    std::ostream& writeData(std::ostream &s) const;
+
   protected:
     unsigned int timestamp;
   };
@@ -90,12 +98,46 @@ namespace octomap {
     //! \return timestamp of last update
     unsigned int getLastUpdateTime();
 
+    /// Deletes the complete tree structure and resets the timestamp of the last update
+    void clear();
+
+    /// Reads the tree data and restores the timestamp of the last update from the nodes
+    std::istream& readData(std::istream &s);
+
+    /**
+     * Sets the timestamp given to all nodes updated from now on and used by
+     * degradeOutdatedNodes(), e.g., the time of the current scan in milliseconds
+     * for sub-second resolution. The unit is up to the user, time_thres needs
+     * to be given in the same unit. Without calling this, the system time in
+     * seconds (time(NULL)) is used.
+     */
+    void setCurrentTime(unsigned int time);
+
+    //! \return timestamp given to updated nodes, see setCurrentTime()
+    unsigned int getCurrentTime() const;
+
+    /**
+     * Integrates a miss into all occupied leaf nodes that have not been updated
+     * for more than time_thres, relative to getCurrentTime(). Subtrees without
+     * occupied or without outdated nodes are skipped, so the cost depends on the
+     * number of outdated nodes rather than the size of the tree. Requires
+     * up-to-date inner nodes (see updateInnerOccupancy() after lazy updates).
+     */
     void degradeOutdatedNodes(unsigned int time_thres);
+
+    /// Same as degradeOutdatedNodes(unsigned int), relative to query_time
+    void degradeOutdatedNodes(unsigned int time_thres, unsigned int query_time);
     
     virtual void updateNodeLogOdds(OcTreeNodeStamped* node, const float& update) const;
     void integrateMissNoTime(OcTreeNodeStamped* node) const;
 
   protected:
+    void degradeOutdatedNodesRecurs(OcTreeNodeStamped* node, unsigned int time_thres, unsigned int query_time);
+
+    unsigned int current_time;
+    bool use_current_time;
+    mutable unsigned int last_update_time;
+
     /**
      * Static member object which ensures that this OcTree's prototype
      * ends up in the classIDMapping only once. You need this as a 
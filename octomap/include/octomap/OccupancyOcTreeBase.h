@@ -96,6 +96,14 @@ namespace octomap {
     virtual void insertPointCloud(const Pointcloud& scan, const octomap::point3d& sensor_origin,
                    double maxrange=-1., bool lazy_eval = false, bool discretize = false);
 
+    /**
+    * Integrate a PointcloudSoA (in global reference frame), same as
+    * insertPointCloud(const Pointcloud&, const point3d&, double, bool, bool)
+    * without converting the cloud.
+    */
+    virtual void insertPointCloud(const PointcloudSoA& scan, const octomap::point3d& sensor_origin,
+                   double maxrange=-1., bool lazy_eval = false, bool discretize = false);
+
     /**
     * Integrate a 3d scan (transform scan before tree update), parallelized with OpenMP.
     * Special care is taken that each voxel
@@ -327,6 +335,52 @@ namespace octomap {
 		 * @return True if the input voxel is known in the occupancy grid, and false if it is unknown.
 		 */
 		bool getNormals(const point3d& point, std::vector<point3d>& normals, bool unknownStatus=true) const;
+
+    /**
+     * Estimates the surface normals at many voxels at once. The normal of a voxel is the
+     * sum of the normals of the marching cubes triangles (as in getMesh()) in the 8 cubes
+     * around its center, normalized. The 3x3x3 neighborhood of each voxel is gathered once
+     * and the queries are processed in Morton order, so that the tree path of a query is
+     * reused for the next one and neighbors are searched from their common ancestor.
+     * Runs in parallel with OpenMP.
+     *
+     * @param[in] keys voxels (lowest tree level) to estimate the normals for
+     * @param[out] normals one normal per key pointing to free space, (0,0,0) if there is
+     *   no surface around the voxel
+     * @param[in] unknownStatus consider unknown cells as free (false) or occupied (default, true)
+     */
+    void getSurfaceNormals(const std::vector<OcTreeKey>& keys, std::vector<point3d>& normals,
+                           bool unknownStatus=true) const;
+
+    /**
+     * Extracts the surface between occupied and free space as an indexed triangle mesh,
+     * running marching cubes on the grid of voxel centers at the lowest tree level.
+     * Only cubes with corners in different leaves are visited, so pruned nodes are
+     * handled by their faces. Vertices on shared cube edges are only added once.
+     * Subtrees are meshed in parallel with OpenMP. Triangles are oriented counter-clockwise
+     * seen from the free side, i.e., their normals point to free space.
+     *
+     * @param[out] vertices vertices of the mesh
+     * @param[out] triangles three indices into vertices per triangle
+     * @param[in] interpolate place vertices by linear interpolation of the log-odds on the
+     *   occupancy threshold (default: center of the cube edges)
+     * @param[in] unknownStatus consider unknown cells as free (false) or occupied (default, true)
+     */
+    void getMesh(std::vector<point3d>& vertices, std::vector<unsigned int>& triangles,
+                 bool interpolate=false, bool unknownStatus=true) const;
+
+    /**
+     * Same as getMesh(std::vector<point3d>&, std::vector<unsigned int>&, bool, bool) in a
+     * bounding box, only cubes with all voxels between bbx_min and bbx_max (included) are meshed.
+     */
+    void getMesh(std::vector<point3d>& vertices, std::vector<unsigned int>& triangles,
+                 const OcTreeKey& bbx_min, const OcTreeKey& bbx_max,
+                 bool interpolate=false, bool unknownStatus=true) const;
+
+    /// Same as getMesh(std::vector<point3d>&, std::vector<unsigned int>&, const OcTreeKey&, const OcTreeKey&, bool, bool) with a metric bounding box
+    void getMesh(std::vector<point3d>& vertices, std::vector<unsigned int>& triangles,
+                 const point3d& bbx_min, const point3d& bbx_max,
+                 bool interpolate=false, bool unknownStatus=true) const;
 	
     //-- set BBX limit (limits tree updates to this bounding box)
 
@@ -368,6 +422,132 @@ namespace octomap {
     /// Number of changes since last reset.
     size_t numChangesDetected() const { return changed_keys.size(); }
 
+    //-- iteration over occupied space:
+    /**
+     * Bounding-box iterator over the occupied leafs only (see leaf_bbx_iterator).
+     * Inner nodes hold the maximum occupancy of their children, so free subtrees are
+     * skipped as a whole. With lazy updates, updateInnerOccupancy() has to be called
+     * before iterating.
+     *
+     * @code
+     * for(OcTreeTYPE::leaf_bbx_occupied_iterator it = tree->begin_leafs_bbx_occupied(min,max),
+     *        end=tree->end_leafs_bbx_occupied(); it!= end; ++it)
+     * {
+     *   std::cout << "Occupied node center: " << it.getCoordinate() << std::endl;
+     * }
+     * @endcode
+     */
+    class leaf_bbx_occupied_iterator : public OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::leaf_bbx_iterator {
+    public:
+      typedef typename OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::leaf_bbx_iterator leaf_bbx_iterator;
+
+      leaf_bbx_occupied_iterator() : leaf_bbx_iterator(), occupied(0.f) {}
+
+      /// Constructor of the iterator, see leaf_bbx_iterator(tree, min, max, depth) with exact keys
+      leaf_bbx_occupied_iterator(OccupancyOcTreeBase<NODE> const* tree, const OcTreeKey& min, const OcTreeKey& max,
+                                 uint8_t depth=0)
+        : leaf_bbx_iterator(tree, min, max, depth), occupied(tree->getOccupancyThresLog())
+      {
+        this->skipToLeaf(occupied);
+      }
+
+      /// Constructor of the iterator, see leaf_bbx_iterator(tree, min, max, depth) with coordinates
+      leaf_bbx_occupied_iterator(OccupancyOcTreeBase<NODE> const* tree, const point3d& min, const point3d& max,
+                                 uint8_t depth=0)
+        : leaf_bbx_iterator(tree, min, max, depth), occupied(tree->getOccupancyThresLog())
+      {
+        this->skipToLeaf(occupied);
+      }
+
+      /// postfix increment operator of iterator (it++)
+      leaf_bbx_occupied_iterator operator++(int){
+        leaf_bbx_occupied_iterator result = *this;
+        ++(*this);
+        return result;
+      }
+
+      /// prefix increment operator of iterator (++it)
+      leaf_bbx_occupied_iterator& operator++(){
+        if (this->stack.empty()){
+          this->tree = NULL;
+        } else {
+          this->stack.pop();
+          this->skipToLeaf(occupied);
+        }
+        return *this;
+      }
+
+    protected:
+      /// accepts occupied nodes (inner nodes: with an occupied child) in skipToLeaf()
+      struct OccupiedNodes {
+        OccupiedNodes(float occ_thres_log) : occ_thres_log(occ_thres_log) {}
+        bool operator()(const NODE* node) const { return node->getLogOdds() >= occ_thres_log; }
+        float occ_thres_log;
+      };
+
+      OccupiedNodes occupied;
+    };
+
+    /// @return beginning of the occupied leafs in a bounding box, see leaf_bbx_occupied_iterator
+    leaf_bbx_occupied_iterator begin_leafs_bbx_occupied(const OcTreeKey& min, const OcTreeKey& max, unsigned char maxDepth=0) const {
+      return leaf_bbx_occupied_iterator(this, min, max, maxDepth);
+    }
+    /// @return beginning of the occupied leafs in a bounding box, see leaf_bbx_occupied_iterator
+    leaf_bbx_occupied_iterator begin_leafs_bbx_occupied(const point3d& min, const point3d& max, unsigned char maxDepth=0) const {
+      return leaf_bbx_occupied_iterator(this, min, max, maxDepth);
+    }
+    /// @return end of the occupied leafs in a bounding box
+    leaf_bbx_occupied_iterator end_leafs_bbx_occupied() const { return leaf_bbx_occupied_iterator(); }
+
+    //-- frontiers between free and unknown space:
+    /**
+     * Computes the frontier of the map: all free voxels (keys at the lowest tree level)
+     * with at least one unknown face neighbor. The tree is traversed once, neighbors are
+     * searched from their common ancestor and pruned free nodes are checked face by face,
+     * so that only voxels on their faces are visited.
+     *
+     * @param frontier frontier keys are added to this set
+     */
+    void getFrontier(KeySet& frontier) const;
+
+    /// @return true if the voxel at key (lowest tree level) is free and has an unknown face neighbor
+    bool isFrontier(const OcTreeKey& key) const;
+
+    /**
+     * Incrementally updates a frontier computed with getFrontier() after scans were
+     * inserted, only the changed keys (see enableChangeDetection()) and their face
+     * neighbors are checked again. Call this before resetChangeDetection().
+     *
+     * @param frontier frontier keys of the tree before the changes, updated in place
+     */
+    void updateFrontier(KeySet& frontier) const;
+
+    //-- caching of free space rays between scans:
+    /**
+     * Enables a cache for the rays cast by computeUpdate(): rays with the same origin
+     * and endpoint keys as a ray of a previous scan are not cast again, which pays off
+     * for consecutive scans from nearby origins. Cached rays are cast between the centers
+     * of the origin and endpoint voxels, so the free cells can differ slightly from
+     * uncached updates (similar to computeDiscreteUpdate()).
+     *
+     * The cache is disabled by default, computeUpdate() then casts all rays without
+     * any cache lookup.
+     *
+     * @param max_keys maximum number of keys stored in the cache, the least recently
+     *   used rays are dropped first (0: disable caching and free the cache, default)
+     */
+    void setRayCacheSize(size_t max_keys);
+    size_t getRayCacheSize() const { return ray_cache ? ray_cache->max_keys : 0; }
+    /// Removes all cached rays
+    void clearRayCache();
+    /// Number of rays taken from the cache since the last resetRayCacheStatistics()
+    size_t getRayCacheHits() const { return ray_cache ? ray_cache->hits : 0; }
+    /// Number of rays cast and added to the cache since the last resetRayCacheStatistics()
+    size_t getRayCacheMisses() const { return ray_cache ? ray_cache->misses : 0; }
+    /// Fraction of rays taken from the cache (0..1)
+    double getRayCacheHitRate() const;
+    void resetRayCacheStatistics() { if (ray_cache) { ray_cache->hits = 0; ray_cache->misses = 0; } }
+
 
     /**
      * Helper for insertPointCloud(). Computes all octree nodes affected by the point cloud
@@ -385,6 +565,12 @@ namespace octomap {
                        KeySet& occupied_cells,
                        double maxrange);
 
+    /// Same as computeUpdate(const Pointcloud&, const point3d&, KeySet&, KeySet&, double) for a PointcloudSoA
+    void computeUpdate(const PointcloudSoA& scan, const octomap::point3d& origin,
+                       KeySet& free_cells,
+                       KeySet& occupied_cells,
+                       double maxrange);
+
 
     /**
      * Helper for insertPointCloud(). Computes all octree nodes affected by the point cloud
@@ -403,6 +589,12 @@ namespace octomap {
                        KeySet& occupied_cells,
                        double maxrange);
 
+    /// Same as computeDiscreteUpdate(const Pointcloud&, const point3d&, KeySet&, KeySet&, double) for a PointcloudSoA
+    void computeDiscreteUpdate(const PointcloudSoA& scan, const octomap::point3d& origin,
+                       KeySet& free_cells,
+                       KeySet& occupied_cells,
+                       double maxrange);
+
 
     // -- I/O  -----------------------------------------
 
@@ -473,6 +665,30 @@ namespace octomap {
      */
     inline bool integrateMissOnRay(const point3d& origin, const point3d& end, bool lazy_eval = false);
 
+    /**
+     * computeRayKeys() using the ray cache, which must be enabled (see setRayCacheSize()).
+     * @return false if the ray could not be computed or its keys were already
+     *   returned in the current computeUpdate() (the same ray from within the scan)
+     */
+    bool computeRayKeysCached(const point3d& origin, const point3d& end, KeyRay& ray);
+
+    /// computeRayKeysCached() if the ray cache is enabled, computeRayKeys() otherwise
+    inline bool computeUpdateRayKeys(const point3d& origin, const point3d& end, KeyRay& ray) {
+      if (ray_cache)
+        return computeRayKeysCached(origin, end, ray);
+      return this->computeRayKeys(origin, end, ray);
+    }
+
+    /// computeUpdate() for any point cloud class with size() and operator[] returning a point3d
+    template <class CLOUD>
+    void computeUpdateCloud(const CLOUD& scan, const point3d& origin, KeySet& free_cells,
+                            KeySet& occupied_cells, double maxrange);
+
+    /// computeDiscreteUpdate() for any point cloud class with size() and operator[] returning a point3d
+    template <class CLOUD>
+    void computeDiscreteUpdateCloud(const CLOUD& scan, const point3d& origin, KeySet& free_cells,
+                                    KeySet& occupied_cells, double maxrange);
+
 
     // recursive calls ----------------------------
 
@@ -486,6 +702,55 @@ namespace octomap {
     
     void toMaxLikelihoodRecurs(NODE* node, unsigned int depth, unsigned int max_depth);
 
+    /// recursive call of getFrontier(), path holds the ancestors of node (path[depth] = node)
+    void getFrontierRecurs(const NODE** path, unsigned int depth, const OcTreeKey& node_min, KeySet& frontier) const;
+
+    /**
+     * Searches the node containing key down to max_depth, starting at its ancestor node at depth.
+     * @return the node at max_depth or a leaf above it (depth is returned in found_depth),
+     *   NULL if the space at key is unknown
+     */
+    const NODE* searchFrom(const NODE* node, unsigned int depth, const OcTreeKey& key,
+                           unsigned int max_depth, unsigned int& found_depth) const;
+
+    /**
+     * Searches the voxel at key (lowest tree level) from the common ancestor with the node
+     * path[depth], whose minimum key is node_min (path holds its ancestors).
+     * @return the leaf containing key, NULL if the space at key is unknown
+     */
+    const NODE* searchNeighbor(const NODE** path, unsigned int depth, const OcTreeKey& node_min,
+                               const OcTreeKey& key) const;
+
+    /// vertex of getMesh(), the id identifies the edge between voxel centers it lies on
+    struct MeshVertex {
+      uint64_t id;
+      point3d coord;
+      bool operator< (const MeshVertex& other) const { return id < other.id; }
+      bool operator== (const MeshVertex& other) const { return id == other.id; }
+    };
+
+    /// mesh of the subtree at depth with minimum key node_min in getMesh()
+    struct MeshPart {
+      unsigned int depth;
+      OcTreeKey node_min;
+      std::vector<MeshVertex> vertices;
+      /// vertex ids, three per triangle
+      std::vector<uint64_t> triangles;
+    };
+
+    /// recursive call of getMesh(), cube_min and cube_max bound the minimum corners of meshed cubes
+    void getMeshRecurs(const NODE** path, unsigned int depth, const OcTreeKey& node_min,
+                       const OcTreeKey& cube_min, const OcTreeKey& cube_max,
+                       bool interpolate, bool unknownStatus, MeshPart& part) const;
+
+    /**
+     * Marching cubes step of getMesh() for the cube of voxel centers with minimum corner cube,
+     * which has a corner in the leaf path[depth]. The cube is skipped unless its first known
+     * corner lies in this leaf, so that every cube is meshed once.
+     */
+    void getMeshCube(const NODE** path, unsigned int depth, const OcTreeKey& node_min,
+                     const OcTreeKey& cube, bool interpolate, bool unknownStatus, MeshPart& part) const;
+
 
   protected:
     bool use_bbx_limit;  ///< use bounding box for queries (needs to be set)?
@@ -497,6 +762,45 @@ namespace octomap {
     bool use_change_detection;
     /// Set of leaf keys (lowest level) which changed since last resetChangeDetection
     KeyBoolMap changed_keys;
+
+    /// origin and endpoint key of a cached ray
+    struct RayCacheKey {
+      OcTreeKey origin;
+      OcTreeKey end;
+      bool operator== (const RayCacheKey& other) const {
+        return (origin == other.origin) && (end == other.end);
+      }
+    };
+    struct RayCacheKeyHash {
+      size_t operator()(const RayCacheKey& key) const {
+        OcTreeKey::KeyHash hash;
+        return 83492791*hash(key.origin) + hash(key.end);
+      }
+    };
+    struct RayCacheEntry {
+      RayCacheEntry(const RayCacheKey& key, const KeyRay& ray, unsigned int last_update)
+        : key(key), keys(ray.begin(), ray.end()), last_update(last_update) {}
+      RayCacheKey key;
+      std::vector<OcTreeKey> keys;
+      unsigned int last_update; ///< computeUpdate() call which last used the ray
+    };
+    typedef std::list<RayCacheEntry> RayCacheList;
+    typedef unordered_ns::unordered_map<RayCacheKey, typename RayCacheList::iterator, RayCacheKeyHash> RayCacheMap;
+
+    struct RayCache {
+      RayCache(size_t max_keys, double resolution)
+        : max_keys(max_keys), num_keys(0), resolution(resolution), update(0), hits(0), misses(0) {}
+      size_t max_keys;
+      size_t num_keys;
+      double resolution; ///< resolution of the cached rays
+      RayCacheList list; ///< cached rays, most recently used first
+      RayCacheMap map;
+      unsigned int update; ///< number of computeUpdate() calls
+      size_t hits;
+      size_t misses;
+    };
+    /// cached rays of computeUpdate(), NULL unless enabled by setRayCacheSize()
+    RayCache* ray_cache;
     
 
   };
@@ -40,20 +40,23 @@ namespace octomap {
 
   template <class NODE>
   OccupancyOcTreeBase<NODE>::OccupancyOcTreeBase(double resolution)
-    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(resolution), use_bbx_limit(false), use_change_detection(false)
+    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(resolution), use_bbx_limit(false), use_change_detection(false),
+      ray_cache(NULL)
   {
 
   }
   
   template <class NODE>
   OccupancyOcTreeBase<NODE>::OccupancyOcTreeBase(double resolution, unsigned int tree_depth, unsigned int tree_max_val)
-    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(resolution, tree_depth, tree_max_val), use_bbx_limit(false), use_change_detection(false)
+    : OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(resolution, tree_depth, tree_max_val), use_bbx_limit(false), use_change_detection(false),
+      ray_cache(NULL)
   {
 
   }  
 
   template <class NODE>
   OccupancyOcTreeBase<NODE>::~OccupancyOcTreeBase(){
+    delete ray_cache;
   }
 
   template <class NODE>
@@ -61,8 +64,12 @@ namespace octomap {
   OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>(rhs), use_bbx_limit(rhs.use_bbx_limit),
     bbx_min(rhs.bbx_min), bbx_max(rhs.bbx_max),
     bbx_min_key(rhs.bbx_min_key), bbx_max_key(rhs.bbx_max_key),
-    use_change_detection(rhs.use_change_detection), changed_keys(rhs.changed_keys)
+    use_change_detection(rhs.use_change_detection), changed_keys(rhs.changed_keys),
+    ray_cache(NULL)
   {
+    // the copy starts with an empty cache of the same size
+    if (rhs.ray_cache)
+      ray_cache = new RayCache(rhs.ray_cache->max_keys, rhs.resolution);
     this->clamping_thres_min = rhs.clamping_thres_min;
     this->clamping_thres_max = rhs.clamping_thres_max;
     this->prob_hit_log = rhs.prob_hit_log;
@@ -101,12 +108,31 @@ namespace octomap {
     }
   }
 
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::insertPointCloud(const PointcloudSoA& scan, const octomap::point3d& sensor_origin,
+                                             double maxrange, bool lazy_eval, bool discretize) {
+
+    KeySet free_cells, occupied_cells;
+    if (discretize)
+      computeDiscreteUpdate(scan, sensor_origin, free_cells, occupied_cells, maxrange);
+    else
+      computeUpdate(scan, sensor_origin, free_cells, occupied_cells, maxrange);
+
+    // insert data into tree  -----------------------
+    for (KeySet::iterator it = free_cells.begin(); it != free_cells.end(); ++it) {
+      updateNode(*it, false, lazy_eval);
+    }
+    for (KeySet::iterator it = occupied_cells.begin(); it != occupied_cells.end(); ++it) {
+      updateNode(*it, true, lazy_eval);
+    }
+  }
+
   template <class NODE>
   void OccupancyOcTreeBase<NODE>::insertPointCloud(const Pointcloud& pc, const point3d& sensor_origin, const pose6d& frame_origin,
                                              double maxrange, bool lazy_eval, bool discretize) {
     // performs transformation to data and sensor origin first
-    Pointcloud transformed_scan (pc);
-    transformed_scan.transform(frame_origin);
+    Pointcloud transformed_scan;
+    transformed_scan.setTransformed(pc, frame_origin);
     point3d transformed_sensor_origin = frame_origin.transform(sensor_origin);
     insertPointCloud(transformed_scan, transformed_sensor_origin, maxrange, lazy_eval, discretize);
   }
@@ -148,18 +174,29 @@ namespace octomap {
   void OccupancyOcTreeBase<NODE>::computeDiscreteUpdate(const Pointcloud& scan, const octomap::point3d& origin,
                                                 KeySet& free_cells, KeySet& occupied_cells,
                                                 double maxrange)
+  {
+    computeDiscreteUpdateCloud(scan, origin, free_cells, occupied_cells, maxrange);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::computeDiscreteUpdate(const PointcloudSoA& scan, const octomap::point3d& origin,
+                                                KeySet& free_cells, KeySet& occupied_cells,
+                                                double maxrange)
+  {
+    computeDiscreteUpdateCloud(scan, origin, free_cells, occupied_cells, maxrange);
+  }
+
+  template <class NODE> template <class CLOUD>
+  void OccupancyOcTreeBase<NODE>::computeDiscreteUpdateCloud(const CLOUD& scan, const octomap::point3d& origin,
+                                                KeySet& free_cells, KeySet& occupied_cells,
+                                                double maxrange)
  {
+   // one endpoint at the center of each voxel
    Pointcloud discretePC;
    discretePC.reserve(scan.size());
-   KeySet endpoints;
-
-   for (int i = 0; i < (int)scan.size(); ++i) {
-     OcTreeKey k = this->coordToKey(scan[i]);
-     std::pair<KeySet::iterator,bool> ret = endpoints.insert(k);
-     if (ret.second){ // insertion took place => k was not in set
-       discretePC.push_back(this->keyToCoord(k));
-     }
-   }
+   for (int i = 0; i < (int)scan.size(); ++i)
+     discretePC.push_back(scan[i]);
+   discretePC.voxelFilter(this->resolution);
 
    computeUpdate(discretePC, origin, free_cells, occupied_cells, maxrange);
  }
@@ -170,8 +207,28 @@ namespace octomap {
                                                 KeySet& free_cells, KeySet& occupied_cells,
                                                 double maxrange)
   {
+    computeUpdateCloud(scan, origin, free_cells, occupied_cells, maxrange);
+  }
 
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::computeUpdate(const PointcloudSoA& scan, const octomap::point3d& origin,
+                                                KeySet& free_cells, KeySet& occupied_cells,
+                                                double maxrange)
+  {
+    computeUpdateCloud(scan, origin, free_cells, occupied_cells, maxrange);
+  }
 
+  template <class NODE> template <class CLOUD>
+  void OccupancyOcTreeBase<NODE>::computeUpdateCloud(const CLOUD& scan, const octomap::point3d& origin,
+                                                     KeySet& free_cells, KeySet& occupied_cells,
+                                                     double maxrange)
+  {
+    if (ray_cache) {
+      // cached rays are only valid for the resolution they were cast with
+      if (ray_cache->resolution != this->resolution)
+        clearRayCache();
+      ray_cache->update++;
+    }
 
 #ifdef _OPENMP
     omp_set_num_threads(this->keyrays.size());
@@ -189,7 +246,7 @@ namespace octomap {
       if (!use_bbx_limit) { // no BBX specified
         if ((maxrange < 0.0) || ((p - origin).norm() <= maxrange) ) { // is not maxrange meas.
           // free cells
-          if (this->computeRayKeys(origin, p, *keyray)){
+          if (this->computeUpdateRayKeys(origin, p, *keyray)){
 #ifdef _OPENMP
             #pragma omp critical (free_insert)
 #endif
@@ -210,7 +267,7 @@ namespace octomap {
         } else { // user set a maxrange and length is above
           point3d direction = (p - origin).normalized ();
           point3d new_end = origin + direction * (float) maxrange;
-          if (this->computeRayKeys(origin, new_end, *keyray)){
+          if (this->computeUpdateRayKeys(origin, new_end, *keyray)){
 #ifdef _OPENMP
             #pragma omp critical (free_insert)
 #endif
@@ -235,7 +292,7 @@ namespace octomap {
           }
 
           // update freespace, break as soon as bbx limit is reached
-          if (this->computeRayKeys(origin, p, *keyray)){
+          if (this->computeUpdateRayKeys(origin, p, *keyray)){
             for(KeyRay::reverse_iterator rit=keyray->rbegin(); rit != keyray->rend(); rit++) {
               if (inBBX(*rit)) {
 #ifdef _OPENMP
@@ -263,6 +320,93 @@ namespace octomap {
     }
   }
 
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::setRayCacheSize(size_t max_keys) {
+    if (max_keys == 0) {
+      delete ray_cache;
+      ray_cache = NULL;
+      return;
+    }
+    if (!ray_cache)
+      ray_cache = new RayCache(max_keys, this->resolution);
+    ray_cache->max_keys = max_keys;
+    // drop the least recently used rays until the cache fits
+    while (ray_cache->num_keys > ray_cache->max_keys) {
+      ray_cache->num_keys -= ray_cache->list.back().keys.size();
+      ray_cache->map.erase(ray_cache->list.back().key);
+      ray_cache->list.pop_back();
+    }
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::clearRayCache() {
+    if (!ray_cache)
+      return;
+    ray_cache->list.clear();
+    ray_cache->map.clear();
+    ray_cache->num_keys = 0;
+    ray_cache->resolution = this->resolution;
+  }
+
+  template <class NODE>
+  double OccupancyOcTreeBase<NODE>::getRayCacheHitRate() const {
+    size_t num_rays = getRayCacheHits() + getRayCacheMisses();
+    if (num_rays == 0)
+      return 0.0;
+    return (double) getRayCacheHits() / (double) num_rays;
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::computeRayKeysCached(const point3d& origin, const point3d& end, KeyRay& ray) {
+    RayCacheKey cache_key;
+    if (!this->coordToKeyChecked(origin, cache_key.origin) || !this->coordToKeyChecked(end, cache_key.end))
+      return this->computeRayKeys(origin, end, ray);
+
+    bool found = false;
+    bool known = false;
+#ifdef _OPENMP
+    #pragma omp critical (ray_cache)
+#endif
+    {
+      typename RayCacheMap::iterator it = ray_cache->map.find(cache_key);
+      if (it != ray_cache->map.end()) {
+        RayCacheEntry& entry = *(it->second);
+        ray_cache->hits++;
+        found = true;
+        // the keys of rays repeated within a scan were already returned
+        known = (entry.last_update == ray_cache->update);
+        if (!known) {
+          entry.last_update = ray_cache->update;
+          ray.reset();
+          for (size_t i = 0; i < entry.keys.size(); ++i)
+            ray.addKey(entry.keys[i]);
+        }
+        // most recently used ray moves to the front
+        ray_cache->list.splice(ray_cache->list.begin(), ray_cache->list, it->second);
+      }
+    }
+    if (found)
+      return !known;
+
+    // cast between the voxel centers, so the result only depends on the keys
+    if (!this->computeRayKeys(this->keyToCoord(cache_key.origin), this->keyToCoord(cache_key.end), ray))
+      return false;
+
+#ifdef _OPENMP
+    #pragma omp critical (ray_cache)
+#endif
+    {
+      ray_cache->misses++;
+      if (ray.size() <= ray_cache->max_keys && ray_cache->map.find(cache_key) == ray_cache->map.end()) {
+        ray_cache->list.push_front(RayCacheEntry(cache_key, ray, ray_cache->update));
+        ray_cache->map[cache_key] = ray_cache->list.begin();
+        ray_cache->num_keys += ray.size();
+        setRayCacheSize(ray_cache->max_keys);
+      }
+    }
+    return true;
+  }
+
   template <class NODE>
   NODE* OccupancyOcTreeBase<NODE>::setNodeValue(const OcTreeKey& key, float log_odds_value, bool lazy_eval) {
     // clamp log odds within range:
@@ -547,6 +691,165 @@ namespace octomap {
     }
   }
   
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::getFrontier(KeySet& frontier) const {
+    if (this->root == NULL)
+      return;
+
+    std::vector<const NODE*> path(this->tree_depth + 1, (const NODE*) NULL);
+    path[0] = this->root;
+    getFrontierRecurs(&path[0], 0, OcTreeKey(0, 0, 0), frontier);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::getFrontierRecurs(const NODE** path, unsigned int depth,
+                                                    const OcTreeKey& node_min, KeySet& frontier) const {
+    const NODE* node = path[depth];
+    assert(node);
+
+    if (depth < this->tree_depth && this->nodeHasChildren(node)) {
+      const unsigned int child_size = 1 << (this->tree_depth - depth - 1);
+      for (unsigned int i=0; i<8; i++) {
+        if (this->nodeChildExists(node, i)) {
+          OcTreeKey child_min = node_min;
+          for (unsigned int j=0; j<3; j++) {
+            if (i & (1 << j))
+              child_min[j] += child_size;
+          }
+          path[depth+1] = this->getNodeChild(node, i);
+          getFrontierRecurs(path, depth+1, child_min, frontier);
+        }
+      }
+      return;
+    }
+
+    // free leaf: check each face for unknown space on the other side
+    if (this->isNodeOccupied(node))
+      return;
+
+    const int size = 1 << (this->tree_depth - depth);
+    const int max_key = 2 * this->tree_max_val - 1;
+    for (unsigned int a=0; a<3; a++) {
+      const unsigned int u = (a+1) % 3;
+      const unsigned int v = (a+2) % 3;
+      for (int dir=-1; dir<=1; dir+=2) {
+        // voxel layer of this node at the face and of the neighbor behind it
+        const int face = (dir < 0) ? node_min[a] : node_min[a] + size - 1;
+        const int outside = face + dir;
+        if (outside < 0 || outside > max_key)
+          continue;
+
+        // neighbor of the same size, searched from the common ancestor
+        OcTreeKey neighbor_min = node_min;
+        neighbor_min[a] = (key_type) (node_min[a] + dir*size);
+        unsigned int differing_bits = node_min[a] ^ neighbor_min[a];
+        unsigned int common_depth = this->tree_depth;
+        while (differing_bits) {
+          differing_bits >>= 1;
+          common_depth--;
+        }
+        unsigned int neighbor_depth;
+        const NODE* neighbor = searchFrom(path[common_depth], common_depth, neighbor_min, depth, neighbor_depth);
+        if (neighbor && (neighbor_depth < depth || !this->nodeHasChildren(neighbor)))
+          continue; // completely known
+
+        OcTreeKey key = node_min;
+        key[a] = (key_type) face;
+        for (int i=0; i<size; i++) {
+          key[u] = (key_type) (node_min[u] + i);
+          for (int j=0; j<size; j++) {
+            key[v] = (key_type) (node_min[v] + j);
+            if (neighbor) {
+              // partially known neighbor, check the voxel behind the face
+              OcTreeKey outside_key = key;
+              outside_key[a] = (key_type) outside;
+              unsigned int found_depth;
+              if (searchFrom(neighbor, depth, outside_key, this->tree_depth, found_depth))
+                continue;
+            }
+            frontier.insert(key);
+          }
+        }
+      }
+    }
+  }
+
+  template <class NODE>
+  const NODE* OccupancyOcTreeBase<NODE>::searchFrom(const NODE* node, unsigned int depth, const OcTreeKey& key,
+                                                    unsigned int max_depth, unsigned int& found_depth) const {
+    assert(node);
+    while (depth < max_depth && this->nodeHasChildren(node)) {
+      unsigned int pos = computeChildIdx(key, this->tree_depth - 1 - depth);
+      if (!this->nodeChildExists(node, pos))
+        return NULL;
+      node = this->getNodeChild(node, pos);
+      depth++;
+    }
+    found_depth = depth;
+    return node;
+  }
+
+  template <class NODE>
+  const NODE* OccupancyOcTreeBase<NODE>::searchNeighbor(const NODE** path, unsigned int depth,
+                                                        const OcTreeKey& node_min, const OcTreeKey& key) const {
+    unsigned int differing_bits = (node_min[0] ^ key[0]) | (node_min[1] ^ key[1]) | (node_min[2] ^ key[2]);
+    unsigned int common_depth = this->tree_depth;
+    while (differing_bits) {
+      differing_bits >>= 1;
+      common_depth--;
+    }
+    if (common_depth > depth)
+      common_depth = depth;
+    unsigned int found_depth;
+    return searchFrom(path[common_depth], common_depth, key, this->tree_depth, found_depth);
+  }
+
+  template <class NODE>
+  bool OccupancyOcTreeBase<NODE>::isFrontier(const OcTreeKey& key) const {
+    const NODE* node = this->search(key);
+    if (node == NULL || this->isNodeOccupied(node))
+      return false;
+
+    const int max_key = 2 * this->tree_max_val - 1;
+    for (unsigned int a=0; a<3; a++) {
+      for (int dir=-1; dir<=1; dir+=2) {
+        int neighbor = key[a] + dir;
+        if (neighbor < 0 || neighbor > max_key)
+          continue;
+        OcTreeKey neighbor_key = key;
+        neighbor_key[a] = (key_type) neighbor;
+        if (this->search(neighbor_key) == NULL)
+          return true;
+      }
+    }
+    return false;
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::updateFrontier(KeySet& frontier) const {
+    if (!use_change_detection)
+      OCTOMAP_WARNING("updateFrontier() requires change detection, see enableChangeDetection()\n");
+
+    // only the changed voxels and their neighbors can change their frontier state
+    const int max_key = 2 * this->tree_max_val - 1;
+    for (KeyBoolMap::const_iterator it = changed_keys.begin(); it != changed_keys.end(); ++it) {
+      for (int n=0; n<7; n++) {
+        OcTreeKey key = it->first;
+        if (n > 0) {
+          int a = (n-1) / 2;
+          int neighbor = key[a] + ((n % 2) ? -1 : 1);
+          if (neighbor < 0 || neighbor > max_key)
+            continue;
+          key[a] = (key_type) neighbor;
+        }
+        if (isFrontier(key))
+          frontier.insert(key);
+        else
+          frontier.erase(key);
+      }
+    }
+  }
+
   template <class NODE>
   bool OccupancyOcTreeBase<NODE>::getNormals(const point3d& point, std::vector<point3d>& normals,
                                              bool unknownStatus) const {
@@ -634,7 +937,351 @@ namespace octomap {
 
     return true;
   }
-  
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::getSurfaceNormals(const std::vector<OcTreeKey>& keys, std::vector<point3d>& normals,
+                                                    bool unknownStatus) const {
+    normals.assign(keys.size(), point3d(0, 0, 0));
+    if (keys.empty())
+      return;
+
+    // sum of the triangle normals for each cube configuration (vertices at the edge centers)
+    point3d cube_normals[256];
+    for (int cube_index = 0; cube_index < 256; cube_index++) {
+      for (int i = 0; triTable[cube_index][i] != -1; i += 3) {
+        point3d p[3];
+        for (unsigned int m = 0; m < 3; m++) {
+          const int e = triTable[cube_index][i+m];
+          const unsigned int* corner = cornerOffsets[edgeCorners[e][0]];
+          p[m] = point3d((float) corner[0], (float) corner[1], (float) corner[2]);
+          p[m](edgeAxis[e]) += 0.5f;
+        }
+        // wound as in getMesh()
+        cube_normals[cube_index] += (p[2] - p[0]).cross(p[1] - p[0]);
+      }
+    }
+
+    // Morton order of the keys, consecutive queries share most of their path in the tree
+    const int n = (int) keys.size();
+    std::vector<std::pair<uint64_t, int> > order(n);
+    for (int i = 0; i < n; i++) {
+      uint64_t code = 0;
+      for (unsigned int b = 0; b < 16; b++) {
+        for (unsigned int j = 0; j < 3; j++)
+          code |= (uint64_t) ((keys[i][j] >> b) & 1) << (3*b + j);
+      }
+      order[i] = std::make_pair(code, i);
+    }
+    std::sort(order.begin(), order.end());
+
+    const int max_key = 2 * this->tree_max_val - 1;
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+      // path[0..path_depth] are the existing ancestors of path_key
+      std::vector<const NODE*> path(this->tree_depth + 1, (const NODE*) NULL);
+      path[0] = this->root;
+      OcTreeKey path_key (0, 0, 0);
+      unsigned int path_depth = 0;
+
+#ifdef _OPENMP
+      #pragma omp for schedule(dynamic, 256)
+#endif
+      for (int i = 0; i < n; i++) {
+        const OcTreeKey& key = keys[order[i].second];
+
+        // continue the path of the previous query below the common ancestor
+        unsigned int differing_bits = (path_key[0] ^ key[0]) | (path_key[1] ^ key[1]) | (path_key[2] ^ key[2]);
+        unsigned int depth = this->tree_depth;
+        while (differing_bits) {
+          differing_bits >>= 1;
+          depth--;
+        }
+        depth = std::min(depth, path_depth);
+        while (path[depth] && depth < this->tree_depth && this->nodeHasChildren(path[depth])) {
+          unsigned int pos = computeChildIdx(key, this->tree_depth - 1 - depth);
+          if (!this->nodeChildExists(path[depth], pos))
+            break;
+          path[depth+1] = this->getNodeChild(path[depth], pos);
+          depth++;
+        }
+        path_key = key;
+        path_depth = depth;
+        if (path[0] == NULL)
+          continue; // empty tree
+
+        OcTreeKey node_min;
+        const unsigned int size = 1 << (this->tree_depth - depth);
+        for (unsigned int j=0; j<3; j++)
+          node_min[j] = (key_type) (key[j] & ~(size - 1));
+
+        // occupancy of the 3x3x3 neighborhood
+        bool occupied[3][3][3];
+        OcTreeKey neighbor;
+        for (int x=0; x<3; x++) {
+          for (int y=0; y<3; y++) {
+            for (int z=0; z<3; z++) {
+              const int offset[3] = {x, y, z};
+              bool valid = true;
+              for (unsigned int j=0; j<3; j++) {
+                int k = key[j] + offset[j] - 1;
+                if (k < 0 || k > max_key)
+                  valid = false;
+                neighbor[j] = (key_type) k;
+              }
+              const NODE* node = valid ? searchNeighbor(&path[0], depth, node_min, neighbor) : NULL;
+              occupied[x][y][z] = node ? this->isNodeOccupied(node) : unknownStatus;
+            }
+          }
+        }
+
+        // the 8 cubes with a corner at the voxel center
+        point3d normal (0, 0, 0);
+        for (unsigned int c=0; c<8; c++) {
+          const unsigned int* cube = cornerOffsets[c];
+          int cube_index = 0;
+          for (unsigned int v=0; v<8; v++) {
+            const unsigned int* corner = cornerOffsets[v];
+            if (occupied[cube[0] + corner[0]][cube[1] + corner[1]][cube[2] + corner[2]])
+              cube_index |= 1 << v;
+          }
+          normal += cube_normals[cube_index];
+        }
+        if (normal.norm() > 0)
+          normals[order[i].second] = normal.normalize();
+      }
+    }
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::getMesh(std::vector<point3d>& vertices, std::vector<unsigned int>& triangles,
+                                          bool interpolate, bool unknownStatus) const {
+    const key_type max_key = (key_type) (2 * this->tree_max_val - 1);
+    getMesh(vertices, triangles, OcTreeKey(0, 0, 0), OcTreeKey(max_key, max_key, max_key),
+            interpolate, unknownStatus);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::getMesh(std::vector<point3d>& vertices, std::vector<unsigned int>& triangles,
+                                          const point3d& bbx_min, const point3d& bbx_max,
+                                          bool interpolate, bool unknownStatus) const {
+    OcTreeKey min_key, max_key;
+    if (!this->coordToKeyChecked(bbx_min, min_key) || !this->coordToKeyChecked(bbx_max, max_key)) {
+      OCTOMAP_ERROR_STR("Bounding box " << bbx_min << " - " << bbx_max << " is out of the tree bounds in getMesh");
+      vertices.clear();
+      triangles.clear();
+      return;
+    }
+    getMesh(vertices, triangles, min_key, max_key, interpolate, unknownStatus);
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::getMesh(std::vector<point3d>& vertices, std::vector<unsigned int>& triangles,
+                                          const OcTreeKey& bbx_min, const OcTreeKey& bbx_max,
+                                          bool interpolate, bool unknownStatus) const {
+    vertices.clear();
+    triangles.clear();
+    if (this->root == NULL)
+      return;
+
+    // cubes are identified by their minimum corner, all corners need to be in the bbx
+    OcTreeKey cube_min = bbx_min;
+    OcTreeKey cube_max;
+    for (unsigned int j=0; j<3; j++) {
+      if (bbx_max[j] <= bbx_min[j])
+        return;
+      cube_max[j] = (key_type) (bbx_max[j] - 1);
+    }
+
+    // subtrees (or leaves above them) which are meshed independently, a leaf can
+    // mesh cubes with minimum corner one voxel below it
+    const unsigned int split_depth = std::min(this->tree_depth, 4u);
+    std::vector<MeshPart> parts;
+    typedef typename OcTreeBaseImpl<NODE,AbstractOccupancyOcTree>::leaf_iterator leaf_iterator;
+    for (leaf_iterator it = this->begin_leafs((unsigned char) split_depth), end = this->end_leafs(); it != end; ++it) {
+      MeshPart part;
+      part.depth = it.getDepth();
+      part.node_min = it.getIndexKey();
+      const unsigned int size = 1 << (this->tree_depth - part.depth);
+      bool in_bbx = true;
+      for (unsigned int j=0; j<3; j++) {
+        if (part.node_min[j] > cube_max[j] + 1 || part.node_min[j] + size < cube_min[j])
+          in_bbx = false;
+      }
+      if (in_bbx)
+        parts.push_back(part);
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < (int) parts.size(); i++) {
+      MeshPart& part = parts[i];
+      std::vector<const NODE*> path(this->tree_depth + 1, (const NODE*) NULL);
+      path[0] = this->root;
+      for (unsigned int depth = 0; depth < part.depth; depth++)
+        path[depth+1] = this->getNodeChild(path[depth], computeChildIdx(part.node_min, this->tree_depth - 1 - depth));
+      getMeshRecurs(&path[0], part.depth, part.node_min, cube_min, cube_max, interpolate, unknownStatus, part);
+    }
+
+    // merge the parts, each vertex is created by all cubes sharing its edge
+    std::vector<MeshVertex> mesh_vertices;
+    std::vector<size_t> triangle_offsets(parts.size() + 1, 0);
+    for (size_t i = 0; i < parts.size(); i++) {
+      mesh_vertices.insert(mesh_vertices.end(), parts[i].vertices.begin(), parts[i].vertices.end());
+      std::vector<MeshVertex>().swap(parts[i].vertices);
+      triangle_offsets[i+1] = triangle_offsets[i] + parts[i].triangles.size();
+    }
+    std::sort(mesh_vertices.begin(), mesh_vertices.end());
+    mesh_vertices.erase(std::unique(mesh_vertices.begin(), mesh_vertices.end()), mesh_vertices.end());
+
+    vertices.reserve(mesh_vertices.size());
+    for (size_t i = 0; i < mesh_vertices.size(); i++)
+      vertices.push_back(mesh_vertices[i].coord);
+
+    triangles.resize(triangle_offsets.back());
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < (int) parts.size(); i++) {
+      const std::vector<uint64_t>& ids = parts[i].triangles;
+      MeshVertex vertex;
+      for (size_t j = 0; j < ids.size(); j++) {
+        vertex.id = ids[j];
+        triangles[triangle_offsets[i] + j] = (unsigned int)
+          (std::lower_bound(mesh_vertices.begin(), mesh_vertices.end(), vertex) - mesh_vertices.begin());
+      }
+    }
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::getMeshRecurs(const NODE** path, unsigned int depth, const OcTreeKey& node_min,
+                                                const OcTreeKey& cube_min, const OcTreeKey& cube_max,
+                                                bool interpolate, bool unknownStatus, MeshPart& part) const {
+    const NODE* node = path[depth];
+    assert(node);
+
+    if (depth < this->tree_depth && this->nodeHasChildren(node)) {
+      const unsigned int child_size = 1 << (this->tree_depth - depth - 1);
+      for (unsigned int i=0; i<8; i++) {
+        if (!this->nodeChildExists(node, i))
+          continue;
+        OcTreeKey child_min;
+        bool in_bbx = true;
+        for (unsigned int j=0; j<3; j++) {
+          unsigned int min = node_min[j] + ((i & (1 << j)) ? child_size : 0);
+          child_min[j] = (key_type) min;
+          // a leaf also owns cubes with minimum corner one voxel below it
+          if (min > cube_max[j] + 1u || min + child_size < cube_min[j])
+            in_bbx = false;
+        }
+        if (in_bbx) {
+          path[depth+1] = this->getNodeChild(node, i);
+          getMeshRecurs(path, depth+1, child_min, cube_min, cube_max, interpolate, unknownStatus, part);
+        }
+      }
+      return;
+    }
+
+    // leaf: all cubes with a corner in it, except for the cubes inside (with equal corners)
+    const int size = 1 << (this->tree_depth - depth);
+    int lo[3], hi[3];
+    for (unsigned int j=0; j<3; j++) {
+      lo[j] = std::max(node_min[j] - 1, (int) cube_min[j]);
+      hi[j] = std::min(node_min[j] + size - 1, (int) cube_max[j]);
+    }
+    OcTreeKey cube;
+    for (int x = lo[0]; x <= hi[0]; x++) {
+      cube[0] = (key_type) x;
+      const bool x_inside = (x >= node_min[0] && x < node_min[0] + size - 1);
+      for (int y = lo[1]; y <= hi[1]; y++) {
+        cube[1] = (key_type) y;
+        const bool xy_inside = x_inside && (y >= node_min[1] && y < node_min[1] + size - 1);
+        for (int z = lo[2]; z <= hi[2]; z++) {
+          if (xy_inside && z >= node_min[2] && z < node_min[2] + size - 1) {
+            z = node_min[2] + size - 2;
+            continue;
+          }
+          cube[2] = (key_type) z;
+          getMeshCube(path, depth, node_min, cube, interpolate, unknownStatus, part);
+        }
+      }
+    }
+  }
+
+  template <class NODE>
+  void OccupancyOcTreeBase<NODE>::getMeshCube(const NODE** path, unsigned int depth, const OcTreeKey& node_min,
+                                              const OcTreeKey& cube, bool interpolate, bool unknownStatus,
+                                              MeshPart& part) const {
+    const NODE* node = path[depth];
+    const unsigned int size = 1 << (this->tree_depth - depth);
+    const NODE* corners[8];
+    bool owned = false;
+    for (unsigned int i=0; i<8; i++) {
+      OcTreeKey key;
+      bool inside = true;
+      for (unsigned int j=0; j<3; j++) {
+        key[j] = (key_type) (cube[j] + cornerOffsets[i][j]);
+        if (key[j] < node_min[j] || key[j] >= node_min[j] + size)
+          inside = false;
+      }
+      corners[i] = inside ? node : searchNeighbor(path, depth, node_min, key);
+
+      // the cube belongs to the leaf of its first known corner
+      if (!owned && corners[i]) {
+        if (corners[i] != node)
+          return;
+        owned = true;
+      }
+    }
+
+    int cube_index = 0;
+    float values[8];
+    for (unsigned int i=0; i<8; i++) {
+      bool occupied = corners[i] ? this->isNodeOccupied(corners[i]) : unknownStatus;
+      if (occupied)
+        cube_index |= 1 << i;
+      if (corners[i])
+        values[i] = corners[i]->getLogOdds();
+      else
+        values[i] = unknownStatus ? this->clamping_thres_max : this->clamping_thres_min;
+    }
+    if (edgeTable[cube_index] == 0)
+      return;
+
+    uint64_t edge_ids[12];
+    for (unsigned int e=0; e<12; e++) {
+      if (!(edgeTable[cube_index] & (1 << e)))
+        continue;
+      const unsigned int a = edgeCorners[e][0];
+      const unsigned int b = edgeCorners[e][1];
+      OcTreeKey key_a;
+      for (unsigned int j=0; j<3; j++)
+        key_a[j] = (key_type) (cube[j] + cornerOffsets[a][j]);
+      edge_ids[e] = ((uint64_t) key_a[0] << 34) | ((uint64_t) key_a[1] << 18)
+                    | ((uint64_t) key_a[2] << 2) | edgeAxis[e];
+
+      double t = 0.5;
+      if (interpolate) {
+        t = (this->occ_prob_thres_log - values[a]) / (values[b] - values[a]);
+        t = std::min(std::max(t, 0.0), 1.0);
+      }
+      MeshVertex vertex;
+      vertex.id = edge_ids[e];
+      vertex.coord = this->keyToCoord(key_a);
+      vertex.coord(edgeAxis[e]) += (float) (t * this->resolution);
+      part.vertices.push_back(vertex);
+    }
+
+    // the tables wind triangles clockwise seen from free space
+    for (int i = 0; triTable[cube_index][i] != -1; i += 3) {
+      part.triangles.push_back(edge_ids[triTable[cube_index][i  ]]);
+      part.triangles.push_back(edge_ids[triTable[cube_index][i+2]]);
+      part.triangles.push_back(edge_ids[triTable[cube_index][i+1]]);
+    }
+  }
+
   template <class NODE>
   bool OccupancyOcTreeBase<NODE>::castRay(const point3d& origin, const point3d& directionP, point3d& end, 
                                           bool ignoreUnknown, double maxRange) const {
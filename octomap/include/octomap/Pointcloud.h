@@ -74,9 +74,16 @@ namespace octomap {
     /// Export the Pointcloud to a VRML file
     void writeVrml(std::string filename);
 
-    /// Apply transform to each point
+    /**
+     * Apply transform to each point. The rotation is converted to a 3x3 matrix
+     * once for all points, large point clouds are transformed in parallel
+     * when OpenMP is enabled.
+     */
     void transform(pose6d transform);
 
+    /// Set the points to the points of other with transform applied, in a single pass
+    void setTransformed(const Pointcloud& other, pose6d transform);
+
     /// Rotate each point in pointcloud
     void rotate(double roll, double pitch, double yaw);
 
@@ -93,6 +100,20 @@ namespace octomap {
 
     void subSampleRandom(unsigned int num_samples, Pointcloud& sample_cloud);
 
+    /**
+     * Voxel grid filter: replaces all points within a cube of edge length voxel_size
+     * by a single point, the cube's center or the centroid of its points. The grid
+     * is aligned like the octree grid, i.e., with voxel_size = OcTree::getNodeSize(depth)
+     * the points are reduced to one per octree node at depth. The points are sorted by
+     * the Morton code of their voxel (parallel with OpenMP), so that the result is
+     * spatially ordered. Clouds spanning more than 2^21 voxels along an axis are
+     * sorted by voxel index instead.
+     *
+     * @param voxel_size edge length of the voxels
+     * @param centroids keep the centroid of the points in a voxel instead of its center
+     */
+    void voxelFilter(double voxel_size, bool centroids = false);
+
     // iterators ------------------
 
     typedef point3d_collection::iterator iterator;
@@ -120,6 +141,66 @@ namespace octomap {
     point3d_collection   points;
   };
 
+
+  /**
+   * Point cloud stored as structure of arrays (separate x, y and z arrays), so
+   * that the loops over all points in transform(), crop(), minDist() and
+   * calcBBX() vectorize. It can be inserted like a Pointcloud, see
+   * OccupancyOcTreeBase::insertPointCloud(const PointcloudSoA&, const point3d&, double, bool, bool).
+   */
+  class PointcloudSoA {
+
+  public:
+
+    PointcloudSoA() {}
+    /// Copies the points of a Pointcloud
+    explicit PointcloudSoA(const Pointcloud& other);
+
+    size_t size() const {  return xs.size(); }
+    void clear();
+    void reserve(size_t size);
+
+    inline void push_back(float x, float y, float z) {
+      xs.push_back(x);
+      ys.push_back(y);
+      zs.push_back(z);
+    }
+    inline void push_back(const point3d& p) {
+      push_back(p(0), p(1), p(2));
+    }
+
+    /// Returns a copy of the ith point
+    inline point3d operator[] (size_t i) const { return point3d(xs[i], ys[i], zs[i]); }
+
+    /// Sets the points to those of a Pointcloud
+    void setFromPointcloud(const Pointcloud& other);
+    /// Sets the points of cloud to the points of this
+    void toPointcloud(Pointcloud& cloud) const;
+
+    /// Apply transform to each point
+    void transform(pose6d transform);
+
+    /// Calculate bounding box of the points
+    void calcBBX(point3d& lowerBound, point3d& upperBound) const;
+    /// Crop to given bounding box
+    void crop(point3d lowerBound, point3d upperBound);
+    /// Removes any points closer than thres to (0,0,0)
+    void minDist(double thres);
+
+    /// Direct access to the coordinate arrays, each has size() elements
+    inline const float* x() const { return xs.empty() ? NULL : &xs[0]; }
+    inline const float* y() const { return ys.empty() ? NULL : &ys[0]; }
+    inline const float* z() const { return zs.empty() ? NULL : &zs[0]; }
+
+  protected:
+    /// shrinks the arrays to the first size points
+    void resize(size_t size);
+
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<float> zs;
+  };
+
 }
 
 
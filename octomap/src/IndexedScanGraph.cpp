@@ -0,0 +1,502 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstring>
+#include <limits>
+
+#include <octomap/IndexedScanGraph.h>
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+namespace octomap {
+
+  static const std::string INDEXED_FILE_HEADER = "# OctoMap indexed scan graph file";
+  static const uint32_t INDEXED_FILE_VERSION = 1;
+
+  // size of a point in regular .graph files (Vector3::writeBinary) and indexed files
+  static const uint64_t GRAPH_POINT_SIZE = sizeof(int32_t) + 3*sizeof(double);
+  static const uint64_t INDEXED_POINT_SIZE = 3*sizeof(float);
+
+
+  IndexedScanGraph::IndexedScanGraph()
+    : format(FORMAT_NONE), mapped_data(NULL), mapped_size(0) {
+  }
+
+  IndexedScanGraph::IndexedScanGraph(const std::string& filename)
+    : format(FORMAT_NONE), mapped_data(NULL), mapped_size(0) {
+    open(filename);
+  }
+
+  IndexedScanGraph::~IndexedScanGraph() {
+    close();
+  }
+
+  bool IndexedScanGraph::open(const std::string& filename) {
+    close();
+
+    file.open(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!file.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing read.");
+      return false;
+    }
+
+    // regular .graph files start with the number of nodes instead of the header
+    std::string header(INDEXED_FILE_HEADER.size() + 1, '\0');
+    file.read(&header[0], header.size());
+    bool ok;
+    if (!file.fail() && header == INDEXED_FILE_HEADER + "\n") {
+      format = FORMAT_INDEXED;
+      ok = readIndexedIndex(file);
+    }
+    else {
+      format = FORMAT_GRAPH;
+      file.clear();
+      file.seekg(0);
+      ok = readGraphIndex(file);
+    }
+
+    if (!ok) {
+      OCTOMAP_ERROR_STR("Could not read scan graph index from " << filename);
+      close();
+      return false;
+    }
+
+    for (size_t i = 0; i < nodes.size(); ++i)
+      node_index[nodes[i].id] = i;
+
+    // the stream stays open as fallback if the file cannot be mapped
+    file.clear();
+    if (mapFile(filename))
+      file.close();
+
+    OCTOMAP_DEBUG("Indexed %u nodes and %u edges of %s\n", (unsigned int) nodes.size(),
+                  (unsigned int) edges.size(), filename.c_str());
+    return true;
+  }
+
+  void IndexedScanGraph::close() {
+#ifndef _WIN32
+    if (mapped_data != NULL)
+      munmap((void*) mapped_data, (size_t) mapped_size);
+#endif
+    mapped_data = NULL;
+    mapped_size = 0;
+    if (file.is_open())
+      file.close();
+    file.clear();
+
+    format = FORMAT_NONE;
+    nodes.clear();
+    edges.clear();
+    node_index.clear();
+  }
+
+  bool IndexedScanGraph::readGraphIndex(std::istream& s) {
+
+    // file structure:    n | node_1 | ... | node_n | m | edge_1 | ... | edge_m
+    // node:              num_points | points | pose | id
+
+    uint32_t graph_size = 0;
+    s.read((char*)&graph_size, sizeof(graph_size));
+    if (s.fail())
+      return false;
+
+    nodes.resize(graph_size);
+    for (uint32_t i = 0; i < graph_size; ++i) {
+      NodeInfo& node = nodes[i];
+      uint32_t num_points = 0;
+      s.read((char*)&num_points, sizeof(num_points));
+      node.num_points = num_points;
+      node.offset = (uint64_t) s.tellg();
+      // skip over the scan without reading it
+      s.seekg((std::streamoff) (num_points * GRAPH_POINT_SIZE), std::ios_base::cur);
+      node.pose.readBinary(s);
+      uint32_t id = 0;
+      s.read((char*)&id, sizeof(id));
+      node.id = id;
+      if (s.fail()) {
+        OCTOMAP_ERROR("IndexedScanGraph: could not read node %u of %u.\n", i, graph_size);
+        return false;
+      }
+    }
+
+    uint32_t num_edges = 0;
+    s.read((char*)&num_edges, sizeof(num_edges));
+    if (s.fail()) // graphs without edges section
+      return true;
+
+    edges.resize(num_edges);
+    for (uint32_t i = 0; i < num_edges; ++i) {
+      EdgeInfo& edge = edges[i];
+      s.read((char*)&edge.first_id, sizeof(edge.first_id));
+      s.read((char*)&edge.second_id, sizeof(edge.second_id));
+      edge.constraint.readBinary(s);
+      s.read((char*)&edge.weight, sizeof(edge.weight));
+      if (s.fail()) {
+        OCTOMAP_ERROR("IndexedScanGraph: could not read edge %u of %u.\n", i, num_edges);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool IndexedScanGraph::readIndexedIndex(std::istream& s) {
+    uint32_t version = 0;
+    s.read((char*)&version, sizeof(version));
+    if (s.fail() || version != INDEXED_FILE_VERSION) {
+      OCTOMAP_ERROR("IndexedScanGraph: unsupported file version %u.\n", version);
+      return false;
+    }
+
+    // the scans are stored between the header and the index
+    uint64_t scans_begin = (uint64_t) s.tellg();
+    uint64_t index_offset = 0;
+    s.seekg(-(std::streamoff) sizeof(index_offset), std::ios_base::end);
+    uint64_t index_end = (uint64_t) s.tellg();
+    s.read((char*)&index_offset, sizeof(index_offset));
+    if (s.fail() || index_offset < scans_begin || index_offset > index_end) {
+      OCTOMAP_ERROR("IndexedScanGraph: invalid index offset.\n");
+      return false;
+    }
+    s.seekg((std::streamoff) index_offset);
+
+    uint32_t graph_size = 0;
+    s.read((char*)&graph_size, sizeof(graph_size));
+    if (s.fail())
+      return false;
+
+    nodes.resize(graph_size);
+    for (uint32_t i = 0; i < graph_size; ++i) {
+      NodeInfo& node = nodes[i];
+      uint32_t id = 0;
+      s.read((char*)&id, sizeof(id));
+      node.id = id;
+      node.pose.readBinary(s);
+      s.read((char*)&node.num_points, sizeof(node.num_points));
+      s.read((char*)&node.offset, sizeof(node.offset));
+      if (s.fail()) {
+        OCTOMAP_ERROR("IndexedScanGraph: could not read node %u of %u.\n", i, graph_size);
+        return false;
+      }
+      // reject scans outside of the file before readScan() allocates them
+      if (node.offset < scans_begin || node.offset > index_offset
+          || node.num_points > (index_offset - node.offset) / INDEXED_POINT_SIZE) {
+        OCTOMAP_ERROR("IndexedScanGraph: scan of node %u exceeds the file.\n", node.id);
+        return false;
+      }
+    }
+
+    uint32_t num_edges = 0;
+    s.read((char*)&num_edges, sizeof(num_edges));
+    edges.resize(num_edges);
+    for (uint32_t i = 0; i < num_edges; ++i) {
+      EdgeInfo& edge = edges[i];
+      s.read((char*)&edge.first_id, sizeof(edge.first_id));
+      s.read((char*)&edge.second_id, sizeof(edge.second_id));
+      edge.constraint.readBinary(s);
+      s.read((char*)&edge.weight, sizeof(edge.weight));
+    }
+
+    return !s.fail();
+  }
+
+  bool IndexedScanGraph::mapFile(const std::string& filename) {
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0
+        || (uint64_t) st.st_size > (uint64_t) std::numeric_limits<size_t>::max()) {
+      ::close(fd);
+      return false;
+    }
+
+    void* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping stays valid
+    if (data == MAP_FAILED)
+      return false;
+
+    madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+    mapped_data = (const char*) data;
+    mapped_size = (uint64_t) st.st_size;
+    return true;
+#else
+    (void) filename;
+    return false;
+#endif
+  }
+
+  bool IndexedScanGraph::readBytes(uint64_t offset, uint64_t length, char* data) const {
+    if (mapped_data != NULL) {
+      if (offset + length > mapped_size)
+        return false;
+      memcpy(data, mapped_data + offset, (size_t) length);
+      return true;
+    }
+
+    file.clear();
+    file.seekg((std::streamoff) offset);
+    file.read(data, (std::streamsize) length);
+    return !file.fail();
+  }
+
+  void IndexedScanGraph::releaseBytes(uint64_t offset, uint64_t length) const {
+#ifndef _WIN32
+    if (mapped_data == NULL || length == 0)
+      return;
+    // the pages are read from the file again when needed
+    uint64_t page_size = (uint64_t) sysconf(_SC_PAGESIZE);
+    uint64_t begin = offset - (offset % page_size);
+    madvise((void*) (mapped_data + begin), (size_t) (offset + length - begin), MADV_DONTNEED);
+#else
+    (void) offset;
+    (void) length;
+#endif
+  }
+
+  size_t IndexedScanGraph::findNode(unsigned int id) const {
+    std::map<unsigned int, size_t>::const_iterator it = node_index.find(id);
+    if (it == node_index.end())
+      return nodes.size();
+    return it->second;
+  }
+
+  size_t IndexedScanGraph::getNumPoints(unsigned int max_id) const {
+    size_t retval = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      retval += (size_t) nodes[i].num_points;
+      if ((max_id > 0) && (nodes[i].id == max_id)) break;
+    }
+    return retval;
+  }
+
+  bool IndexedScanGraph::readScan(size_t index, Pointcloud& scan) const {
+    scan.clear();
+    if (index >= nodes.size()) {
+      OCTOMAP_ERROR("IndexedScanGraph::readScan: invalid node index %u.\n", (unsigned int) index);
+      return false;
+    }
+
+    const NodeInfo& node = nodes[index];
+    uint64_t point_size = (format == FORMAT_INDEXED) ? INDEXED_POINT_SIZE : GRAPH_POINT_SIZE;
+    uint64_t length = node.num_points * point_size;
+    if (length == 0)
+      return true;
+
+    std::vector<char> buffer((size_t) length);
+    if (!readBytes(node.offset, length, &buffer[0])) {
+      OCTOMAP_ERROR("IndexedScanGraph::readScan: could not read scan of node %u.\n", node.id);
+      return false;
+    }
+    releaseBytes(node.offset, length);
+
+    scan.reserve((size_t) node.num_points);
+    const char* p = &buffer[0];
+    if (format == FORMAT_INDEXED) {
+      float coords[3];
+      for (uint64_t i = 0; i < node.num_points; ++i, p += INDEXED_POINT_SIZE) {
+        memcpy(coords, p, sizeof(coords));
+        scan.push_back(coords[0], coords[1], coords[2]);
+      }
+    }
+    else {
+      double coords[3];
+      for (uint64_t i = 0; i < node.num_points; ++i, p += GRAPH_POINT_SIZE) {
+        memcpy(coords, p + sizeof(int32_t), sizeof(coords));
+        scan.push_back((float) coords[0], (float) coords[1], (float) coords[2]);
+      }
+    }
+    return true;
+  }
+
+  ScanNode* IndexedScanGraph::readNode(size_t index) const {
+    Pointcloud* scan = new Pointcloud();
+    if (!readScan(index, *scan)) {
+      delete scan;
+      return NULL;
+    }
+    return new ScanNode(scan, nodes[index].pose, nodes[index].id);
+  }
+
+  ScanNode* IndexedScanGraph::readNodeByID(unsigned int id) const {
+    size_t index = findNode(id);
+    if (index == nodes.size()) {
+      OCTOMAP_ERROR("IndexedScanGraph::readNodeByID: node %u not found.\n", id);
+      return NULL;
+    }
+    return readNode(index);
+  }
+
+  bool IndexedScanGraph::readScanGraph(ScanGraph& graph) const {
+    graph.clear();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      Pointcloud* scan = new Pointcloud();
+      if (!readScan(i, *scan)) {
+        delete scan;
+        return false;
+      }
+      graph.addNode(scan, nodes[i].pose)->id = nodes[i].id;
+    }
+
+    for (size_t i = 0; i < edges.size(); ++i) {
+      ScanEdge* edge = graph.addEdge(graph.getNodeByID(edges[i].first_id),
+                                     graph.getNodeByID(edges[i].second_id), edges[i].constraint);
+      if (edge == NULL)
+        return false;
+      edge->weight = edges[i].weight;
+    }
+    return true;
+  }
+
+  std::ostream& IndexedScanGraph::writeHeader(std::ostream& s) {
+    s << INDEXED_FILE_HEADER << "\n";
+    s.write((char*)&INDEXED_FILE_VERSION, sizeof(INDEXED_FILE_VERSION));
+    return s;
+  }
+
+  std::ostream& IndexedScanGraph::writeScan(std::ostream& s, const Pointcloud& scan) {
+    std::vector<float> coords(3*scan.size());
+    for (size_t i = 0; i < scan.size(); ++i) {
+      coords[3*i]   = scan[i].x();
+      coords[3*i+1] = scan[i].y();
+      coords[3*i+2] = scan[i].z();
+    }
+    if (!coords.empty())
+      s.write((char*)&coords[0], coords.size()*sizeof(float));
+    return s;
+  }
+
+  std::ostream& IndexedScanGraph::writeIndex(std::ostream& s, const std::vector<NodeInfo>& nodes,
+                                             const std::vector<EdgeInfo>& edges) {
+
+    // index structure:   n | node_1 | ... | node_n | m | edge_1 | ... | edge_m | index offset
+    // node:              id | pose | num_points | offset
+    // edge:              first_id | second_id | constraint | weight
+
+    uint64_t index_offset = (uint64_t) s.tellp();
+
+    uint32_t graph_size = (uint32_t) nodes.size();
+    s.write((char*)&graph_size, sizeof(graph_size));
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      uint32_t id = nodes[i].id;
+      s.write((char*)&id, sizeof(id));
+      nodes[i].pose.writeBinary(s);
+      s.write((char*)&nodes[i].num_points, sizeof(nodes[i].num_points));
+      s.write((char*)&nodes[i].offset, sizeof(nodes[i].offset));
+    }
+
+    uint32_t num_edges = (uint32_t) edges.size();
+    s.write((char*)&num_edges, sizeof(num_edges));
+    for (size_t i = 0; i < edges.size(); ++i) {
+      s.write((char*)&edges[i].first_id, sizeof(edges[i].first_id));
+      s.write((char*)&edges[i].second_id, sizeof(edges[i].second_id));
+      edges[i].constraint.writeBinary(s);
+      s.write((char*)&edges[i].weight, sizeof(edges[i].weight));
+    }
+
+    s.write((char*)&index_offset, sizeof(index_offset));
+    return s;
+  }
+
+  bool IndexedScanGraph::write(const std::string& filename) const {
+    if (!isOpen()) {
+      OCTOMAP_ERROR("IndexedScanGraph::write: no graph opened, nothing written.\n");
+      return false;
+    }
+
+    std::ofstream outfile(filename.c_str(), std::ios_base::binary);
+    if (!outfile.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing written.");
+      return false;
+    }
+
+    writeHeader(outfile);
+    std::vector<NodeInfo> written_nodes(nodes);
+    Pointcloud scan;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      if (!readScan(i, scan))
+        return false;
+      written_nodes[i].offset = (uint64_t) outfile.tellp();
+      writeScan(outfile, scan);
+    }
+    writeIndex(outfile, written_nodes, edges);
+
+    outfile.close();
+    return !outfile.fail();
+  }
+
+  bool IndexedScanGraph::write(const ScanGraph& graph, const std::string& filename) {
+    std::ofstream outfile(filename.c_str(), std::ios_base::binary);
+    if (!outfile.is_open()){
+      OCTOMAP_ERROR_STR("Filestream to "<< filename << " not open, nothing written.");
+      return false;
+    }
+
+    writeHeader(outfile);
+    std::vector<NodeInfo> written_nodes;
+    written_nodes.reserve(graph.size());
+    for (ScanGraph::const_iterator it = graph.begin(); it != graph.end(); ++it) {
+      NodeInfo node;
+      node.id = (*it)->id;
+      node.pose = (*it)->pose;
+      node.num_points = (*it)->scan->size();
+      node.offset = (uint64_t) outfile.tellp();
+      writeScan(outfile, *(*it)->scan);
+      written_nodes.push_back(node);
+    }
+
+    std::vector<EdgeInfo> written_edges;
+    written_edges.reserve(graph.edges_end() - graph.edges_begin());
+    for (ScanGraph::const_edge_iterator it = graph.edges_begin(); it != graph.edges_end(); ++it) {
+      EdgeInfo edge;
+      edge.first_id = (*it)->first->id;
+      edge.second_id = (*it)->second->id;
+      edge.constraint = (*it)->constraint;
+      edge.weight = (*it)->weight;
+      written_edges.push_back(edge);
+    }
+    writeIndex(outfile, written_nodes, written_edges);
+
+    outfile.close();
+    return !outfile.fail();
+  }
+
+} // end namespace
@@ -33,34 +33,112 @@
 
 #include "octomap/OcTreeStamped.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace octomap {
 
+  unsigned int OcTreeNodeStamped::getMinChildTimestamp() const{
+    unsigned int min = std::numeric_limits<unsigned int>::max();
+
+    if (children !=NULL){
+      for (unsigned int i=0; i<8; i++) {
+        if (children[i] != NULL) {
+          unsigned int t = static_cast<OcTreeNodeStamped*>(children[i])->getTimestamp();
+          if (t < min)
+            min = t;
+        }
+      }
+    }
+    return min;
+  }
+
+  std::ostream& OcTreeNodeStamped::writeData(std::ostream &s) const {
+    s.write((const char*) &value, sizeof(value)); // occupancy
+    s.write((const char*) &timestamp, sizeof(timestamp)); // timestamp
+
+    return s;
+  }
+
+  std::istream& OcTreeNodeStamped::readData(std::istream &s) {
+    s.read((char*) &value, sizeof(value)); // occupancy
+    s.read((char*) &timestamp, sizeof(timestamp)); // timestamp
+
+    return s;
+  }
+
   OcTreeStamped::OcTreeStamped(double resolution)
-   : OccupancyOcTreeBase<OcTreeNodeStamped>(resolution) {
+   : OccupancyOcTreeBase<OcTreeNodeStamped>(resolution),
+     current_time(0), use_current_time(false), last_update_time(0) {
     ocTreeStampedMemberInit.ensureLinking();
   }
 
   unsigned int OcTreeStamped::getLastUpdateTime() {
-    // this value is updated whenever inner nodes are 
-    // updated using updateOccupancyChildren()
-    return root->getTimestamp();
+    // this value is updated whenever a node is updated
+    // using updateNodeLogOdds()
+    return last_update_time;
+  }
+
+  void OcTreeStamped::clear() {
+    OccupancyOcTreeBase<OcTreeNodeStamped>::clear();
+    last_update_time = 0;
+  }
+
+  std::istream& OcTreeStamped::readData(std::istream &s) {
+    OccupancyOcTreeBase<OcTreeNodeStamped>::readData(s);
+    // inner nodes hold the oldest timestamp below them, the last
+    // update is the newest timestamp of all leafs
+    last_update_time = 0;
+    for (leaf_iterator it = begin_leafs(), end = end_leafs(); it != end; ++it)
+      last_update_time = std::max(last_update_time, it->getTimestamp());
+    return s;
+  }
+
+  void OcTreeStamped::setCurrentTime(unsigned int time) {
+    current_time = time;
+    use_current_time = true;
+  }
+
+  unsigned int OcTreeStamped::getCurrentTime() const {
+    if (use_current_time)
+      return current_time;
+    else
+      return (unsigned int) time(NULL);
   }
 
   void OcTreeStamped::degradeOutdatedNodes(unsigned int time_thres) {
-    unsigned int query_time = (unsigned int) time(NULL); 
+    degradeOutdatedNodes(time_thres, getCurrentTime());
+  }
 
-    for(leaf_iterator it = this->begin_leafs(), end=this->end_leafs(); 
-        it!= end; ++it) {
-      if ( this->isNodeOccupied(*it) 
-           && ((query_time - it->getTimestamp()) > time_thres) ) {
-        integrateMissNoTime(&*it);
-      }
+  void OcTreeStamped::degradeOutdatedNodes(unsigned int time_thres, unsigned int query_time) {
+    if (root == NULL)
+      return;
+
+    degradeOutdatedNodesRecurs(root, time_thres, query_time);
+  }
+
+  void OcTreeStamped::degradeOutdatedNodesRecurs(OcTreeNodeStamped* node, unsigned int time_thres, unsigned int query_time) {
+    // inner nodes hold the maximum occupancy and the oldest timestamp of their
+    // children: skip subtrees without occupied nodes or without outdated nodes
+    if (!this->isNodeOccupied(node) || (query_time - node->getTimestamp()) <= time_thres)
+      return;
+
+    if (!this->nodeHasChildren(node)) {
+      integrateMissNoTime(node);
+      return;
     }
-  }  
+
+    for (unsigned int i=0; i<8; i++) {
+      if (this->nodeChildExists(node, i))
+        degradeOutdatedNodesRecurs(this->getNodeChild(node, i), time_thres, query_time);
+    }
+    node->updateOccupancyChildren();
+  }
 
   void OcTreeStamped::updateNodeLogOdds(OcTreeNodeStamped* node, const float& update) const {
     OccupancyOcTreeBase<OcTreeNodeStamped>::updateNodeLogOdds(node, update);
-    node->updateTimestamp();
+    node->setTimestamp(getCurrentTime());
+    last_update_time = node->getTimestamp();
   }
 
   void OcTreeStamped::integrateMissNoTime(OcTreeNodeStamped* node) const{
@@ -45,11 +45,61 @@
 #include <math.h>
 #include <assert.h>
 #include <limits>
+#include <algorithm>
+#include <stdint.h>
 
 #include <octomap/Pointcloud.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace octomap {
 
+  /// minimum number of points to process in parallel
+  static const int PARALLEL_MIN_POINTS = 50000;
+
+  /**
+   * Rotation matrix (row-major) of transform, equivalent to pose6d::transform() for
+   * each point (also for non-normalized rotations).
+   */
+  static void rotationMatrix(const pose6d& transform, float m[9]) {
+    const octomath::Quaternion& q = transform.rot();
+    const double u = q.u(), x = q.x(), y = q.y(), z = q.z();
+    m[0] = (float) (u*u + x*x - y*y - z*z);
+    m[1] = (float) (2.0 * (x*y - u*z));
+    m[2] = (float) (2.0 * (x*z + u*y));
+    m[3] = (float) (2.0 * (x*y + u*z));
+    m[4] = (float) (u*u - x*x + y*y - z*z);
+    m[5] = (float) (2.0 * (y*z - u*x));
+    m[6] = (float) (2.0 * (x*z - u*y));
+    m[7] = (float) (2.0 * (y*z + u*x));
+    m[8] = (float) (u*u - x*x - y*y + z*z);
+  }
+
+  /**
+   * Applies transform to n points from in to out (which may be the same), the
+   * quaternion is converted to a rotation matrix only once.
+   */
+  static void transformPoints(const pose6d& transform, const point3d* in, point3d* out, size_t n) {
+    float m[9];
+    rotationMatrix(transform, m);
+    const float m00 = m[0], m01 = m[1], m02 = m[2];
+    const float m10 = m[3], m11 = m[4], m12 = m[5];
+    const float m20 = m[6], m21 = m[7], m22 = m[8];
+    const float tx = transform.x(), ty = transform.y(), tz = transform.z();
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (n >= PARALLEL_MIN_POINTS)
+#endif
+    for (size_t i = 0; i < n; ++i) {
+      const float px = in[i](0), py = in[i](1), pz = in[i](2);
+      out[i](0) = m00*px + m01*py + m02*pz + tx;
+      out[i](1) = m10*px + m11*py + m12*pz + ty;
+      out[i](2) = m20*px + m21*py + m22*pz + tz;
+    }
+  }
+
 
   Pointcloud::Pointcloud() {
 
@@ -68,10 +118,8 @@ namespace octomap {
   }
 
 
-  Pointcloud::Pointcloud(const Pointcloud& other) {
-    for (Pointcloud::const_iterator it = other.begin(); it != other.end(); it++) {
-      points.push_back(point3d(*it));
-    }
+  Pointcloud::Pointcloud(const Pointcloud& other)
+    : points(other.points) {
   }
 
   Pointcloud::Pointcloud(Pointcloud* other) {
@@ -98,23 +146,30 @@ namespace octomap {
 
   void Pointcloud::transform(octomath::Pose6D transform) {
 
-    for (unsigned int i=0; i<points.size(); i++) {
-      points[i] = transform.transform(points[i]);
-    }
+    if (!points.empty())
+      transformPoints(transform, &points[0], &points[0], points.size());
 
    // FIXME: not correct for multiple transforms
     current_inv_transform = transform.inv();
   }
 
+  void Pointcloud::setTransformed(const Pointcloud& other, octomath::Pose6D transform) {
+
+    points.resize(other.size());
+    if (!points.empty())
+      transformPoints(transform, &other.points[0], &points[0], points.size());
+
+    current_inv_transform = transform.inv();
+  }
+
 
   void Pointcloud::transformAbsolute(pose6d transform) {
 
     // undo previous transform, then apply current transform
     pose6d transf = current_inv_transform * transform;
 
-    for (unsigned int i=0; i<points.size(); i++) {
-      points[i] = transf.transform(points[i]);
-    }
+    if (!points.empty())
+      transformPoints(transf, &points[0], &points[0], points.size());
 
     current_inv_transform = transform.inv();
   }
@@ -158,8 +213,6 @@ namespace octomap {
 
   void Pointcloud::crop(point3d lowerBound, point3d upperBound) {
 
-    Pointcloud result;
-
     float min_x, min_y, min_z;
     float max_x, max_y, max_z;
     float x,y,z;
@@ -167,10 +220,12 @@ namespace octomap {
     min_x = lowerBound(0); min_y = lowerBound(1); min_z = lowerBound(2);
     max_x = upperBound(0); max_y = upperBound(1); max_z = upperBound(2);
 
-    for (Pointcloud::const_iterator it=begin(); it!=end(); it++) {
-      x = (*it)(0);
-      y = (*it)(1);
-      z = (*it)(2);
+    // keep points in place
+    size_t num_kept = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+      x = points[i](0);
+      y = points[i](1);
+      z = points[i](2);
 
       if ( (x >= min_x) &&
 	   (y >= min_y) &&
@@ -178,29 +233,133 @@ namespace octomap {
 	   (x <= max_x) &&
 	   (y <= max_y) &&
 	   (z <= max_z) ) {
-	result.push_back (x,y,z);
+	points[num_kept++] = points[i];
       }
     } // end for points
 
-    this->clear();
-    this->push_back(result);
-
+    points.resize(num_kept);
   }
 
 
   void Pointcloud::minDist(double thres) {
-    Pointcloud result;
-
+    // keep points in place
+    size_t num_kept = 0;
     float x,y,z;
-    for (Pointcloud::const_iterator it=begin(); it!=end(); it++) {
-      x = (*it)(0);
-      y = (*it)(1);
-      z = (*it)(2);
+    for (size_t i = 0; i < points.size(); ++i) {
+      x = points[i](0);
+      y = points[i](1);
+      z = points[i](2);
       double dist = sqrt(x*x+y*y+z*z);
-      if ( dist > thres ) result.push_back (x,y,z);
+      if ( dist > thres ) points[num_kept++] = points[i];
     } // end for points
-    this->clear();
-    this->push_back(result);
+    points.resize(num_kept);
+  }
+
+
+  /// spreads the lowest 21 bits of v to every third bit of the result
+  static inline uint64_t spreadBits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x1f00000000ffffULL;
+    v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+    v = (v | (v << 8))  & 0x100f00f00f00f00fULL;
+    v = (v | (v << 4))  & 0x10c30c30c30c30c3ULL;
+    v = (v | (v << 2))  & 0x1249249249249249ULL;
+    return v;
+  }
+
+  /// voxel indices of a point, compared lexicographically
+  struct VoxelIndex {
+    double index[3];
+    bool operator< (const VoxelIndex& other) const {
+      for (unsigned int j = 0; j < 3; ++j) {
+        if (index[j] != other.index[j])
+          return index[j] < other.index[j];
+      }
+      return false;
+    }
+    bool operator== (const VoxelIndex& other) const {
+      return index[0] == other.index[0] && index[1] == other.index[1] && index[2] == other.index[2];
+    }
+  };
+
+  /**
+   * Sorts the voxel keys of all points and replaces the points of each voxel
+   * by its center or centroid, see Pointcloud::voxelFilter()
+   */
+  template <class KEY>
+  static void mergeVoxels(std::vector<std::pair<KEY, size_t> >& keys, double voxel_size, bool centroids,
+                          point3d_collection& points) {
+    std::sort(keys.begin(), keys.end());
+
+    const double factor = 1.0 / voxel_size;
+    const size_t n = keys.size();
+    point3d_collection result;
+    for (size_t begin = 0, end = 0; begin < n; begin = end) {
+      const point3d& first = points[keys[begin].second];
+      double sum[3] = {0.0, 0.0, 0.0};
+      for (end = begin; end < n && keys[end].first == keys[begin].first; ++end) {
+        if (centroids) {
+          const point3d& p = points[keys[end].second];
+          for (unsigned int j = 0; j < 3; ++j)
+            sum[j] += p(j);
+        }
+      }
+
+      point3d p;
+      for (unsigned int j = 0; j < 3; ++j) {
+        if (centroids)
+          p(j) = (float) (sum[j] / (end - begin));
+        else
+          p(j) = (float) ((floor(factor * first(j)) + 0.5) * voxel_size);
+      }
+      result.push_back(p);
+    }
+    points.swap(result);
+  }
+
+  void Pointcloud::voxelFilter(double voxel_size, bool centroids) {
+    if (points.empty())
+      return;
+
+    // voxel index of a point (as OcTreeKey): floor(coord / voxel_size)
+    const double factor = 1.0 / voxel_size;
+    const size_t n = points.size();
+    double min_index[3], max_index[3];
+    for (unsigned int j = 0; j < 3; ++j)
+      min_index[j] = max_index[j] = floor(factor * points[0](j));
+    for (size_t i = 1; i < n; ++i) {
+      for (unsigned int j = 0; j < 3; ++j) {
+        double index = floor(factor * points[i](j));
+        min_index[j] = std::min(min_index[j], index);
+        max_index[j] = std::max(max_index[j], index);
+      }
+    }
+
+    // Morton codes hold 21 bits of the index (relative to the minimum) per axis
+    const double max_range = double((1 << 21) - 1);
+    if (max_index[0] - min_index[0] > max_range || max_index[1] - min_index[1] > max_range
+        || max_index[2] - min_index[2] > max_range) {
+      std::vector<std::pair<VoxelIndex, size_t> > indices(n);
+      for (size_t i = 0; i < n; ++i) {
+        for (unsigned int j = 0; j < 3; ++j)
+          indices[i].first.index[j] = floor(factor * points[i](j));
+        indices[i].second = i;
+      }
+      mergeVoxels(indices, voxel_size, centroids, points);
+      return;
+    }
+
+    std::vector<std::pair<uint64_t, size_t> > codes(n);
+#ifdef _OPENMP
+    #pragma omp parallel for if (n >= PARALLEL_MIN_POINTS)
+#endif
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t code = 0;
+      for (unsigned int j = 0; j < 3; ++j)
+        code |= spreadBits((uint64_t) (floor(factor * points[i](j)) - min_index[j])) << j;
+      codes[i] = std::make_pair(code, i);
+    }
+    mergeVoxels(codes, voxel_size, centroids, points);
   }
 
 
@@ -333,4 +492,115 @@ namespace octomap {
     return s;
   }
 
+  // ============================================================
+  // =  PointcloudSoA  ==========================================
+  // ============================================================
+
+  PointcloudSoA::PointcloudSoA(const Pointcloud& other) {
+    setFromPointcloud(other);
+  }
+
+  void PointcloudSoA::clear() {
+    xs.clear();
+    ys.clear();
+    zs.clear();
+  }
+
+  void PointcloudSoA::reserve(size_t size) {
+    xs.reserve(size);
+    ys.reserve(size);
+    zs.reserve(size);
+  }
+
+  void PointcloudSoA::setFromPointcloud(const Pointcloud& other) {
+    xs.resize(other.size());
+    ys.resize(other.size());
+    zs.resize(other.size());
+    for (size_t i = 0; i < other.size(); ++i) {
+      xs[i] = other[i](0);
+      ys[i] = other[i](1);
+      zs[i] = other[i](2);
+    }
+  }
+
+  void PointcloudSoA::toPointcloud(Pointcloud& cloud) const {
+    cloud.clear();
+    cloud.reserve(size());
+    for (size_t i = 0; i < size(); ++i)
+      cloud.push_back(xs[i], ys[i], zs[i]);
+  }
+
+  void PointcloudSoA::transform(pose6d transform) {
+    float m[9];
+    rotationMatrix(transform, m);
+    const float tx = transform.x(), ty = transform.y(), tz = transform.z();
+    float* px = xs.empty() ? NULL : &xs[0];
+    float* py = ys.empty() ? NULL : &ys[0];
+    float* pz = zs.empty() ? NULL : &zs[0];
+    const int n = (int) size();
+
+#ifdef _OPENMP
+    #pragma omp parallel for if (n >= PARALLEL_MIN_POINTS)
+#endif
+    for (int i = 0; i < n; ++i) {
+      const float x = px[i], y = py[i], z = pz[i];
+      px[i] = m[0]*x + m[1]*y + m[2]*z + tx;
+      py[i] = m[3]*x + m[4]*y + m[5]*z + ty;
+      pz[i] = m[6]*x + m[7]*y + m[8]*z + tz;
+    }
+  }
+
+  void PointcloudSoA::calcBBX(point3d& lowerBound, point3d& upperBound) const {
+    float min_x, min_y, min_z;
+    float max_x, max_y, max_z;
+    min_x = min_y = min_z = 1e6;
+    max_x = max_y = max_z = -1e6;
+
+    for (size_t i = 0; i < size(); ++i) {
+      min_x = std::min(min_x, xs[i]);
+      min_y = std::min(min_y, ys[i]);
+      min_z = std::min(min_z, zs[i]);
+      max_x = std::max(max_x, xs[i]);
+      max_y = std::max(max_y, ys[i]);
+      max_z = std::max(max_z, zs[i]);
+    }
+
+    lowerBound(0) = min_x; lowerBound(1) = min_y; lowerBound(2) = min_z;
+    upperBound(0) = max_x; upperBound(1) = max_y; upperBound(2) = max_z;
+  }
+
+  void PointcloudSoA::crop(point3d lowerBound, point3d upperBound) {
+    const float min_x = lowerBound(0), min_y = lowerBound(1), min_z = lowerBound(2);
+    const float max_x = upperBound(0), max_y = upperBound(1), max_z = upperBound(2);
+
+    // branchless: every point is copied, but only kept ones advance the output
+    size_t num_kept = 0;
+    for (size_t i = 0; i < size(); ++i) {
+      const float x = xs[i], y = ys[i], z = zs[i];
+      xs[num_kept] = x;
+      ys[num_kept] = y;
+      zs[num_kept] = z;
+      num_kept += (x >= min_x) & (y >= min_y) & (z >= min_z) & (x <= max_x) & (y <= max_y) & (z <= max_z);
+    }
+    resize(num_kept);
+  }
+
+  void PointcloudSoA::minDist(double thres) {
+    size_t num_kept = 0;
+    for (size_t i = 0; i < size(); ++i) {
+      const float x = xs[i], y = ys[i], z = zs[i];
+      xs[num_kept] = x;
+      ys[num_kept] = y;
+      zs[num_kept] = z;
+      num_kept += (sqrt(x*x + y*y + z*z) > thres);
+    }
+    resize(num_kept);
+  }
+
+  void PointcloudSoA::resize(size_t size) {
+    xs.resize(size);
+    ys.resize(size);
+    zs.resize(size);
+  }
+
 } // end namespace
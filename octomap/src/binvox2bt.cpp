@@ -56,7 +56,6 @@
 using namespace std;
 using namespace octomap;
 
-typedef unsigned char byte;
 
 int main(int argc, char **argv)
 {
@@ -227,8 +226,8 @@ int main(int argc, char **argv)
         cout.flush();
             
         // read voxel data
-        byte value;
-        byte count;
+        unsigned char value;
+        unsigned char count;
         int index = 0;
         int end_index = 0;
         unsigned nr_voxels = 0;
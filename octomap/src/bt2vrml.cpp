@@ -42,11 +42,14 @@ using namespace std;
 using namespace octomap;
 
 void printUsage(char* self){
-  std::cerr << "\nUSAGE: " << self << " input.bt\n\n";
+  std::cerr << "\nUSAGE: " << self << " [-mesh] input.bt\n\n";
 
   std::cerr << "This tool will convert the occupied voxels of a binary OctoMap \n"
       "file input.bt to a VRML2.0 file input.bt.wrl.\n\n";
 
+  std::cerr << "With -mesh, the surface of the occupied space is written as a single\n"
+      "triangle mesh (marching cubes, unknown space is treated as free).\n\n";
+
   std::cerr << "WARNING: The output files will be quite large!\n\n";
 
   exit(0);
@@ -57,11 +60,15 @@ int main(int argc, char** argv) {
   string vrmlFilename = "";
   string btFilename = "";
 
-  if (argc != 2 || (argc > 1 && strcmp(argv[1], "-h") == 0)){
+  bool mesh = false;
+
+  if (argc == 3 && strcmp(argv[1], "-mesh") == 0)
+    mesh = true;
+  else if (argc != 2 || (argc > 1 && strcmp(argv[1], "-h") == 0)){
     printUsage(argv[0]);
   }
 
-  btFilename = std::string(argv[1]);
+  btFilename = std::string(argv[argc-1]);
   vrmlFilename = btFilename + ".wrl";
 
 
@@ -70,13 +77,36 @@ int main(int argc, char** argv) {
   OcTree* tree = new OcTree(btFilename);
 
 
-  cout << "\nWriting occupied volumes to VRML\n===========================\n";
-
   std::ofstream outfile (vrmlFilename.c_str());
 
   outfile << "#VRML V2.0 utf8\n#\n";
   outfile << "# created from OctoMap file "<<btFilename<< " with bt2vrml\n";
 
+  if (mesh){
+    cout << "\nWriting surface mesh to VRML\n===========================\n";
+
+    std::vector<point3d> vertices;
+    std::vector<unsigned int> triangles;
+    tree->getMesh(vertices, triangles, false, false);
+    delete tree;
+
+    outfile << "Shape { geometry IndexedFaceSet {\n"
+        << "  coord Coordinate { point [\n";
+    for (size_t i = 0; i < vertices.size(); ++i)
+      outfile << "    " << vertices[i].x() << " " << vertices[i].y() << " " << vertices[i].z() << ",\n";
+    outfile << "  ] }\n  coordIndex [\n";
+    for (size_t i = 0; i < triangles.size(); i += 3)
+      outfile << "    " << triangles[i] << " " << triangles[i+1] << " " << triangles[i+2] << " -1,\n";
+    outfile << "  ]\n} }\n";
+
+    outfile.close();
+
+    std::cout << "Finished writing "<< triangles.size()/3 << " triangles to " << vrmlFilename << std::endl;
+    return 0;
+  }
+
+  cout << "\nWriting occupied volumes to VRML\n===========================\n";
+
 
   size_t count(0);
   for(OcTree::leaf_iterator it = tree->begin(), end=tree->end(); it!= end; ++it) {
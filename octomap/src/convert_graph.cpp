@@ -0,0 +1,96 @@
+/*
+ * OctoMap - An Efficient Probabilistic 3D Mapping Framework Based on Octrees
+ * http://octomap.github.com/
+ *
+ * Copyright (c) 2009-2013, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved.
+ * License: New BSD
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Freiburg nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <octomap/octomap.h>
+#include <octomap/IndexedScanGraph.h>
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " input.(graph|igraph) [output.(igraph|graph)]\n\n";
+
+  std::cerr << "This tool converts between scan graph file formats. Large .graph files\n"
+      "can be converted to the indexed format (default output, .igraph), whose\n"
+      "scans are read on demand (see IndexedScanGraph). Converting to .graph\n"
+      "loads the complete graph into memory.\n\n";
+
+  exit(0);
+}
+
+int main(int argc, char** argv) {
+  string inputFilename = "";
+  string outputFilename = "";
+
+  if (argc < 2 || argc > 3 || (argc > 1 && strcmp(argv[1], "-h") == 0)){
+    printUsage(argv[0]);
+  }
+
+  inputFilename = std::string(argv[1]);
+  if (argc == 3)
+    outputFilename = std::string(argv[2]);
+  else{
+    outputFilename = inputFilename + ".igraph";
+  }
+
+
+  cout << "\nReading graph index\n===========================\n";
+  IndexedScanGraph graph;
+  if (!graph.open(inputFilename))
+    exit(-1);
+  std::cout << graph.size() << " nodes, " << graph.numEdges() << " edges, "
+            << graph.getNumPoints() << " points" << std::endl;
+
+  if (outputFilename.length() > 6 && (outputFilename.compare(outputFilename.length()-6, 6, ".graph") == 0)){
+    std::cerr << "Writing binary ScanGraph file" << std::endl;
+    ScanGraph fullGraph;
+    if (!graph.readScanGraph(fullGraph) || !fullGraph.writeBinary(outputFilename)){
+      std::cerr << "Error writing to " << outputFilename << std::endl;
+      exit(-2);
+    }
+  } else{
+    std::cerr << "Writing indexed scan graph file" << std::endl;
+    if (!graph.write(outputFilename)){
+      std::cerr << "Error writing to " << outputFilename << std::endl;
+      exit(-2);
+    }
+  }
+
+  std::cout << "Finished writing to " << outputFilename << std::endl;
+
+  return 0;
+}
@@ -35,10 +35,21 @@
 #include <stdlib.h>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#ifdef _WIN32
+  #include <Windows.h>  // to define Sleep()
+#else
+  #include <unistd.h>   // POSIX usleep()
+#endif
 
 #include <octomap/octomap.h>
+#include <octomap/IndexedScanGraph.h>
 #include <octomap/octomap_timing.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 using namespace octomap;
 
@@ -51,7 +62,7 @@ void printUsage(char* self){
                "information.\n\n";
 
 
-  std::cerr << "OPTIONS:\n  -i <InputFile.graph> (required)\n"
+  std::cerr << "OPTIONS:\n  -i <InputFile.graph> (required, .graph or indexed graph file)\n"
             "  -o <OutputFile.bt> (required) \n"
             "  -res <resolution> (optional, default: 0.1 m)\n"
             "  -m <maxrange> (optional) \n"
@@ -61,6 +72,8 @@ void printUsage(char* self){
             "  -compressML (enable maximum-likelihood compression (lossy) after every scan)\n"
             "  -simple (simple scan insertion ray by ray instead of optimized) \n"
             "  -discretize (approximate raycasting on discretized coordinates, speeds up insertion) \n"
+            "  -raycache <n> (cache up to n ray keys for consecutive scans from nearby origins, approximates raycasting like -discretize) \n"
+            "  -pipeline <n> (read and raycast up to n scans ahead in parallel while updating the tree with the previous ones, requires OpenMP) \n"
             "  -clamping <p_min> <p_max> (override default sensor model clamping probabilities between 0..1)\n"
             "  -sensor <p_miss> <p_hit> (override default sensor model hit and miss probabilities between 0..1)"
   "\n";
@@ -86,6 +99,228 @@ void calcThresholdedNodes(const OcTree* tree,
   }
 }
 
+double getTime(){
+  timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + 1.0e-6 * t.tv_usec;
+}
+
+void outputRayCacheStatistics(size_t hits, size_t misses, std::ofstream& logfile){
+  double hitRate = (hits + misses > 0) ? (double) hits / (double) (hits + misses) : 0.0;
+  cout << "\nRay cache: " << hits << " hits, " << misses << " misses (hit rate " << hitRate << ")\n";
+  if (logfile.is_open())
+    logfile << "# Ray cache: [hits] [misses] [hit rate]\n# " << hits << " " << misses << " " << hitRate << "\n";
+}
+
+/// Gives up the processor while a pipeline stage waits for another one, instead of spinning on the lock
+void waitForPipeline(){
+#ifdef _WIN32
+  Sleep(1);
+#else
+  usleep(100);
+#endif
+}
+
+/// A scan in the insertion pipeline, read and raycast before its update is integrated into the tree
+struct PipelineScan {
+  Pointcloud scan;
+  point3d sensor_origin;
+  KeySet free_cells;
+  KeySet occupied_cells;
+};
+
+/**
+ * Inserts the first numScans scans of graph into tree in three overlapping stages:
+ * one thread integrates the updates of the scans into the tree in order, while
+ * the other threads read the following scans (one at a time) and transform and
+ * raycast them. Scans are passed on in a ring buffer of bufferSize slots, so a
+ * reader waits when it is bufferSize scans ahead of the tree update, which bounds
+ * the memory. The updates are integrated in the same order as by insertPointCloud(),
+ * so the resulting tree is the same. With simpleUpdate, only reading and transforming
+ * overlap with the ray by ray insertion. A single thread runs the stages in turns.
+ * Threads that have to wait for another stage sleep briefly before checking again.
+ */
+void insertScansPipelined(const IndexedScanGraph& graph, OcTree* tree, size_t numScans, size_t bufferSize,
+                          double maxrange, bool transformNodes, bool simpleUpdate, bool discretize,
+                          unsigned char compression, std::ofstream& logfile)
+{
+  // the tree's raycasting is not reentrant, each thread casts rays with its own (empty) tree
+  int numThreads = 1;
+#ifdef _OPENMP
+  numThreads = omp_get_max_threads();
+#endif
+  if (numThreads < 2)
+    OCTOMAP_WARNING("Pipelined insertion needs OpenMP (OCTOMAP_OMP) and at least two threads, the stages run in turns.\n");
+  std::vector<OcTree*> raycasters(numThreads);
+  // (with separate ray caches)
+  for (int t = 0; t < numThreads; t++){
+    raycasters[t] = new OcTree(tree->getResolution());
+    raycasters[t]->setRayCacheSize(tree->getRayCacheSize());
+  }
+
+  // slot i % bufferSize holds scan i, ready for the update when slotReady is set.
+  // The state below is only accessed in the critical section "pipeline".
+  std::vector<PipelineScan> slots(bufferSize);
+  std::vector<char> slotReady(bufferSize, 0);
+  size_t nextRead = 0;   // next scan to read
+  size_t numUpdated = 0; // scans integrated into the tree
+  bool readError = false;
+
+  double readTime = 0.0, raycastTime = 0.0, updateTime = 0.0;
+  size_t numPoints = 0;
+  double startTime = getTime();
+
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(numThreads)
+#endif
+  {
+    int threadIdx = 0;
+#ifdef _OPENMP
+    threadIdx = omp_get_thread_num();
+#endif
+    // thread 0 updates the tree, the others read and raycast (all stages if it is alone)
+    const bool updater = (threadIdx == 0);
+    const bool reader = (threadIdx != 0 || numThreads == 1);
+
+    enum { WAIT, UPDATE, READ, DONE } action = WAIT;
+    while (action != DONE) {
+      size_t i = 0;
+#ifdef _OPENMP
+      #pragma omp critical (pipeline)
+#endif
+      {
+        if (readError || numUpdated == numScans || (!updater && nextRead == numScans))
+          action = DONE;
+        else if (updater && slotReady[numUpdated % bufferSize]) {
+          action = UPDATE;
+          i = numUpdated;
+        }
+        else if (reader && nextRead < numScans && nextRead < numUpdated + bufferSize) {
+          action = READ;
+          i = nextRead++;
+        }
+        else
+          action = WAIT;
+      }
+
+      PipelineScan& s = slots[i % bufferSize];
+      if (action == WAIT)
+        waitForPipeline();
+      else if (action == UPDATE) {
+        double t = getTime();
+        cout << "(" << i+1 << "/" << numScans << ") " << flush;
+
+        if (simpleUpdate)
+          tree->insertPointCloudRays(s.scan, s.sensor_origin, maxrange);
+        else {
+          for (KeySet::iterator it = s.free_cells.begin(); it != s.free_cells.end(); ++it)
+            tree->updateNode(*it, false);
+          for (KeySet::iterator it = s.occupied_cells.begin(); it != s.occupied_cells.end(); ++it)
+            tree->updateNode(*it, true);
+        }
+
+        if (compression == 2){
+          tree->toMaxLikelihood();
+          tree->prune();
+        }
+
+        if (logfile.is_open())
+          logfile << i+1 << " " << tree->memoryUsage() << " " << tree->memoryFullGrid() << "\n";
+
+        s.scan.clear();
+        s.free_cells.clear();
+        s.occupied_cells.clear();
+        updateTime += getTime() - t;
+
+        // frees the slot for the reader of scan i + bufferSize
+#ifdef _OPENMP
+        #pragma omp critical (pipeline)
+#endif
+        {
+          slotReady[i % bufferSize] = 0;
+          numUpdated++;
+        }
+      }
+      else if (action == READ) {
+        double t = getTime();
+        bool ok;
+        // only reading from the file stream (without memory mapping) needs to be serialized
+        if (graph.isMapped())
+          ok = graph.readScan(i, s.scan);
+        else {
+#ifdef _OPENMP
+          #pragma omp critical (graph_read)
+#endif
+          ok = graph.readScan(i, s.scan);
+        }
+        double t2 = getTime();
+
+        if (ok) {
+          s.sensor_origin = graph.getNode(i).pose.trans();
+          if (transformNodes) {
+            pose6d frame_origin = graph.getNode(i).pose;
+            s.scan.transform(frame_origin);
+            s.sensor_origin = frame_origin.transform(frame_origin.inv().transform(s.sensor_origin));
+          }
+          if (!simpleUpdate) {
+            if (discretize)
+              raycasters[threadIdx]->computeDiscreteUpdate(s.scan, s.sensor_origin, s.free_cells, s.occupied_cells, maxrange);
+            else
+              raycasters[threadIdx]->computeUpdate(s.scan, s.sensor_origin, s.free_cells, s.occupied_cells, maxrange);
+          }
+        }
+        double t3 = getTime();
+
+        // hands the scan over to the updater (the critical section flushes the slot)
+#ifdef _OPENMP
+        #pragma omp critical (pipeline)
+#endif
+        {
+          if (ok) {
+            slotReady[i % bufferSize] = 1;
+            numPoints += s.scan.size();
+          }
+          else
+            readError = true;
+          readTime += t2 - t;
+          raycastTime += t3 - t2;
+        }
+      }
+    }
+  } // end of parallel region
+
+  double totalTime = getTime() - startTime;
+
+  size_t rayCacheHits = 0, rayCacheMisses = 0;
+  for (int t = 0; t < numThreads; t++){
+    rayCacheHits += raycasters[t]->getRayCacheHits();
+    rayCacheMisses += raycasters[t]->getRayCacheMisses();
+    delete raycasters[t];
+  }
+
+  if (readError){
+    OCTOMAP_ERROR("Could not read all scans from graph file\n");
+    exit(2);
+  }
+
+  // read and raycast times are summed over all threads
+  cout << "\nPipeline with " << numThreads << " threads, buffer of " << bufferSize << " scans:\n";
+  cout << "  read:    " << readTime << " sec, " << numPoints / readTime << " points/sec\n";
+  cout << "  raycast: " << raycastTime << " sec, " << numPoints / raycastTime << " points/sec (per thread)\n";
+  cout << "  update:  " << updateTime << " sec, " << numPoints / updateTime << " points/sec\n";
+  cout << "  total:   " << totalTime << " sec, " << numPoints / totalTime << " points/sec\n";
+  if (logfile.is_open()){
+    logfile << "# Pipeline: " << numThreads << " threads, buffer of " << bufferSize << " scans, " << numPoints << " points\n";
+    logfile << "# [stage] [thread seconds] [points/sec]\n";
+    logfile << "# read " << readTime << " " << numPoints / readTime << "\n";
+    logfile << "# raycast " << raycastTime << " " << numPoints / raycastTime << "\n";
+    logfile << "# update " << updateTime << " " << numPoints / updateTime << "\n";
+    logfile << "# total " << totalTime << " " << numPoints / totalTime << "\n";
+  }
+  if (tree->getRayCacheSize() > 0)
+    outputRayCacheStatistics(rayCacheHits, rayCacheMisses, logfile);
+}
+
 void outputStatistics(const OcTree* tree){
   unsigned int numThresholded, numOther;
   calcThresholdedNodes(tree, numThresholded, numOther);
@@ -114,6 +349,8 @@ int main(int argc, char** argv) {
   bool simpleUpdate = false;
   bool discretize = false;
   bool dontTransformNodes = false;
+  int pipelineSize = 0;
+  int rayCacheSize = 0;
   unsigned char compression = 1;
 
   // get default sensor model values:
@@ -153,6 +390,14 @@ int main(int argc, char** argv) {
       maxrange = atof(argv[++arg]);
     else if (! strcmp(argv[arg], "-n"))
       max_scan_no = atoi(argv[++arg]);
+    else if (! strcmp(argv[arg], "-raycache") && argc-arg < 2)
+      printUsage(argv[0]);
+    else if (! strcmp(argv[arg], "-raycache"))
+      rayCacheSize = atoi(argv[++arg]);
+    else if (! strcmp(argv[arg], "-pipeline") && argc-arg < 2)
+      printUsage(argv[0]);
+    else if (! strcmp(argv[arg], "-pipeline"))
+      pipelineSize = atoi(argv[++arg]);
     else if (! strcmp(argv[arg], "-clamping") && (argc-arg < 3))
       printUsage(argv[0]);
     else if (! strcmp(argv[arg], "-clamping")){
@@ -194,34 +439,21 @@ int main(int argc, char** argv) {
   std::string treeFilenameMLOT = treeFilename + "_ml.ot";
 
   cout << "\nReading Graph file\n===========================\n";
-  ScanGraph* graph = new ScanGraph();
-  if (!graph->readBinary(graphFilename))
+  // only the index is read here, the scans are streamed from the file during insertion
+  IndexedScanGraph graph;
+  if (!graph.open(graphFilename))
     exit(2);
 
   size_t num_points_in_graph = 0;
   if (max_scan_no > 0) {
-    num_points_in_graph = graph->getNumPoints(max_scan_no-1);
+    num_points_in_graph = graph.getNumPoints(max_scan_no-1);
     cout << "\n Data points in graph up to scan " << max_scan_no << ": " << num_points_in_graph << endl;
   }
   else {
-    num_points_in_graph = graph->getNumPoints();
+    num_points_in_graph = graph.getNumPoints();
     cout << "\n Data points in graph: " << num_points_in_graph << endl;
   }
 
-  // transform pointclouds first, so we can directly operate on them later
-  if (!dontTransformNodes) {
-    for (ScanGraph::iterator scan_it = graph->begin(); scan_it != graph->end(); scan_it++) {
-
-      pose6d frame_origin = (*scan_it)->pose;
-      point3d sensor_origin = frame_origin.inv().transform((*scan_it)->pose.trans());
-
-      (*scan_it)->scan->transform(frame_origin);
-      point3d transformed_sensor_origin = frame_origin.transform(sensor_origin);
-      (*scan_it)->pose = pose6d(transformed_sensor_origin, octomath::Quaternion());
-
-    }
-  }
-
 
   std::ofstream logfile;
   if (detailedLog){
@@ -240,39 +472,64 @@ int main(int argc, char** argv) {
   tree->setClampingThresMax(clampingMax);
   tree->setProbHit(probHit);
   tree->setProbMiss(probMiss);
+  if (rayCacheSize > 0)
+    tree->setRayCacheSize(rayCacheSize);
 
 
   gettimeofday(&start, NULL);  // start timer
-  size_t numScans = graph->size();
-  size_t currentScan = 1;
-  for (ScanGraph::iterator scan_it = graph->begin(); scan_it != graph->end(); scan_it++) {
-    if (max_scan_no > 0) cout << "("<<currentScan << "/" << max_scan_no << ") " << flush;
-    else cout << "("<<currentScan << "/" << numScans << ") " << flush;
-
-    if (simpleUpdate)
-      tree->insertPointCloudRays((*scan_it)->scan, (*scan_it)->pose.trans(), maxrange);
-    else
-      tree->insertPointCloud((*scan_it)->scan, (*scan_it)->pose.trans(), maxrange, false, discretize);
-
-    if (compression == 2){
-      tree->toMaxLikelihood();
-      tree->prune();
+  size_t numScans = graph.size();
+  if (pipelineSize > 0) {
+    size_t numInserted = numScans;
+    if (max_scan_no > 0 && (size_t) max_scan_no < numScans)
+      numInserted = max_scan_no;
+    insertScansPipelined(graph, tree, numInserted, pipelineSize, maxrange, !dontTransformNodes,
+                         simpleUpdate, discretize, compression, logfile);
+  }
+  else {
+    size_t currentScan = 1;
+    Pointcloud scan;
+    for (size_t i = 0; i < numScans; i++) {
+      if (max_scan_no > 0) cout << "("<<currentScan << "/" << max_scan_no << ") " << flush;
+      else cout << "("<<currentScan << "/" << numScans << ") " << flush;
+
+      if (!graph.readScan(i, scan))
+        exit(2);
+
+      point3d sensor_origin = graph.getNode(i).pose.trans();
+      // transform pointcloud into global coordinates
+      if (!dontTransformNodes) {
+        pose6d frame_origin = graph.getNode(i).pose;
+        scan.transform(frame_origin);
+        sensor_origin = frame_origin.transform(frame_origin.inv().transform(sensor_origin));
+      }
+
+      if (simpleUpdate)
+        tree->insertPointCloudRays(scan, sensor_origin, maxrange);
+      else
+        tree->insertPointCloud(scan, sensor_origin, maxrange, false, discretize);
+
+      if (compression == 2){
+        tree->toMaxLikelihood();
+        tree->prune();
+      }
+
+      if (detailedLog)
+        logfile << currentScan << " " << tree->memoryUsage() << " " << tree->memoryFullGrid() << "\n";
+
+      if ((max_scan_no > 0) && (currentScan == (unsigned int) max_scan_no))
+        break;
+
+      currentScan++;
     }
-
-    if (detailedLog)
-      logfile << currentScan << " " << tree->memoryUsage() << " " << tree->memoryFullGrid() << "\n";
-
-    if ((max_scan_no > 0) && (currentScan == (unsigned int) max_scan_no))
-      break;
-
-    currentScan++;
+    if (rayCacheSize > 0)
+      outputRayCacheStatistics(tree->getRayCacheHits(), tree->getRayCacheMisses(), logfile);
   }
   gettimeofday(&stop, NULL);  // stop timer
   
   double time_to_insert = (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
 
-  // get rid of graph in mem before doing anything fancy with tree (=> memory)
-  delete graph;
+  // get rid of graph index before doing anything fancy with tree (=> memory)
+  graph.close();
   if (logfile.is_open())
     logfile.close();
 
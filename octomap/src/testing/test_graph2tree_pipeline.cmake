@@ -0,0 +1,54 @@
+# Checks that graph2tree builds the same tree with pipelined scan insertion
+# (-pipeline) as with serial insertion.
+#
+# cmake -DLOG2GRAPH=<log2graph> -DGRAPH2TREE=<graph2tree> -DWORK_DIR=<dir> -P test_graph2tree_pipeline.cmake
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(LOG_FILE ${WORK_DIR}/pipeline_scans.log)
+set(GRAPH_FILE ${WORK_DIR}/pipeline_scans.graph)
+
+# scans of a wall in front of a moving sensor, overlapping the previous ones
+file(WRITE ${LOG_FILE} "# generated by test_graph2tree_pipeline.cmake\n")
+foreach(node RANGE 0 9)
+  math(EXPR yaw "${node} * 5 - 20")
+  file(APPEND ${LOG_FILE} "NODE ${node}e-1 ${node}e-2 0 0 0 ${yaw}e-2\n")
+  foreach(y RANGE -30 30)
+    set(points "")
+    foreach(z RANGE -10 20)
+      math(EXPR x "400 + (${y} * ${z} + ${node} * 7) % 13")
+      set(points "${points}${x}e-2 ${y}e-1 ${z}e-1\n")
+    endforeach()
+    file(APPEND ${LOG_FILE} "${points}")
+  endforeach()
+endforeach()
+
+macro(run_command)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE result OUTPUT_QUIET)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Command failed (${result}): ${ARGN}")
+  endif()
+endmacro()
+
+run_command(${LOG2GRAPH} ${LOG_FILE} ${GRAPH_FILE})
+
+# serial insertion as reference, then pipelines with buffers shorter and longer than the graph.
+# The reference runs on one thread: insertPointCloudRays() (-simple) integrates the rays
+# in the order of the OpenMP threads otherwise, while the pipeline integrates them in order.
+set(omp_num_threads "$ENV{OMP_NUM_THREADS}")
+foreach(options "" "-simple" "-discretize")
+  set(ENV{OMP_NUM_THREADS} 1)
+  run_command(${GRAPH2TREE} -i ${GRAPH_FILE} -o ${WORK_DIR}/serial.bt -m 5 ${options})
+  if(omp_num_threads)
+    set(ENV{OMP_NUM_THREADS} "${omp_num_threads}")
+  else()
+    unset(ENV{OMP_NUM_THREADS})
+  endif()
+  foreach(buffer 1 3 20)
+    run_command(${GRAPH2TREE} -i ${GRAPH_FILE} -o ${WORK_DIR}/pipeline.bt -m 5 -pipeline ${buffer} ${options})
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/serial.bt.ot ${WORK_DIR}/pipeline.bt.ot
+                    RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+      message(FATAL_ERROR "Pipelined insertion (-pipeline ${buffer} ${options}) differs from serial insertion")
+    endif()
+  endforeach()
+endforeach()
@@ -119,6 +119,24 @@ bool OcTreeVolumeSortPredicate(const OcTreeVolume& lhs, const OcTreeVolume& rhs)
 }
 
 
+/// counts the leafs in parallel_for_each_leaf(), each thread with its own counter
+struct LeafCounter {
+  LeafCounter() : count(0), volume(0.0) {}
+
+  void operator()(const OcTree::iterator_base& it){
+    count++;
+    volume += pow(it.getSize(), 3);
+  }
+
+  static void combine(LeafCounter& result, const LeafCounter& counter){
+    result.count += counter.count;
+    result.volume += counter.volume;
+  }
+
+  size_t count;
+  double volume;
+};
+
 double timediff(const timeval& start, const timeval& stop){
   return (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
 }
@@ -410,6 +428,155 @@ int main(int argc, char** argv) {
 
 
 
+  /**
+   * iterator throughput: full traversals, iterator copies (postfix increment)
+   * and many short bounding box traversals
+   */
+  const int num_runs = 10;
+  size_t num_iterated;
+  gettimeofday(&start, NULL);  // start timer
+  num_iterated = 0;
+  for (int run = 0; run < num_runs; ++run){
+    for(OcTree::leaf_iterator it = tree->begin_leafs(maxDepth), end=tree->end_leafs(); it!= end; ++it)
+      num_iterated++;
+  }
+  gettimeofday(&stop, NULL);  // stop timer
+  std::cout << "Leaf iteration: " << num_iterated / timediff(start, stop) * 1e-6 << " M leafs/s\n";
+
+  gettimeofday(&start, NULL);  // start timer
+  num_iterated = 0;
+  for (int run = 0; run < num_runs; ++run){
+    for(OcTree::leaf_iterator it = tree->begin_leafs(maxDepth), end=tree->end_leafs(); it!= end; it++)
+      num_iterated++;
+  }
+  gettimeofday(&stop, NULL);  // stop timer
+  std::cout << "Leaf iteration (postfix increment): " << num_iterated / timediff(start, stop) * 1e-6 << " M leafs/s\n";
+
+  const int num_queries = 100000;
+  size_t num_query_leafs = 0;
+  gettimeofday(&start, NULL);  // start timer
+  for (int i = 0; i < num_queries; ++i){
+    point3d query_min(-5.f + 0.0001f*i, -5.f + 0.0001f*i, 0.f);
+    point3d query_max = query_min + point3d(0.2f, 0.2f, 0.2f);
+    for(OcTree::leaf_bbx_iterator it = tree->begin_leafs_bbx(query_min, query_max, maxDepth), end=tree->end_leafs_bbx(); it!= end; ++it)
+      num_query_leafs++;
+  }
+  gettimeofday(&stop, NULL);  // stop timer
+  std::cout << "Bounding box queries: " << num_queries / timediff(start, stop) * 1e-6 << " M queries/s ("
+      << num_query_leafs << " leafs)\n========================\n\n";
+
+
+  /**
+   * traversal split into subtrees
+   */
+  std::vector<OcTree::Subtree> subtrees;
+  tree->getSubtrees(subtrees, 100, maxDepth);
+  EXPECT_TRUE(subtrees.size() >= 100);
+  OcTree::leaf_iterator leaf_it = tree->begin_leafs(maxDepth);
+  OcTree::leaf_iterator leaf_end = tree->end_leafs();
+  for (size_t i = 0; i < subtrees.size(); ++i){
+    for (OcTree::leaf_iterator it(tree, subtrees[i], maxDepth); it != leaf_end; ++it, ++leaf_it){
+      EXPECT_TRUE(leaf_it != leaf_end);
+      EXPECT_TRUE(&(*it) == &(*leaf_it));
+      EXPECT_TRUE(it.getKey() == leaf_it.getKey());
+      EXPECT_EQ(it.getDepth(), leaf_it.getDepth());
+    }
+  }
+  EXPECT_TRUE(leaf_it == leaf_end);
+
+  gettimeofday(&start, NULL);  // start timer
+  LeafCounter counter = tree->parallel_for_each_leaf(LeafCounter(), LeafCounter::combine, maxDepth);
+  gettimeofday(&stop, NULL);  // stop timer
+  EXPECT_EQ(counter.count, count);
+  std::cout << "Time to traverse all leafs in parallel at max depth " <<(unsigned int)maxDepth <<" ("<<counter.count<<" nodes): "
+      << timediff(start, stop) << " s\n\n";
+
+  point3d bbx_min(-1, -1, -1);
+  point3d bbx_max(3, 2, 1);
+  LeafCounter bbx_counter = tree->parallel_for_each_leaf(bbx_min, bbx_max, LeafCounter(), LeafCounter::combine, maxDepth);
+  size_t bbx_count = 0;
+  double bbx_volume = 0.0;
+  for(OcTree::leaf_bbx_iterator it = tree->begin_leafs_bbx(bbx_min, bbx_max, maxDepth), end=tree->end_leafs_bbx(); it!= end; ++it){
+    bbx_count++;
+    bbx_volume += pow(it.getSize(), 3);
+  }
+  EXPECT_TRUE(bbx_count > 0);
+  EXPECT_EQ(bbx_counter.count, bbx_count);
+  EXPECT_NEAR(bbx_counter.volume, bbx_volume, 1e-6 * bbx_volume);
+
+
+  /**
+   * bounding box on the pruned tree: all leafs overlapping with the bbx, occupied leafs only
+   */
+  OcTreeKey bbx_min_key, bbx_max_key;
+  EXPECT_TRUE(tree->coordToKeyChecked(bbx_min, bbx_min_key));
+  EXPECT_TRUE(tree->coordToKeyChecked(bbx_max, bbx_max_key));
+  std::vector<OcTreeNode*> bbx_leafs, bbx_occupied_leafs;
+  for(OcTree::leaf_iterator it = tree->begin_leafs(maxDepth), end=tree->end_leafs(); it!= end; ++it){
+    OcTreeKey min_key = it.getIndexKey();
+    int size = 1 << (tree_depth - it.getDepth());
+    bool overlap = true;
+    for (unsigned i = 0; i < 3; ++i){
+      if (min_key[i] > bbx_max_key[i] || min_key[i] + size - 1 < bbx_min_key[i])
+        overlap = false;
+    }
+    if (overlap){
+      bbx_leafs.push_back(&(*it));
+      if (tree->isNodeOccupied(*it))
+        bbx_occupied_leafs.push_back(&(*it));
+    }
+  }
+  EXPECT_TRUE(bbx_occupied_leafs.size() > 0);
+  EXPECT_TRUE(bbx_occupied_leafs.size() < bbx_leafs.size());
+
+  bbx_count = 0;
+  for(OcTree::leaf_bbx_iterator it = tree->begin_leafs_bbx(bbx_min_key, bbx_max_key, maxDepth), end=tree->end_leafs_bbx(); it!= end; ++it){
+    EXPECT_TRUE(bbx_count < bbx_leafs.size());
+    EXPECT_TRUE(&(*it) == bbx_leafs[bbx_count]);
+    bbx_count++;
+  }
+  EXPECT_EQ(bbx_count, bbx_leafs.size());
+
+  bbx_count = 0;
+  for(OcTree::leaf_bbx_occupied_iterator it = tree->begin_leafs_bbx_occupied(bbx_min_key, bbx_max_key, maxDepth),
+      end=tree->end_leafs_bbx_occupied(); it!= end; ++it){
+    EXPECT_TRUE(bbx_count < bbx_occupied_leafs.size());
+    EXPECT_TRUE(&(*it) == bbx_occupied_leafs[bbx_count]);
+    bbx_count++;
+  }
+  EXPECT_EQ(bbx_count, bbx_occupied_leafs.size());
+
+  // timing of occupied leafs in the complete tree: checking each leaf / occupied iterator
+  double metric_x, metric_y, metric_z;
+  tree->getMetricMin(metric_x, metric_y, metric_z);
+  bbx_min = point3d((float) metric_x, (float) metric_y, (float) metric_z);
+  tree->getMetricMax(metric_x, metric_y, metric_z);
+  bbx_max = point3d((float) metric_x, (float) metric_y, (float) metric_z);
+  gettimeofday(&start, NULL);  // start timer
+  num_iterated = 0;
+  for (int run = 0; run < num_runs; ++run){
+    for(OcTree::leaf_bbx_iterator it = tree->begin_leafs_bbx(bbx_min, bbx_max, maxDepth), end=tree->end_leafs_bbx(); it!= end; ++it){
+      if (tree->isNodeOccupied(*it))
+        num_iterated++;
+    }
+  }
+  gettimeofday(&stop, NULL);  // stop timer
+  time_depr = timediff(start, stop);
+
+  gettimeofday(&start, NULL);  // start timer
+  bbx_count = 0;
+  for (int run = 0; run < num_runs; ++run){
+    for(OcTree::leaf_bbx_occupied_iterator it = tree->begin_leafs_bbx_occupied(bbx_min, bbx_max, maxDepth),
+        end=tree->end_leafs_bbx_occupied(); it!= end; ++it)
+      bbx_count++;
+  }
+  gettimeofday(&stop, NULL);  // stop timer
+  time_it = timediff(start, stop);
+  EXPECT_EQ(bbx_count, num_iterated);
+  std::cout << "Occupied leafs in bbx (" << bbx_count / num_runs << " nodes), times: "
+      << time_it << " / " << time_depr << "\n========================\n\n";
+
+
   /**
    * bounding box tests
    */
@@ -1,5 +1,11 @@
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <map>
+#include <set>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
 #ifdef _WIN32
   #include <Windows.h>  // to define Sleep()
 #else
@@ -9,6 +15,7 @@
 
 #include <octomap/octomap.h>
 #include <octomap/OcTreeStamped.h>
+#include <octomap/IndexedScanGraph.h>
 #include <octomap/math/Utils.h>
 #include "testing.h"
  
@@ -16,6 +23,19 @@ using namespace std;
 using namespace octomap;
 using namespace octomath;
 
+// adds a scan of num_steps x num_steps points on a sphere of the given radius,
+// rotated in steps of step_deg degrees about the z and y axis
+static void addSphereScan(Pointcloud& scan, float radius, int num_steps, double step_deg) {
+  point3d point_on_surface (radius, 0.01f, 0.01f);
+  for (int i=0; i<num_steps; i++) {
+    for (int j=0; j<num_steps; j++) {
+      scan.push_back(point_on_surface);
+      point_on_surface.rotate_IP (0,0,DEG2RAD(step_deg));
+    }
+    point_on_surface.rotate_IP (0,DEG2RAD(step_deg),0);
+  }
+}
+
 int main(int argc, char** argv) {
 
   if (argc != 2){
@@ -153,6 +173,88 @@ int main(int argc, char** argv) {
     ScanGraph graph;
     EXPECT_TRUE (graph.readBinary("test.graph"));
   // ------------------------------------------------------------
+  // indexed graph with lazily read scans
+  } else if (test_name == "IndexedGraph") {
+    ScanGraph graph;
+    for (unsigned int n=0; n<5; n++) {
+      Pointcloud* scan = new Pointcloud();
+      for (unsigned int i=0; i<100*n; i++)
+        scan->push_back(0.1f*i, 0.5f*n, -0.25f*i);
+      graph.addNode(scan, Pose6D(1.0f*n, 2.0f, 0.5f, 0.0f, 0.1f*n, 0.2f));
+      graph.connectPrevious();
+    }
+    graph.addEdge(0, 4);
+    EXPECT_TRUE (graph.writeBinary("test_indexed.graph"));
+    EXPECT_TRUE (IndexedScanGraph::write(graph, "test_indexed.igraph"));
+
+    // both formats are read lazily and give the same graph
+    const char* files[] = {"test_indexed.graph", "test_indexed.igraph"};
+    for (unsigned int f=0; f<2; f++) {
+      IndexedScanGraph indexed (files[f]);
+      EXPECT_TRUE (indexed.isOpen());
+      EXPECT_EQ (indexed.isIndexedFormat(), (f == 1));
+      EXPECT_EQ (indexed.size(), graph.size());
+      EXPECT_EQ (indexed.getNumPoints(), graph.getNumPoints());
+      EXPECT_EQ (indexed.getNumPoints(2), graph.getNumPoints(2));
+
+      // random access by id
+      for (unsigned int id=5; id>0; id--) {
+        ScanNode* node = indexed.readNodeByID(id-1);
+        ScanNode* orig = graph.getNodeByID(id-1);
+        EXPECT_TRUE (node);
+        EXPECT_EQ (node->id, orig->id);
+        EXPECT_TRUE (node->pose == orig->pose);
+        EXPECT_EQ (node->scan->size(), orig->scan->size());
+        for (size_t i=0; i<orig->scan->size(); i++)
+          EXPECT_TRUE ((*node->scan)[i] == (*orig->scan)[i]);
+        delete node;
+      }
+      EXPECT_EQ (indexed.findNode(17), indexed.size());
+      EXPECT_FALSE (indexed.readNodeByID(17));
+
+      EXPECT_EQ (indexed.numEdges(), (size_t) 5);
+      EXPECT_EQ (indexed.getEdge(4).first_id, 0u);
+      EXPECT_EQ (indexed.getEdge(4).second_id, 4u);
+
+      ScanGraph full;
+      EXPECT_TRUE (indexed.readScanGraph(full));
+      EXPECT_EQ (full.size(), graph.size());
+      EXPECT_TRUE (full.edgeExists(0, 4));
+      EXPECT_TRUE (full.edgeExists(2, 3));
+    }
+
+    // conversion of the regular file
+    IndexedScanGraph converted ("test_indexed.graph");
+    EXPECT_TRUE (converted.write("test_converted.igraph"));
+    EXPECT_TRUE (converted.open("test_converted.igraph"));
+    EXPECT_TRUE (converted.isIndexedFormat());
+    Pointcloud scan;
+    EXPECT_TRUE (converted.readScan(3, scan));
+    EXPECT_EQ (scan.size(), graph.getNodeByID(3)->scan->size());
+    EXPECT_FALSE (converted.readScan(5, scan));
+
+    // scans outside of a corrupt or truncated file are rejected when opening it
+    std::ifstream igraph_file ("test_indexed.igraph", std::ios_base::in | std::ios_base::binary);
+    std::stringstream igraph_stream;
+    igraph_stream << igraph_file.rdbuf();
+    std::string igraph = igraph_stream.str();
+    uint64_t index_offset = 0;
+    memcpy(&index_offset, &igraph[igraph.size() - sizeof(index_offset)], sizeof(index_offset));
+    std::stringstream pose_stream;
+    Pose6D().writeBinary(pose_stream);
+    std::string corrupt = igraph;
+    uint64_t num_points = (uint64_t) 1 << 40;
+    memcpy(&corrupt[(size_t) index_offset + 2*sizeof(uint32_t) + pose_stream.str().size()], &num_points, sizeof(num_points));
+    std::ofstream corrupt_file ("test_corrupt.igraph", std::ios_base::out | std::ios_base::binary);
+    corrupt_file << corrupt;
+    corrupt_file.close();
+    std::ofstream truncated_file ("test_truncated.igraph", std::ios_base::out | std::ios_base::binary);
+    truncated_file << igraph.substr(0, igraph.size() / 2);
+    truncated_file.close();
+    IndexedScanGraph corrupt_graph;
+    EXPECT_FALSE (corrupt_graph.open("test_corrupt.igraph"));
+    EXPECT_FALSE (corrupt_graph.open("test_truncated.igraph"));
+  // ------------------------------------------------------------
 
   } else if (test_name == "StampedTree") {
     OcTreeStamped stamped_tree (0.05);
@@ -190,6 +292,555 @@ int main(int argc, char** argv) {
     EXPECT_TRUE (result->getTimestamp() < result2->getTimestamp()); // result2 has been updated
     EXPECT_EQ(result2->getTimestamp(), stamped_tree.getLastUpdateTime());
   // ------------------------------------------------------------
+  } else if (test_name == "StampedTreeDecay") {
+    OcTreeStamped stamped_tree (0.05);
+    // two occupied blocks with user-supplied timestamps in milliseconds
+    stamped_tree.setCurrentTime(1000);
+    for (int x=-10; x<0; x++)
+      for (int y=-10; y<10; y++)
+        for (int z=-10; z<10; z++)
+          stamped_tree.updateNode(point3d(x*0.05f+0.01f, y*0.05f+0.01f, z*0.05f+0.01f), true);
+    stamped_tree.setCurrentTime(1500);
+    for (int x=0; x<10; x++)
+      for (int y=-10; y<10; y++)
+        for (int z=-10; z<10; z++)
+          stamped_tree.updateNode(point3d(x*0.05f+0.01f, y*0.05f+0.01f, z*0.05f+0.01f), true);
+    EXPECT_EQ(1500u, stamped_tree.getLastUpdateTime());
+    // inner nodes hold the oldest timestamp below them
+    EXPECT_EQ(1000u, stamped_tree.getRoot()->getTimestamp());
+
+    point3d old_point(-0.24f, 0.01f, 0.01f);
+    point3d recent_point(0.26f, 0.01f, 0.01f);
+    float old_logodds = stamped_tree.search(old_point)->getLogOdds();
+    float recent_logodds = stamped_tree.search(recent_point)->getLogOdds();
+
+    // nothing outdated yet
+    stamped_tree.degradeOutdatedNodes(700, 1600);
+    EXPECT_FLOAT_EQ(old_logodds, stamped_tree.search(old_point)->getLogOdds());
+    EXPECT_FLOAT_EQ(recent_logodds, stamped_tree.search(recent_point)->getLogOdds());
+
+    // only the first block is outdated (sub-second threshold)
+    stamped_tree.setCurrentTime(1600);
+    stamped_tree.degradeOutdatedNodes(400);
+    for (OcTreeStamped::leaf_iterator it = stamped_tree.begin_leafs(), end = stamped_tree.end_leafs(); it != end; ++it) {
+      if (it->getTimestamp() == 1000) {
+        EXPECT_FLOAT_EQ(old_logodds + stamped_tree.getProbMissLog(), it->getLogOdds());
+      } else {
+        EXPECT_FLOAT_EQ(recent_logodds, it->getLogOdds());
+      }
+      EXPECT_TRUE(it->getTimestamp() == 1000 || it->getTimestamp() == 1500);
+    }
+    // inner occupancy reflects the degraded leaves
+    EXPECT_FLOAT_EQ(recent_logodds, stamped_tree.getRoot()->getLogOdds());
+
+    // the last update time is restored after reading and reset by clear()
+    std::stringstream stamped_stream;
+    EXPECT_TRUE (stamped_tree.write(stamped_stream));
+    AbstractOcTree* read_tree = AbstractOcTree::read(stamped_stream);
+    EXPECT_TRUE (read_tree);
+    OcTreeStamped* read_stamped_tree = dynamic_cast<OcTreeStamped*>(read_tree);
+    EXPECT_TRUE (read_stamped_tree);
+    EXPECT_EQ(1500u, read_stamped_tree->getLastUpdateTime());
+    EXPECT_EQ(1000u, read_stamped_tree->getRoot()->getTimestamp());
+    EXPECT_EQ(stamped_tree.search(old_point)->getTimestamp(), read_stamped_tree->search(old_point)->getTimestamp());
+    EXPECT_EQ(stamped_tree.search(recent_point)->getTimestamp(), read_stamped_tree->search(recent_point)->getTimestamp());
+    delete read_tree;
+    stamped_tree.clear();
+    EXPECT_EQ(0u, stamped_tree.getLastUpdateTime());
+  // ------------------------------------------------------------
+  } else if (test_name == "RayCache") {
+    Pointcloud scan;
+    addSphereScan(scan, 2.01f, 90, 4.);
+
+    // consecutive scans from nearby origins
+    OcTree cached_tree (0.05);
+    cached_tree.setRayCacheSize(1000000);
+    OcTree reference_tree (0.05);
+    size_t first_misses = 0;
+    for (int n=0; n<3; n++) {
+      point3d origin (0.01f*n, 0.005f, 0.02f);
+      cached_tree.insertPointCloud(scan, origin);
+      // cached rays are cast between voxel centers
+      OcTreeKey key;
+      Pointcloud centers;
+      for (size_t i=0; i<scan.size(); i++) {
+        EXPECT_TRUE (reference_tree.coordToKeyChecked(scan[i], key));
+        centers.push_back(reference_tree.keyToCoord(key));
+      }
+      EXPECT_TRUE (reference_tree.coordToKeyChecked(origin, key));
+      reference_tree.insertPointCloud(centers, reference_tree.keyToCoord(key));
+
+      // the origin key does not change, all rays of later scans are cached
+      EXPECT_EQ (cached_tree.getRayCacheHits() + cached_tree.getRayCacheMisses(), (n+1)*scan.size());
+      if (n == 0)
+        first_misses = cached_tree.getRayCacheMisses();
+      EXPECT_EQ (cached_tree.getRayCacheMisses(), first_misses);
+    }
+    EXPECT_TRUE (cached_tree.getRayCacheHitRate() > 2./3.);
+    EXPECT_TRUE (cached_tree == reference_tree);
+
+    // bounded size, dropping the least recently used rays
+    cached_tree.resetRayCacheStatistics();
+    cached_tree.setRayCacheSize(5000);
+    cached_tree.insertPointCloud(scan, point3d(0.06f, 0.005f, 0.02f));
+    cached_tree.insertPointCloud(scan, point3d(0.0f, 0.005f, 0.02f));
+    EXPECT_TRUE (cached_tree.getRayCacheHits() < scan.size() / 2);
+    cached_tree.resetRayCacheStatistics();
+    EXPECT_EQ (cached_tree.getRayCacheHits(), (size_t) 0);
+    EXPECT_FLOAT_EQ (cached_tree.getRayCacheHitRate(), 0.0);
+
+    // caching disabled
+    cached_tree.setRayCacheSize(0);
+    cached_tree.insertPointCloud(scan, point3d(0.0f, 0.005f, 0.02f));
+    EXPECT_EQ (cached_tree.getRayCacheHits() + cached_tree.getRayCacheMisses(), (size_t) 0);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "UnknownSpace") {
+    OcTree tree (0.1);
+    EXPECT_TRUE (tree.insertRay(point3d(0.01f, 0.01f, 0.01f), point3d(1.51f, 0.51f, 0.21f)));
+    EXPECT_TRUE (tree.insertRay(point3d(0.01f, 0.01f, 0.01f), point3d(-0.81f, 1.21f, -0.41f)));
+    tree.updateNode(point3d(-1.05f, -1.05f, -1.05f), true);
+
+    // brute force reference
+    OcTreeKey bbx_min, bbx_max;
+    EXPECT_TRUE (tree.coordToKeyChecked(point3d(-1.0f, -1.0f, -1.0f), bbx_min));
+    EXPECT_TRUE (tree.coordToKeyChecked(point3d(1.0f, 1.0f, 1.0f), bbx_max));
+    size_t num_unknown = 0;
+    OcTreeKey key;
+    for (key[0] = bbx_min[0]; key[0] <= bbx_max[0]; ++key[0])
+      for (key[1] = bbx_min[1]; key[1] <= bbx_max[1]; ++key[1])
+        for (key[2] = bbx_min[2]; key[2] <= bbx_max[2]; ++key[2])
+          if (!tree.search(key))
+            num_unknown++;
+
+    // maximal cubes cover exactly the unknown leafs in the bbx
+    std::vector<UnknownCube> cubes;
+    tree.getUnknownCubes(cubes, bbx_min, bbx_max);
+    size_t covered = 0;
+    for (size_t i = 0; i < cubes.size(); ++i) {
+      EXPECT_FALSE (tree.search(cubes[i].key, cubes[i].depth));
+      unsigned int size = 1 << (tree.getTreeDepth() - cubes[i].depth);
+      size_t volume = 1;
+      for (unsigned int j = 0; j < 3; ++j) {
+        int min = (size == 1) ? cubes[i].key[j] : cubes[i].key[j] - size/2;
+        volume *= std::min(min + (int) size - 1, (int) bbx_max[j]) - std::max(min, (int) bbx_min[j]) + 1;
+      }
+      covered += volume;
+    }
+    EXPECT_TRUE (cubes.size() < num_unknown / 10);
+    EXPECT_EQ (covered, num_unknown);
+
+    point3d_list centers;
+    tree.getUnknownLeafCenters(centers, point3d(-1.0f, -1.0f, -1.0f), point3d(1.0f, 1.0f, 1.0f));
+    EXPECT_EQ (centers.size(), num_unknown);
+    for (point3d_list::iterator it = centers.begin(); it != centers.end(); ++it)
+      EXPECT_FALSE (tree.search(*it));
+
+    // minimum cube size
+    std::vector<UnknownCube> large_cubes;
+    tree.getUnknownCubes(large_cubes, point3d(-1.0f, -1.0f, -1.0f), point3d(1.0f, 1.0f, 1.0f), 14);
+    EXPECT_TRUE (large_cubes.size() > 0);
+    EXPECT_TRUE (large_cubes.size() < cubes.size());
+    for (size_t i = 0; i < large_cubes.size(); ++i)
+      EXPECT_TRUE (large_cubes[i].depth <= 14);
+
+    centers.clear();
+    tree.getUnknownLeafCenters(centers, point3d(-1.0f, -1.0f, -1.0f), point3d(1.0f, 1.0f, 1.0f), 14);
+    for (point3d_list::iterator it = centers.begin(); it != centers.end(); ++it)
+      EXPECT_FALSE (tree.search(*it, 14));
+
+    // everything is unknown in an empty tree
+    OcTree empty_tree (0.1);
+    cubes.clear();
+    empty_tree.getUnknownCubes(cubes, bbx_min, bbx_max);
+    EXPECT_EQ (cubes.size(), (size_t) 1);
+    EXPECT_EQ (cubes[0].depth, 0u);
+    centers.clear();
+    empty_tree.getUnknownLeafCenters(centers, point3d(-1.0f, -1.0f, -1.0f), point3d(1.0f, 1.0f, 1.0f));
+    EXPECT_EQ (centers.size(), (size_t) 21*21*21);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "Frontier") {
+    Pointcloud scan;
+    addSphereScan(scan, 1.01f, 30, 4.);
+    OcTree tree (0.05);
+    tree.insertPointCloud(scan, point3d(0.01f, 0.01f, 0.01f));
+
+    KeySet frontier;
+    tree.getFrontier(frontier);
+    EXPECT_TRUE (frontier.size() > 0);
+
+    // brute force reference over all voxels of all leafs
+    KeySet reference;
+    for (OcTree::leaf_iterator it = tree.begin_leafs(), end = tree.end_leafs(); it != end; ++it) {
+      unsigned int size = 1 << (tree.getTreeDepth() - it.getDepth());
+      OcTreeKey min_key = it.getIndexKey();
+      OcTreeKey key;
+      for (unsigned int x=0; x<size; x++)
+        for (unsigned int y=0; y<size; y++)
+          for (unsigned int z=0; z<size; z++) {
+            key = OcTreeKey(min_key[0]+x, min_key[1]+y, min_key[2]+z);
+            if (tree.isFrontier(key))
+              reference.insert(key);
+          }
+    }
+    EXPECT_EQ (frontier.size(), reference.size());
+    for (KeySet::iterator it = reference.begin(); it != reference.end(); ++it)
+      EXPECT_TRUE (frontier.find(*it) != frontier.end());
+
+    // incremental update from the changes of the next scan
+    tree.enableChangeDetection(true);
+    tree.insertPointCloud(scan, point3d(0.31f, 0.11f, 0.01f));
+    EXPECT_TRUE (tree.numChangesDetected() > 0);
+    tree.updateFrontier(frontier);
+    tree.resetChangeDetection();
+    KeySet recomputed;
+    tree.getFrontier(recomputed);
+    EXPECT_EQ (frontier.size(), recomputed.size());
+    for (KeySet::iterator it = recomputed.begin(); it != recomputed.end(); ++it)
+      EXPECT_TRUE (frontier.find(*it) != frontier.end());
+
+    // no frontier without unknown space next to free space
+    OcTree empty_tree (0.05);
+    recomputed.clear();
+    empty_tree.getFrontier(recomputed);
+    EXPECT_EQ (recomputed.size(), (size_t) 0);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "PointcloudTransform") {
+    Pointcloud cloud;
+    for (int i=0; i<500; i++)
+      cloud.push_back(0.1f*(i%13) - 0.6f, 0.05f*(i%29) - 0.7f, 0.02f*i - 5.0f);
+
+    // the rotation matrix is applied like Pose6D::transform
+    pose6d poses[] = {pose6d(0.0f, 0.0f, 0.0f, 0.0, 0.0, 0.0),
+                      pose6d(0.5f, -1.0f, 0.2f, 0.1, -0.4, 1.2),
+                      pose6d(-3.0f, 2.0f, 7.5f, M_PI, 0.3, -M_PI/2),
+                      pose6d(1.0f, 1.0f, 1.0f, -2.0, 1.5, 3.0)};
+    Pointcloud absolute (cloud);
+    pose6d previous_inv;
+    for (size_t k=0; k<sizeof(poses)/sizeof(poses[0]); k++) {
+      Pointcloud transformed (cloud);
+      transformed.transform(poses[k]);
+      Pointcloud set_transformed;
+      set_transformed.setTransformed(cloud, poses[k]);
+      // combined with the inverse of the previous transform
+      Pointcloud previous (absolute);
+      absolute.transformAbsolute(poses[k]);
+      pose6d combined = previous_inv * poses[k];
+      previous_inv = poses[k].inv();
+      EXPECT_EQ (transformed.size(), cloud.size());
+      EXPECT_EQ (set_transformed.size(), cloud.size());
+      for (size_t i=0; i<cloud.size(); i++) {
+        point3d expected = poses[k].transform(cloud[i]);
+        point3d expected_absolute = combined.transform(previous[i]);
+        for (unsigned int j=0; j<3; j++) {
+          EXPECT_NEAR (transformed[i](j), expected(j), 1e-4);
+          EXPECT_NEAR (set_transformed[i](j), expected(j), 1e-4);
+          EXPECT_NEAR (absolute[i](j), expected_absolute(j), 1e-4);
+        }
+      }
+    }
+
+  // ------------------------------------------------------------
+  } else if (test_name == "PointcloudSoA") {
+    Pointcloud cloud;
+    addSphereScan(cloud, 2.01f, 60, 6.);
+    // varying ranges along each ring
+    for (size_t i=0; i<cloud.size(); i++)
+      cloud[i] *= 1.0f + 0.01f*(i % 60);
+
+    // conversion
+    PointcloudSoA soa (cloud);
+    EXPECT_EQ (soa.size(), cloud.size());
+    Pointcloud converted;
+    soa.toPointcloud(converted);
+    EXPECT_EQ (converted.size(), cloud.size());
+    for (size_t i=0; i<cloud.size(); i++) {
+      EXPECT_TRUE (converted[i] == cloud[i]);
+      EXPECT_FLOAT_EQ (soa.y()[i], cloud[i].y());
+    }
+
+    // same results as Pointcloud
+    pose6d transform (0.5f, -1.0f, 0.2f, 0.1, -0.4, 1.2);
+    Pointcloud transformed (cloud);
+    transformed.transform(transform);
+    PointcloudSoA transformed_soa (cloud);
+    transformed_soa.transform(transform);
+    for (size_t i=0; i<cloud.size(); i++)
+      EXPECT_TRUE (transformed[i] == transformed_soa[i]);
+
+    point3d lower, upper, lower_soa, upper_soa;
+    transformed.calcBBX(lower, upper);
+    transformed_soa.calcBBX(lower_soa, upper_soa);
+    EXPECT_TRUE (lower == lower_soa);
+    EXPECT_TRUE (upper == upper_soa);
+
+    transformed.crop(point3d(-1.0f, -2.0f, -1.0f), point3d(2.0f, 1.0f, 1.5f));
+    transformed_soa.crop(point3d(-1.0f, -2.0f, -1.0f), point3d(2.0f, 1.0f, 1.5f));
+    EXPECT_TRUE (transformed.size() < cloud.size());
+    EXPECT_EQ (transformed.size(), transformed_soa.size());
+    transformed.minDist(1.5);
+    transformed_soa.minDist(1.5);
+    EXPECT_EQ (transformed.size(), transformed_soa.size());
+    for (size_t i=0; i<transformed.size(); i++)
+      EXPECT_TRUE (transformed[i] == transformed_soa[i]);
+
+    // insertion
+    OcTree tree (0.05);
+    tree.insertPointCloud(cloud, point3d(0.01f, 0.01f, 0.02f), 3.0);
+    OcTree soa_tree (0.05);
+    soa_tree.insertPointCloud(soa, point3d(0.01f, 0.01f, 0.02f), 3.0);
+    EXPECT_TRUE (tree == soa_tree);
+    tree.insertPointCloud(cloud, point3d(0.31f, 0.01f, 0.02f), -1.0, false, true);
+    soa_tree.insertPointCloud(soa, point3d(0.31f, 0.01f, 0.02f), -1.0, false, true);
+    EXPECT_TRUE (tree == soa_tree);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "VoxelFilter") {
+    Pointcloud cloud;
+    for (int i=0; i<20000; i++)
+      cloud.push_back((float) (i % 97) * 0.013f - 0.6f, (float) (i % 89) * 0.007f, (float) (i % 13) * -0.021f);
+
+    OcTree tree (0.05);
+    for (unsigned int depth = 16; depth >= 14; depth--) {
+      // reference: one point per octree node at depth
+      KeySet keys;
+      for (size_t i=0; i<cloud.size(); i++)
+        keys.insert(tree.coordToKey(cloud[i], depth));
+
+      Pointcloud centers (cloud);
+      centers.voxelFilter(tree.getNodeSize(depth));
+      EXPECT_EQ (centers.size(), keys.size());
+      KeySet center_keys;
+      for (size_t i=0; i<centers.size(); i++) {
+        OcTreeKey key = tree.coordToKey(centers[i], depth);
+        EXPECT_TRUE (keys.find(key) != keys.end());
+        EXPECT_TRUE (centers[i] == tree.keyToCoord(key, depth));
+        center_keys.insert(key);
+      }
+      EXPECT_EQ (center_keys.size(), keys.size());
+
+      Pointcloud centroids (cloud);
+      centroids.voxelFilter(tree.getNodeSize(depth), true);
+      EXPECT_EQ (centroids.size(), keys.size());
+      for (size_t i=0; i<centroids.size(); i++)
+        EXPECT_TRUE (keys.find(tree.coordToKey(centroids[i], depth)) != keys.end());
+    }
+
+    // centroid of a single voxel
+    Pointcloud voxel;
+    voxel.push_back(0.01f, 0.01f, 0.01f);
+    voxel.push_back(0.03f, 0.02f, 0.01f);
+    voxel.push_back(0.02f, 0.03f, 0.04f);
+    voxel.voxelFilter(0.05, true);
+    EXPECT_EQ (voxel.size(), (size_t) 1);
+    EXPECT_FLOAT_EQ (voxel[0].x(), 0.02f);
+    EXPECT_FLOAT_EQ (voxel[0].y(), 0.02f);
+    EXPECT_FLOAT_EQ (voxel[0].z(), 0.02f);
+
+    // wide extents: far from the origin, and more than 2^21 voxels (Morton code range) apart
+    float wide_x[] = {1572864.5f, 1572865.5f, 1572864.25f, -1048576.5f, 0.5f, 2097152.5f, 2097152.75f};
+    for (int wide = 0; wide < 2; wide++) {
+      Pointcloud wide_cloud;
+      for (int i = 0; i < 7; i++) {
+        if (wide == 0 && i >= 3) // only the cluster far from the origin
+          break;
+        wide_cloud.push_back(wide_x[i], 0.5f, -0.5f);
+      }
+      std::set<float> wide_centers;
+      for (size_t i=0; i<wide_cloud.size(); i++)
+        wide_centers.insert(floor(wide_cloud[i].x()) + 0.5f);
+      wide_cloud.voxelFilter(1.0);
+      EXPECT_EQ (wide_cloud.size(), wide_centers.size());
+      for (size_t i=0; i<wide_cloud.size(); i++) {
+        EXPECT_TRUE (wide_centers.count(wide_cloud[i].x()) == 1);
+        EXPECT_FLOAT_EQ (wide_cloud[i].y(), 0.5f);
+        EXPECT_FLOAT_EQ (wide_cloud[i].z(), -0.5f);
+      }
+    }
+
+  // ------------------------------------------------------------
+  } else if (test_name == "Mesh") {
+    OcTree tree (0.05);
+    std::vector<point3d> vertices;
+    std::vector<unsigned int> triangles;
+
+    // single occupied voxel in free space: octahedron around its center
+    OcTreeKey center_key = tree.coordToKey(point3d(0.01f, 0.01f, 0.01f));
+    for (int x=-1; x<=1; x++)
+      for (int y=-1; y<=1; y++)
+        for (int z=-1; z<=1; z++)
+          tree.updateNode(OcTreeKey(center_key[0]+x, center_key[1]+y, center_key[2]+z), x == 0 && y == 0 && z == 0);
+    tree.getMesh(vertices, triangles, false, false);
+    EXPECT_EQ (vertices.size(), (size_t) 6);
+    EXPECT_EQ (triangles.size(), (size_t) 24);
+    point3d center = tree.keyToCoord(center_key);
+    for (size_t i=0; i<vertices.size(); i++)
+      EXPECT_FLOAT_EQ ((vertices[i] - center).norm(), 0.025);
+    for (size_t i=0; i<triangles.size(); i+=3) {
+      point3d normal = (vertices[triangles[i+1]] - vertices[triangles[i]]).cross(vertices[triangles[i+2]] - vertices[triangles[i]]);
+      EXPECT_TRUE (normal.dot(vertices[triangles[i]] - center) > 0); // pointing to free space
+    }
+
+    // scan and a pruned occupied block
+    tree.clear();
+    Pointcloud scan;
+    addSphereScan(scan, 0.51f, 30, 4.);
+    tree.insertPointCloud(scan, point3d(0.01f, 0.01f, 0.01f));
+    OcTreeKey block_key = tree.coordToKey(point3d(0.81f, 0.01f, 0.01f));
+    for (unsigned int x=0; x<8; x++)
+      for (unsigned int y=0; y<8; y++)
+        for (unsigned int z=0; z<8; z++)
+          tree.updateNode(OcTreeKey((block_key[0] & ~7) + x, (block_key[1] & ~7) + y, (block_key[2] & ~7) + z), true);
+    EXPECT_TRUE (tree.search(block_key, tree.getTreeDepth() - 3) != NULL);
+
+    OcTreeKey known_min (tree.coordToKey(point3d(10.f, 10.f, 10.f)));
+    OcTreeKey known_max (tree.coordToKey(point3d(-10.f, -10.f, -10.f)));
+    for (OcTree::leaf_iterator it = tree.begin_leafs(), end = tree.end_leafs(); it != end; ++it) {
+      unsigned int size = 1 << (tree.getTreeDepth() - it.getDepth());
+      OcTreeKey min_key = it.getIndexKey();
+      for (unsigned int j=0; j<3; j++) {
+        known_min[j] = std::min(known_min[j], min_key[j]);
+        known_max[j] = std::max(known_max[j], (key_type) (min_key[j] + size - 1));
+      }
+    }
+
+    for (int unknown_status=0; unknown_status<2; unknown_status++) {
+      tree.getMesh(vertices, triangles, false, unknown_status == 1);
+      EXPECT_TRUE (triangles.size() > 0);
+
+      // closed surface, each edge is used once in each direction
+      std::map<std::pair<unsigned int, unsigned int>, int> edges;
+      for (size_t i=0; i<triangles.size(); i+=3)
+        for (unsigned int j=0; j<3; j++)
+          edges[std::make_pair(triangles[i+j], triangles[i+(j+1)%3])]++;
+      for (std::map<std::pair<unsigned int, unsigned int>, int>::iterator it = edges.begin(); it != edges.end(); ++it) {
+        EXPECT_EQ (it->second, 1);
+        EXPECT_TRUE (edges.find(std::make_pair(it->first.second, it->first.first)) != edges.end());
+      }
+
+      // brute force reference: number of triangles in all cubes next to known space
+      std::vector<std::pair<OcTreeKey, size_t> > cube_triangles;
+      size_t num_triangles = 0;
+      for (int x = known_min[0]-1; x <= known_max[0]; x++)
+        for (int y = known_min[1]-1; y <= known_max[1]; y++)
+          for (int z = known_min[2]-1; z <= known_max[2]; z++) {
+            static const int corners[8][3] = {{0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1}};
+            int cube_index = 0;
+            for (unsigned int i=0; i<8; i++) {
+              OcTreeNode* node = tree.search(OcTreeKey(x+corners[i][0], y+corners[i][1], z+corners[i][2]));
+              if (node ? tree.isNodeOccupied(node) : unknown_status == 1)
+                cube_index |= 1 << i;
+            }
+            size_t n = 0;
+            for (int i=0; triTable[cube_index][i] != -1; i+=3)
+              n++;
+            if (n > 0)
+              cube_triangles.push_back(std::make_pair(OcTreeKey(x, y, z), n));
+            num_triangles += n;
+          }
+      EXPECT_EQ (triangles.size(), 3*num_triangles);
+
+      // interpolated vertices on the same edges
+      std::vector<point3d> interpolated_vertices;
+      std::vector<unsigned int> interpolated_triangles;
+      tree.getMesh(interpolated_vertices, interpolated_triangles, true, unknown_status == 1);
+      EXPECT_EQ (interpolated_vertices.size(), vertices.size());
+      EXPECT_TRUE (interpolated_triangles == triangles);
+      for (size_t i=0; i<vertices.size(); i++)
+        EXPECT_TRUE ((interpolated_vertices[i] - vertices[i]).norm() <= 0.5*tree.getResolution() + 1e-5);
+
+      // bounding boxes around the block, and ending right before the first known leaves
+      // (cubes owned by the leaves behind the box)
+      std::vector<std::pair<OcTreeKey, OcTreeKey> > bbxs;
+      bbxs.push_back(std::make_pair(OcTreeKey((block_key[0] & ~7) - 3, (block_key[1] & ~7) + 2, (block_key[2] & ~7) - 3),
+                                    OcTreeKey((block_key[0] & ~7) + 10, (block_key[1] & ~7) + 12, (block_key[2] & ~7) + 5)));
+      for (unsigned int j=0; j<3; j++) {
+        OcTreeKey bbx_min (known_min[0] - 1, known_min[1] - 1, known_min[2] - 1);
+        OcTreeKey bbx_max (known_max[0] + 1, known_max[1] + 1, known_max[2] + 1);
+        bbx_max[j] = known_min[j];
+        bbxs.push_back(std::make_pair(bbx_min, bbx_max));
+        bbx_max[j] = (key_type) ((known_min[j] + known_max[j]) / 2);
+        bbxs.push_back(std::make_pair(bbx_min, bbx_max));
+      }
+      for (size_t b=0; b<bbxs.size(); b++) {
+        const OcTreeKey& bbx_min = bbxs[b].first;
+        const OcTreeKey& bbx_max = bbxs[b].second;
+        size_t num_bbx_triangles = 0;
+        for (size_t i=0; i<cube_triangles.size(); i++) {
+          const OcTreeKey& cube = cube_triangles[i].first;
+          if (cube[0] >= bbx_min[0] && cube[1] >= bbx_min[1] && cube[2] >= bbx_min[2]
+              && cube[0] < bbx_max[0] && cube[1] < bbx_max[1] && cube[2] < bbx_max[2])
+            num_bbx_triangles += cube_triangles[i].second;
+        }
+        tree.getMesh(vertices, triangles, bbx_min, bbx_max, false, unknown_status == 1);
+        if (b == 0) // no surface between the block and unknown space
+          EXPECT_TRUE (triangles.size() > 0 || unknown_status == 1);
+        EXPECT_EQ (triangles.size(), 3*num_bbx_triangles);
+      }
+    }
+
+    // no surface without occupied space
+    OcTree empty_tree (0.05);
+    empty_tree.getMesh(vertices, triangles);
+    EXPECT_EQ (vertices.size(), (size_t) 0);
+    EXPECT_EQ (triangles.size(), (size_t) 0);
+
+  // ------------------------------------------------------------
+  } else if (test_name == "SurfaceNormals") {
+    OcTree tree (0.05);
+    std::vector<OcTreeKey> keys;
+    std::vector<point3d> normals;
+
+    // single occupied voxel in free space
+    OcTreeKey center_key = tree.coordToKey(point3d(0.01f, 0.01f, 0.01f));
+    for (int x=-2; x<=2; x++)
+      for (int y=-2; y<=2; y++)
+        for (int z=-2; z<=2; z++)
+          tree.updateNode(OcTreeKey(center_key[0]+x, center_key[1]+y, center_key[2]+z), x == 0 && y == 0 && z == 0);
+    keys.push_back(OcTreeKey(center_key[0]+1, center_key[1], center_key[2]));
+    keys.push_back(OcTreeKey(center_key[0], center_key[1], center_key[2]-1));
+    keys.push_back(OcTreeKey(center_key[0]+2, center_key[1], center_key[2]));
+    tree.getSurfaceNormals(keys, normals, false);
+    EXPECT_EQ (normals.size(), keys.size());
+    EXPECT_TRUE ((normals[0] - point3d(1.f, 0.f, 0.f)).norm() < 1e-5);
+    EXPECT_TRUE ((normals[1] - point3d(0.f, 0.f, -1.f)).norm() < 1e-5);
+    EXPECT_FLOAT_EQ (normals[2].norm(), 0.0); // no surface around
+
+    // scan: batch results equal single queries, normals of the occupied
+    // voxels point towards the sensor origin
+    tree.clear();
+    Pointcloud scan;
+    addSphereScan(scan, 0.51f, 30, 4.);
+    point3d origin (0.01f, 0.01f, 0.01f);
+    tree.insertPointCloud(scan, origin);
+    keys.clear();
+    for (OcTree::leaf_iterator it = tree.begin_leafs(), end = tree.end_leafs(); it != end; ++it) {
+      if (it.getDepth() == tree.getTreeDepth())
+        keys.push_back(it.getKey());
+    }
+    keys.push_back(tree.coordToKey(point3d(5.f, 5.f, 5.f))); // unknown
+    tree.getSurfaceNormals(keys, normals);
+    EXPECT_EQ (normals.size(), keys.size());
+    size_t num_occupied = 0, num_towards_origin = 0;
+    for (size_t i=0; i<keys.size(); i++) {
+      std::vector<OcTreeKey> single_key (1, keys[i]);
+      std::vector<point3d> single_normal;
+      tree.getSurfaceNormals(single_key, single_normal);
+      EXPECT_TRUE (single_normal[0] == normals[i]);
+
+      OcTreeNode* node = tree.search(keys[i]);
+      if (node && tree.isNodeOccupied(node) && normals[i].norm() > 0) {
+        num_occupied++;
+        if (normals[i].dot(origin - tree.keyToCoord(keys[i])) > 0)
+          num_towards_origin++;
+      }
+    }
+    EXPECT_TRUE (num_occupied > 0);
+    EXPECT_TRUE (num_towards_origin > 0.9 * num_occupied);
+
+  // ------------------------------------------------------------
   } else if (test_name == "OcTreeKey") {
     OcTree tree (0.05);  
     point3d p(0.0,0.0,0.0);
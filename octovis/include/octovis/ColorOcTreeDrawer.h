@@ -35,11 +35,14 @@ namespace octomap {
     ColorOcTreeDrawer();
     virtual ~ColorOcTreeDrawer();
 
-    virtual void setOcTree(const AbstractOcTree& tree_pnt, const pose6d& origin, int map_id_);
+    virtual void prepareOcTree(const AbstractOcTree& tree_pnt, const pose6d& origin, int map_id_);
+    virtual void prepareOcTreeUpdate(const AbstractOcTree& tree_pnt);
 
   protected:
-    
-    
+    virtual unsigned int setCubeColor(const OcTreeNode& node, const octomap::OcTreeVolume& v,
+                                      const unsigned int& current_array_idx,
+                                      GLubyte** glColorArray);
+
   };
 
 
@@ -26,6 +26,11 @@
 #define OCTREEDRAWER_H_
 
 #include "SceneObject.h"
+#include <vector>
+#include <QElapsedTimer>
+#include <QMutex>
+
+class QGLBuffer;
 
 namespace octomap {
 
@@ -49,6 +54,26 @@ namespace octomap {
     /// origin specifies a global transformation that should be applied
     virtual void setOcTree(const AbstractOcTree& octree, const octomap::pose6d& origin, int map_id_);
 
+    /// updates the drawer after the OcTree passed to setOcTree() changed. Only the
+    /// subtrees containing keys reported by the tree's change detection are
+    /// regenerated (see OccupancyOcTreeBase::enableChangeDetection), everything
+    /// is regenerated if change detection is disabled. Changes the tree does not
+    /// track (e.g. node colors) need a call to setOcTree().
+    virtual void updateOcTree(const AbstractOcTree& octree);
+
+    /// like setOcTree(), but generates the cubes into a back buffer while the current
+    /// ones are still drawn, so it may run in a worker thread. The new cubes are shown
+    /// after swapBuffers(), which may be called meanwhile. The drawer must not be
+    /// modified otherwise in the meantime.
+    virtual void prepareOcTree(const AbstractOcTree& octree, const octomap::pose6d& origin, int map_id_);
+
+    /// like updateOcTree(), generating into the back buffer (see prepareOcTree())
+    virtual void prepareOcTreeUpdate(const AbstractOcTree& octree);
+
+    /// shows the cubes generated by prepareOcTree() or prepareOcTreeUpdate(),
+    /// call from the drawing thread
+    void swapBuffers();
+
     // modification of existing drawer  ------------------
 
     /// sets a new selection of the current OcTree to be drawn
@@ -71,7 +96,81 @@ namespace octomap {
     void setOrigin(octomap::pose6d t);
     void enableAxes(bool enabled = true) { m_update = true; m_displayAxes = enabled; };
 
+    /// view-dependent level of detail: subtrees far from the camera are drawn
+    /// with inner nodes (aggregated occupancy) instead of their leaves
+    void enableLevelOfDetail(bool enabled = true) { m_update = true; m_lodEnabled = enabled; };
+    /// frame time in ms the level of detail adapts to (default: 50)
+    void setFrameTimeBudget(double ms) { m_frameTimeBudget = ms; };
+    /// draw only the faces of occupied cubes next to free or unknown space, neighboring
+    /// faces of the same color are merged into larger quads. Translucent occupied volumes
+    /// then show their surface only. Applies to the next setOcTree().
+    void enableSurfaceExtraction(bool enabled = true) { m_surfaceExtraction = enabled; };
+
   protected:
+    /// number of tree cuts generated per subtree, level l is l levels above the drawn depth
+    enum { NUM_LOD_LEVELS = 4 };
+
+    /// categories of leaf cubes, drawn in different colors
+    enum CubeCategory {
+      CUBES_OCCUPIED_THRES = 0,
+      CUBES_OCCUPIED,
+      CUBES_FREE_THRES,
+      CUBES_FREE,
+      NUM_CUBE_CATEGORIES
+    };
+
+    /// cubes of one category in the quad layout of generateCube(). The arrays
+    /// are moved into a vertex buffer object on the first draw and freed afterwards.
+    /// Extracted surfaces use the same layout, but the six face arrays differ in
+    /// size (faceSize) and have their own colors, one face array after another.
+    struct CubeArray {
+      CubeArray() : quads(NULL), colors(NULL), size(0), colored(false), surface(false), buffer(NULL) {
+        for (unsigned int i = 0; i < 6; ++i)
+          faceSize[i] = 0;
+      }
+      GLfloat** quads;
+      //! RGBA per vertex, packed into bytes
+      GLubyte* colors;
+      //! floats in each face array (in all face arrays for surfaces)
+      unsigned int size;
+      unsigned int faceSize[6];
+      bool colored;
+      bool surface;
+      QGLBuffer* buffer;
+    };
+
+    /// all cubes of one subtree ("chunk") for each level of detail, regenerated
+    /// as a whole when it changes. Level l shows the leaves in sharedCubes[l..NUM_LOD_LEVELS-1]
+    /// and the cubes in levelCubes[l], so each leaf is stored only once for all levels.
+    struct CubeChunk {
+      //! leaves whose coarsest showing level is l, also shown by all finer levels
+      CubeArray sharedCubes[NUM_LOD_LEVELS][NUM_CUBE_CATEGORIES];
+      //! cubes shown by level l only: inner nodes at its tree cut and extracted surfaces
+      CubeArray levelCubes[NUM_LOD_LEVELS][NUM_CUBE_CATEGORIES];
+      point3d bbxMin;
+      point3d bbxMax;
+    };
+
+    typedef std::vector<std::pair<OcTreeVolume, const OcTreeNode*> > LeafCubeList;
+    typedef unordered_ns::unordered_map<OcTreeKey, CubeChunk, OcTreeKey::KeyHash> CubeChunkMap;
+
+    /// cubes generated by prepareOcTree() or prepareOcTreeUpdate(), not drawn yet
+    struct ChunkBuffer {
+      ChunkBuffer() : pending(false), complete(false), maxDepth(0), surfaces(false), leafSize(0.0), mapId(0) {}
+      bool pending;
+      //! replaces all chunks, otherwise only the contained and removed ones
+      bool complete;
+      CubeChunkMap chunks;
+      KeySet removedChunks;
+      CubeChunk coarseChunk;
+      std::list<octomap::OcTreeVolume> gridVoxels;
+      unsigned int maxDepth;
+      bool surfaces;
+      double leafSize;
+      octomap::pose6d origin;
+      int mapId;
+    };
+
     //void clearOcTree();
     void clearOcTreeStructure();
 
@@ -80,7 +179,20 @@ namespace octomap {
     void drawFreeVoxels() const;
     void drawSelection() const;
     void drawCubes(GLfloat** cubeArray, unsigned int cubeArraySize,
-        GLfloat* cubeColorArray = NULL) const;
+        GLubyte* cubeColorArray = NULL) const;
+    void drawCubes(CubeCategory category) const;
+    //! selects the chunks in the view frustum and their level of detail
+    void selectVisibleChunks() const;
+    //! adapts the level of detail to the time it took to draw the last frame
+    void adaptLevelOfDetail(double frameTime) const;
+    //! measures the frame time for adaptLevelOfDetail() without stalling the GPU: with a
+    //! timer query whose result is read in a later frame, or the time between frames
+    void beginFrameTiming() const;
+    void endFrameTiming(double cpuTime) const;
+    void drawCubes(const CubeArray& cubes) const;
+    //! draws the six face arrays, faceColorArrays may be NULL
+    void drawCubeFaces(const GLfloat* const* faceArrays, const unsigned int* faceArraySizes,
+        const GLubyte* const* faceColorArrays) const;
 
     void drawAxes() const;
 
@@ -90,14 +202,20 @@ namespace octomap {
     void generateCubes(const std::list<octomap::OcTreeVolume>& voxels,
                        GLfloat*** glArray, unsigned int& glArraySize, 
                        octomath::Pose6D& origin,
-                       GLfloat** glColorArray = NULL);
+                       GLubyte** glColorArray = NULL);
     
     //! clear OpenGL visualization
     void clearCubes(GLfloat*** glArray, unsigned int& glArraySize,
-                    GLfloat** glColorArray = NULL);
+                    GLubyte** glColorArray = NULL) const;
+    void clearCubes(CubeArray& cubes) const;
+    void clearChunk(CubeChunk& chunk) const;
+    void clearChunks();
+    void clearBuffer();
+    //! moves a cube array into a vertex buffer object (needs a current GL context)
+    void uploadCubes(CubeArray& cubes) const;
     //! setup OpenGL arrays
     void initGLArrays(const unsigned int& num_cubes, unsigned int& glArraySize,
-                       GLfloat*** glArray, GLfloat** glColorArray);
+                       GLfloat*** glArray, GLubyte** glColorArray);
     //! setup cube template
     void initCubeTemplate(const octomath::Pose6D& origin,
                           std::vector<octomath::Vector3>& cube_template);
@@ -108,32 +226,93 @@ namespace octomap {
                               GLfloat*** glArray);
     unsigned int setCubeColorHeightmap(const octomap::OcTreeVolume& v,
                                        const unsigned int& current_array_idx,
-                                       GLfloat** glColorArray);
+                                       GLubyte** glColorArray);
     unsigned int setCubeColorRGBA(const unsigned char& r, const unsigned char& g, 
                                   const unsigned char& b, const unsigned char& a,
                                   const unsigned int& current_array_idx,
-                                  GLfloat** glColorArray);
-      
+                                  GLubyte** glColorArray);
+    //! color of an occupied leaf cube (height map by default)
+    virtual unsigned int setCubeColor(const OcTreeNode& node, const octomap::OcTreeVolume& v,
+                                      const unsigned int& current_array_idx,
+                                      GLubyte** glColorArray);
+
+    //! (Re-)generates the cubes of all subtrees at chunk depth and of the leaves above
+    //! into the back buffer. If incremental, only subtrees containing changed keys of
+    //! the tree are regenerated.
+    template <class TREE>
+    void generateChunks(const TREE& tree, const octomap::pose6d& origin, int map_id_, bool incremental);
+    //! collects the cubes of all levels of detail in the subtree of node (see CubeChunk)
+    template <class TREE>
+    void collectChunkCubes(const TREE& tree, const typename TREE::NodeType* node,
+                           const OcTreeKey& key, unsigned int depth,
+                           unsigned int chunkDepth, unsigned int maxDepth, bool addGrid,
+                           LeafCubeList sharedLeaves[][NUM_CUBE_CATEGORIES],
+                           LeafCubeList levelLeaves[][NUM_CUBE_CATEGORIES]);
+    //! whether generated cubes need to be rotated into the frame of their origin
+    bool usesOrigin() const {
+      const octomath::Quaternion& rot = m_back.origin.rot();
+      return ( (rot.x() != 0.) && (rot.y() != 0.) && (rot.z() != 0.) && (rot.u() != 1.) );
+    }
+    //! generates the exposed faces of the occupied leaves of one chunk for all levels
+    //! of detail (see enableSurfaceExtraction())
+    template <class TREE>
+    void generateSurfaces(const TREE& tree, const OcTreeKey& chunkKey, unsigned int chunkDepth,
+                          unsigned int maxDepth, LeafCubeList sharedLeaves[][NUM_CUBE_CATEGORIES],
+                          LeafCubeList levelLeaves[][NUM_CUBE_CATEGORIES], CubeChunk& chunk);
+    //! sorts a leaf into the cube lists by category
+    void addLeafCube(const OcTreeNode* node, bool occupied, bool atThreshold,
+                     const point3d& coord, double size, LeafCubeList* leaves) const;
+    //! generates the cube arrays of one chunk from its leaves, occupied leaves
+    //! only determine the bounding box if their surface was extracted
+    void generateChunk(LeafCubeList sharedLeaves[][NUM_CUBE_CATEGORIES],
+                       LeafCubeList levelLeaves[][NUM_CUBE_CATEGORIES],
+                       const std::vector<octomath::Vector3>& cube_template, CubeChunk& chunk,
+                       bool occupiedSurfaces = false);
+    //! generates one cube array from a leaf list and extends the bounding box of the chunk
+    void generateCubeArray(LeafCubeList& leaves, bool occupied,
+                           const std::vector<octomath::Vector3>& cube_template, CubeArray& cubes,
+                           bool generate, CubeChunk& chunk, bool& empty);
+    void addGridVoxel(const point3d& coord, double size);
 
     void initOctreeGridVis();
 
-    //! OpenGL representation of Octree cells (cubes)
+    //! OpenGL representation of Octree cells (cubes), by subtree
+    mutable CubeChunkMap m_chunks;
+    //! cubes of leaves above the chunk depth
+    mutable CubeChunk m_coarseChunk;
+    //! cubes generated for the next swapBuffers()
+    ChunkBuffer m_back;
+    //! guards m_chunks (and its generation settings) against swapBuffers() while cubes
+    //! are generated in a worker thread
+    mutable QMutex m_chunksMutex;
+    //! depth limit the chunks were generated with
+    unsigned int m_chunks_max_depth;
+    //! whether the occupied cubes of the chunks are extracted surfaces
+    bool m_chunks_surfaces;
+    bool m_surfaceExtraction;
+    //! false if vertex buffer objects are not supported, cubes are drawn from client memory
+    mutable bool m_useBuffers;
+    //! chunks drawn in the current frame with their level of detail
+    mutable std::vector<std::pair<const CubeChunk*, unsigned int> > m_visibleChunks;
+
+    bool m_lodEnabled;
+    double m_frameTimeBudget;
+    //! edge length (pixels) up to which cubes are merged into their parent, adapted to the frame time
+    mutable double m_lodPixelSize;
+    //! size of the smallest drawn cubes
+    double m_lodLeafSize;
+    //! timer query measuring the GPU time of a frame, 0 if not created yet
+    mutable GLuint m_frameQuery;
+    //! whether m_frameQuery holds a result that was not read yet
+    mutable bool m_frameQueryPending;
+    //! time spent issuing the draw calls of the frame measured by m_frameQuery
+    mutable double m_frameQueryCpuTime;
+    //! time since the last frame, measured if timer queries are not supported
+    mutable QElapsedTimer m_frameInterval;
 
-    GLfloat** m_occupiedThresArray;
-    unsigned int m_occupiedThresSize;
-    GLfloat** m_freeThresArray;
-    unsigned int m_freeThresSize;
-    GLfloat** m_occupiedArray;
-    unsigned int m_occupiedSize;
-    GLfloat** m_freeArray;
-    unsigned int m_freeSize;
     GLfloat** m_selectionArray;
     unsigned int m_selectionSize;
 
-    //! Color array for occupied cells (height)
-    GLfloat* m_occupiedThresColorArray;
-    GLfloat* m_occupiedColorArray;
-
     //! OpenGL representation of Octree (grid structure)
     // TODO: put in its own drawer object!
     GLfloat* octree_grid_vertex_array;
@@ -34,6 +34,7 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QDockWidget>
+#include <QProgressBar>
 #include <string>
 #include <cmath>
 #include "TrajectoryDrawer.h"
@@ -44,6 +45,7 @@
 #include "ViewerSettings.h"
 #include "ViewerSettingsPanel.h"
 #include "ViewerSettingsPanelCamera.h"
+#include "ViewerWorker.h"
 #include "ui_ViewerGui.h"
 
 #include <octomap/AbstractOcTree.h>
@@ -112,6 +114,7 @@ namespace octomap {
     void on_actionAxes_toggled(bool checked);
     void on_actionHideBackground_toggled(bool checked);
     void on_actionAlternateRendering_toggled(bool checked);
+    void on_actionSurface_extraction_toggled(bool checked);
     void on_actionClear_triggered();
 
     void on_action_bg_black_triggered();
@@ -124,6 +127,11 @@ namespace octomap {
     // use it for testcases etc.
     void on_actionTest_triggered();
 
+    // background jobs of m_worker
+    void showJobProgress(QString message, int done, int total);
+    void jobFinished();
+    void jobFailed(QString message);
+
   signals:
     void updateStatusBar(QString message, int duration);
     void changeNumberOfScans(unsigned scans);
@@ -155,21 +163,17 @@ namespace octomap {
      */
     void loadGraph(bool completeGraph = true);
 
-    /**
-     * Adds a scan from the graph to the OcTree
-     */
-    void addNextScan();
 
     /**
      * Opens a .pc PointCloud
      */
     void openPC();
 
-    /// open "regular" file containing an octree
+    /// open "regular" or binary format file containing an octree (in the background)
     void openOcTree();
 
-    /// open binary format OcTree
-    void openTree();
+    /// shows an octree read by openOcTree()
+    void showLoadedOcTree(AbstractOcTree* tree);
 
     // EXPERIMENTAL
     // open a map collection (.hot-file)
@@ -182,7 +186,13 @@ namespace octomap {
      * (Re-)generates OcTree from the internally stored ScanGraph
      */
     void generateOctree();
-    void showOcTree();
+    /// updates the drawers in the background, only changed subtrees if incremental
+    void showOcTree(bool incremental = false);
+    /// runs the task set up in m_worker and updates all drawers in the background
+    void startJob(bool incremental);
+    /// disables user input which could change the octrees while a job is running
+    void setJobRunning(bool running);
+    void updateMapStatistics();
 
     void showInfo(QString string, bool newline=false);
 
@@ -204,6 +214,17 @@ namespace octomap {
 
     Ui::ViewerGuiClass ui;
     ViewerWidget* m_glwidget;
+    QDockWidget* m_settingsDock;
+    QDockWidget* m_settingsCameraDock;
+    ViewerWorker* m_worker;
+    QProgressBar* m_jobProgressBar;
+    /// load the complete scan graph after reading it (see openGraph())
+    bool m_loadCompleteGraph;
+    /// reset the view when the running job finished
+    bool m_resetViewAfterJob;
+    /// showOcTree() was called while a job was running
+    bool m_showOcTreePending;
+    bool m_showOcTreePendingIncremental;
     TrajectoryDrawer* m_trajectoryDrawer;
     PointcloudDrawer* m_pointcloudDrawer;
     CameraFollowMode* m_cameraFollowMode;
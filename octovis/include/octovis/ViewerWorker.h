@@ -0,0 +1,114 @@
+/*
+ * This file is part of OctoMap - An Efficient Probabilistic 3D Mapping
+ * Framework Based on Octrees
+ * http://octomap.github.io
+ *
+ * Copyright (c) 2009-2014, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved. License for the viewer octovis: GNU GPL v2
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ */
+
+#ifndef VIEWERWORKER_H_
+#define VIEWERWORKER_H_
+
+#include <QThread>
+#include <QString>
+#include <string>
+#include <vector>
+#include <octomap/octomap.h>
+#include "OcTreeDrawer.h"
+
+namespace octomap {
+
+  /**
+   * Runs the time consuming parts of the viewer in a background thread, so that
+   * the GUI stays responsive: reading files, inserting scans and generating the
+   * cubes of OcTreeDrawers. A job consists of an optional task followed by the
+   * cube generation of all added drawers into their back buffers
+   * (OcTreeDrawer::prepareOcTree()). After finished() was emitted, the GUI thread
+   * takes the results and shows the new cubes with OcTreeDrawer::swapBuffers().
+   *
+   * Trees, scan graphs and drawers passed to a job must not be changed by the
+   * GUI thread before the job is finished, the drawers may still be drawn.
+   */
+  class ViewerWorker : public QThread {
+    Q_OBJECT
+
+  public:
+    enum Task {
+      TASK_NONE,
+      TASK_READ_TREE,
+      TASK_READ_SCAN_GRAPH,
+      TASK_INSERT_SCANS
+    };
+
+    ViewerWorker(QObject* parent = 0);
+    virtual ~ViewerWorker();
+
+    /// reads an octree (.bt or .ot file), see takeTree()
+    void readTree(const std::string& filename);
+    /// reads a binary scan graph, see takeScanGraph()
+    void readScanGraph(const std::string& filename);
+    /// inserts the scans from begin to end (excluded) into tree
+    void insertScans(OcTree* tree, ScanGraph::iterator begin, ScanGraph::iterator end, double maxrange);
+
+    /// generate the cubes of drawer for tree after the task, only changed
+    /// subtrees if incremental (see OcTreeDrawer::updateOcTree())
+    void addDrawer(OcTreeDrawer* drawer, const AbstractOcTree* tree,
+                   const pose6d& origin, int id, bool incremental);
+
+    Task getTask() const { return m_task; }
+    /// tree read by the last job (NULL on errors), the caller takes ownership
+    AbstractOcTree* takeTree();
+    /// scan graph read by the last job (NULL on errors), the caller takes ownership
+    ScanGraph* takeScanGraph();
+
+    /// resets the job after it finished, deleting results which were not taken
+    void clearJob();
+
+  signals:
+    /// progress of the running job, total is 0 if unknown
+    void progress(QString message, int done, int total);
+    /// the task of the running job failed, emitted before finished()
+    void failed(QString message);
+
+  protected:
+    virtual void run();
+
+    struct DrawerJob {
+      OcTreeDrawer* drawer;
+      const AbstractOcTree* tree;
+      pose6d origin;
+      int id;
+      bool incremental;
+    };
+
+    Task m_task;
+    std::string m_filename;
+    OcTree* m_insertTree;
+    ScanGraph::iterator m_scansBegin;
+    ScanGraph::iterator m_scansEnd;
+    double m_maxrange;
+    std::vector<DrawerJob> m_drawerJobs;
+
+    AbstractOcTree* m_tree;
+    ScanGraph* m_scanGraph;
+  };
+
+} // namespace
+
+#endif /* VIEWERWORKER_H_ */
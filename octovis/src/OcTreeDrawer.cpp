@@ -23,16 +23,89 @@
  */
 
 #include <octovis/OcTreeDrawer.h>
+#include <octomap/ColorOcTree.h>
 #include <qglviewer.h>
+#include <QGLBuffer>
+#include <QGLContext>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 
 #define OTD_RAD2DEG 57.2957795
+// levels of the subtrees which are regenerated and stored in one buffer
+#define OTD_CHUNK_LEVELS 6
+// coarsest cube size (pixels) the level of detail adapts to
+#define OTD_MAX_LOD_PIXEL_SIZE 32.0
+// longer times between frames (ms) are idle time, not frame time
+#define OTD_MAX_FRAME_INTERVAL 1000
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
 
 namespace octomap {
 
+  // timer queries (OpenGL 3.3 or ARB_timer_query), resolved from the current context
+  struct TimerQueryFunctions {
+    typedef void (APIENTRY *GenQueries)(GLsizei n, GLuint* ids);
+    typedef void (APIENTRY *DeleteQueries)(GLsizei n, const GLuint* ids);
+    typedef void (APIENTRY *BeginQuery)(GLenum target, GLuint id);
+    typedef void (APIENTRY *EndQuery)(GLenum target);
+    typedef void (APIENTRY *GetQueryObjectuiv)(GLuint id, GLenum pname, GLuint* params);
+
+    TimerQueryFunctions() : supported(false), genQueries(NULL), deleteQueries(NULL),
+                            beginQuery(NULL), endQuery(NULL), getQueryObjectuiv(NULL) {
+      const QGLContext* context = QGLContext::currentContext();
+      const char* version = (const char*) glGetString(GL_VERSION);
+      const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+      if (context == NULL || version == NULL)
+        return;
+      int major = 0, minor = 0;
+      sscanf(version, "%d.%d", &major, &minor);
+      if (major < 3 || (major == 3 && minor < 3)) {
+        if (extensions == NULL || (strstr(extensions, "GL_ARB_timer_query") == NULL
+                                   && strstr(extensions, "GL_EXT_timer_query") == NULL))
+          return;
+      }
+      genQueries = (GenQueries) context->getProcAddress("glGenQueries");
+      deleteQueries = (DeleteQueries) context->getProcAddress("glDeleteQueries");
+      beginQuery = (BeginQuery) context->getProcAddress("glBeginQuery");
+      endQuery = (EndQuery) context->getProcAddress("glEndQuery");
+      getQueryObjectuiv = (GetQueryObjectuiv) context->getProcAddress("glGetQueryObjectuiv");
+      supported = genQueries && deleteQueries && beginQuery && endQuery && getQueryObjectuiv;
+    }
+
+    bool supported;
+    GenQueries genQueries;
+    DeleteQueries deleteQueries;
+    BeginQuery beginQuery;
+    EndQuery endQuery;
+    GetQueryObjectuiv getQueryObjectuiv;
+  };
+
+  // needs a current GL context on the first call
+  static const TimerQueryFunctions& timerQueryFunctions() {
+    static const TimerQueryFunctions functions;
+    return functions;
+  }
+
   OcTreeDrawer::OcTreeDrawer() : SceneObject(),
-                                 m_occupiedThresSize(0), m_freeThresSize(0),
-                                 m_occupiedSize(0), m_freeSize(0), m_selectionSize(0),
-                                 octree_grid_vertex_size(0), m_alphaOccupied(0.8), map_id(0)
+                                 m_chunksMutex(QMutex::Recursive),
+                                 m_chunks_max_depth(0), m_chunks_surfaces(false), m_surfaceExtraction(false),
+                                 m_useBuffers(true),
+                                 m_lodEnabled(true), m_frameTimeBudget(50.0), m_lodPixelSize(1.0),
+                                 m_lodLeafSize(0.0), m_frameQuery(0), m_frameQueryPending(false),
+                                 m_frameQueryCpuTime(0.0), m_selectionSize(0),
+                                 octree_grid_vertex_size(0), m_max_tree_depth(16), m_alphaOccupied(0.8), map_id(0)
   {
     m_octree_grid_vis_initialized = false;
     m_drawOccupied = true;
@@ -43,12 +116,6 @@ namespace octomap {
     m_update = true;
     m_alternativeDrawing = false;
 
-    m_occupiedArray = NULL;
-    m_freeArray = NULL;
-    m_occupiedThresArray = NULL;
-    m_freeThresArray = NULL;
-    m_occupiedColorArray = NULL;
-    m_occupiedThresColorArray = NULL;
     m_selectionArray = NULL;
 
     // origin and movement
@@ -58,6 +125,8 @@ namespace octomap {
 
   OcTreeDrawer::~OcTreeDrawer() {
     clear();
+    if (m_frameQuery != 0 && QGLContext::currentContext() != NULL)
+      timerQueryFunctions().deleteQueries(1, &m_frameQuery);
   }
 
   void OcTreeDrawer::draw() const {
@@ -98,6 +167,13 @@ namespace octomap {
         glRotatef(angle, axis_x, axis_y, axis_z);
       }
 
+      const bool timeFrame = m_lodEnabled && !m_alternativeDrawing;
+      QElapsedTimer frameTimer;
+      frameTimer.start();
+      if (timeFrame)
+        beginFrameTiming();
+      selectVisibleChunks();
+
       glEnableClientState(GL_VERTEX_ARRAY);
 
         if (m_drawOccupied)
@@ -115,6 +191,9 @@ namespace octomap {
 
       glDisableClientState(GL_VERTEX_ARRAY);
 
+      if (timeFrame)
+        endFrameTiming(double(frameTimer.elapsed()));
+
       // reset previous status
       glPopMatrix();
       if(m_alternativeDrawing) { 
@@ -137,43 +216,18 @@ namespace octomap {
 
 
   void OcTreeDrawer::setOcTree(const AbstractOcTree& tree, const pose6d& origin, int map_id_) {
-      
-    const OcTree& octree = (const OcTree&) tree;
-    this->map_id = map_id_;
+    prepareOcTree(tree, origin, map_id_);
+    swapBuffers();
+  }
 
-    // save origin used during cube generation
-    this->initial_origin = octomap::pose6d(octomap::point3d(0,0,0), origin.rot());
+  void OcTreeDrawer::updateOcTree(const AbstractOcTree& tree) {
+    prepareOcTreeUpdate(tree);
+    swapBuffers();
+  }
 
-    // origin is in global coords
-    this->origin = origin;
-    
-    // maximum size to prevent crashes on large maps: (should be checked in a better way than a constant)
-    bool showAll = (octree.size() < 5 * 1e6);
-    bool uses_origin = ( (origin.rot().x() != 0.) && (origin.rot().y() != 0.)
-        && (origin.rot().z() != 0.) && (origin.rot().u() != 1.) );
-
-    // walk the tree one to find the number of nodes in each category
-    // (this is used to set up the OpenGL arrays)
-    // TODO: this step may be left out, if we maintained the GLArrays in std::vectors instead...
-    unsigned int cnt_occupied(0), cnt_occupied_thres(0), cnt_free(0), cnt_free_thres(0);
-    for(OcTree::tree_iterator it = octree.begin_tree(this->m_max_tree_depth),
-            end=octree.end_tree(); it!= end; ++it) {
-      if (it.isLeaf()) { 
-        if (octree.isNodeOccupied(*it)){ // occupied voxels
-          if (octree.isNodeAtThreshold(*it)) ++cnt_occupied_thres;
-          else                               ++cnt_occupied;
-        }
-        else if (showAll) { // freespace voxels
-          if (octree.isNodeAtThreshold(*it)) ++cnt_free_thres;
-          else                               ++cnt_free;
-        }
-      }        
-    }    
-    // setup GL arrays for cube quads and cube colors
-    initGLArrays(cnt_occupied      , m_occupiedSize     , &m_occupiedArray     , &m_occupiedColorArray);
-    initGLArrays(cnt_occupied_thres, m_occupiedThresSize, &m_occupiedThresArray, &m_occupiedThresColorArray);
-    initGLArrays(cnt_free          , m_freeSize         , &m_freeArray, NULL);
-    initGLArrays(cnt_free_thres    , m_freeThresSize    , &m_freeThresArray, NULL);
+  void OcTreeDrawer::prepareOcTree(const AbstractOcTree& tree, const pose6d& origin, int map_id_) {
+
+    const OcTree& octree = (const OcTree&) tree;
 
     double minX, minY, minZ, maxX, maxY, maxZ;
     octree.getMetricMin(minX, minY, minZ);
@@ -183,60 +237,520 @@ namespace octomap {
     m_zMin = minZ;
     m_zMax = maxZ;
 
+    generateChunks(octree, origin, map_id_, false);
+  }
+
+  void OcTreeDrawer::prepareOcTreeUpdate(const AbstractOcTree& tree) {
+
+    const OcTree& octree = (const OcTree&) tree;
+
+    double minX, minY, minZ, maxX, maxY, maxZ;
+    octree.getMetricMin(minX, minY, minZ);
+    octree.getMetricMax(maxX, maxY, maxZ);
+    // height map colors of all cubes change with the height range
+    bool heightChanged = (m_colorMode == CM_COLOR_HEIGHT || m_colorMode == CM_GRAY_HEIGHT)
+        && (minZ != m_zMin || maxZ != m_zMax);
+
+    bool chunksOutdated;
+    {
+      QMutexLocker lock(&m_chunksMutex);
+      chunksOutdated = m_chunks.empty() || m_chunks_max_depth != m_max_tree_depth
+          || m_chunks_surfaces != m_surfaceExtraction;
+    }
+
+    // the octree grid is not maintained incrementally
+    if (chunksOutdated || !octree.isChangeDetectionEnabled() || heightChanged || m_drawOcTreeGrid) {
+      prepareOcTree(tree, this->origin, this->map_id);
+      return;
+    }
+
+    m_zMin = minZ;
+    m_zMax = maxZ;
+    generateChunks(octree, this->origin, this->map_id, true);
+  }
+
+  void OcTreeDrawer::swapBuffers() {
+    if (!m_back.pending)
+      return;
+
+    QMutexLocker lock(&m_chunksMutex);
+
+    if (m_back.complete) {
+      clearChunks();
+      m_grid_voxels.swap(m_back.gridVoxels);
+      m_octree_grid_vis_initialized = false;
+    }
+    else {
+      m_visibleChunks.clear();
+      for (KeySet::const_iterator it = m_back.removedChunks.begin(); it != m_back.removedChunks.end(); ++it) {
+        CubeChunkMap::iterator chunk_it = m_chunks.find(*it);
+        if (chunk_it != m_chunks.end()) {
+          clearChunk(chunk_it->second);
+          m_chunks.erase(chunk_it);
+        }
+      }
+    }
+
+    // the cube arrays are handed over to the drawn chunks
+    for (CubeChunkMap::iterator it = m_back.chunks.begin(); it != m_back.chunks.end(); ++it) {
+      CubeChunkMap::iterator chunk_it = m_chunks.find(it->first);
+      if (chunk_it != m_chunks.end()) {
+        clearChunk(chunk_it->second);
+        chunk_it->second = it->second;
+      }
+      else
+        m_chunks.insert(*it);
+    }
+    clearChunk(m_coarseChunk);
+    m_coarseChunk = m_back.coarseChunk;
+
+    m_chunks_max_depth = m_back.maxDepth;
+    m_chunks_surfaces = m_back.surfaces;
+    m_lodLeafSize = m_back.leafSize;
+    this->map_id = m_back.mapId;
+    // save origin used during cube generation
+    this->initial_origin = octomap::pose6d(octomap::point3d(0,0,0), m_back.origin.rot());
+    // origin is in global coords
+    this->origin = m_back.origin;
+
+    const bool complete = m_back.complete;
+    m_back = ChunkBuffer();
+    lock.unlock();
+
+    if (complete && m_drawOcTreeGrid)
+      initOctreeGridVis();
+    m_update = true;
+  }
+
+  template <class TREE>
+  void OcTreeDrawer::generateChunks(const TREE& tree, const pose6d& origin, int map_id_, bool incremental) {
+
+    // discard cubes generated before, but never shown
+    clearBuffer();
+    m_back.origin = origin;
+    m_back.mapId = map_id_;
+    m_back.complete = !incremental;
+
+    // subtrees of OTD_CHUNK_LEVELS levels are regenerated (and uploaded) as a whole
+    const unsigned int maxDepth = std::min(m_max_tree_depth, tree.getTreeDepth());
+    const unsigned int chunkDepth = (maxDepth > OTD_CHUNK_LEVELS) ? maxDepth - OTD_CHUNK_LEVELS : 1;
+    m_back.maxDepth = m_max_tree_depth;
+    m_back.surfaces = m_surfaceExtraction;
+    m_back.leafSize = tree.getNodeSize(maxDepth);
+
     std::vector<octomath::Vector3> cube_template;
     initCubeTemplate(origin, cube_template);
 
-    unsigned int idx_occupied(0), idx_occupied_thres(0), idx_free(0), idx_free_thres(0);
-    unsigned int color_idx_occupied(0), color_idx_occupied_thres(0);
-
-    m_grid_voxels.clear();
-    OcTreeVolume voxel; // current voxel, possibly transformed 
-    for(OcTree::tree_iterator it = octree.begin_tree(this->m_max_tree_depth),
-            end=octree.end_tree(); it!= end; ++it) {
-
-      if (it.isLeaf()) { // voxels for leaf nodes
-        if (uses_origin) 
-          voxel = OcTreeVolume(origin.rot().rotate(it.getCoordinate()), it.getSize());
-        else 
-          voxel = OcTreeVolume(it.getCoordinate(), it.getSize());
-        
-        if (octree.isNodeOccupied(*it)){ // occupied voxels
-          if (octree.isNodeAtThreshold(*it)) {
-            idx_occupied_thres = generateCube(voxel, cube_template, idx_occupied_thres, &m_occupiedThresArray);
-            color_idx_occupied_thres = setCubeColorHeightmap(voxel, color_idx_occupied_thres, &m_occupiedThresColorArray);
+    LeafCubeList sharedLeaves[NUM_LOD_LEVELS][NUM_CUBE_CATEGORIES];
+    LeafCubeList levelLeaves[NUM_LOD_LEVELS][NUM_CUBE_CATEGORIES];
+    LeafCubeList coarseLeaves[NUM_LOD_LEVELS][NUM_CUBE_CATEGORIES];
+
+    KeySet changedChunks;
+    // the drawn chunks are copied, the GUI thread may swap them meanwhile
+    KeySet drawnChunks;
+    bool showGrid = false;
+    if (incremental) {
+      {
+        QMutexLocker lock(&m_chunksMutex);
+        for (CubeChunkMap::const_iterator it = m_chunks.begin(); it != m_chunks.end(); ++it)
+          drawnChunks.insert(it->first);
+      }
+
+      const unsigned int coarsestCut = std::max(int(chunkDepth), int(maxDepth) - int(NUM_LOD_LEVELS - 1));
+      const key_type neighborOffset = key_type(1 << (tree.getTreeDepth() - coarsestCut));
+      for (KeyBoolMap::const_iterator it = tree.changedKeysBegin(); it != tree.changedKeysEnd(); ++it) {
+        changedChunks.insert(tree.adjustKeyAtDepth(it->first, chunkDepth));
+        // a change may also cover or expose the surface of a neighboring chunk,
+        // up to the node size of the coarsest level of detail away
+        if (m_back.surfaces) {
+          for (unsigned int i = 0; i < 3; ++i) {
+            OcTreeKey neighborKey = it->first;
+            neighborKey[i] = it->first[i] - neighborOffset;
+            changedChunks.insert(tree.adjustKeyAtDepth(neighborKey, chunkDepth));
+            neighborKey[i] = it->first[i] + neighborOffset;
+            changedChunks.insert(tree.adjustKeyAtDepth(neighborKey, chunkDepth));
           }
-          else {
-            idx_occupied = generateCube(voxel, cube_template, idx_occupied, &m_occupiedArray);
-            color_idx_occupied = setCubeColorHeightmap(voxel, color_idx_occupied, &m_occupiedColorArray);
+        }
+      }
+    }
+    else {
+      // the octree grid is kept in host memory, skip it for very large maps
+      showGrid = (tree.size() < 5 * 1e6);
+      if (!showGrid)
+        std::cerr << "OcTreeDrawer: octree structure not generated for trees with more than 5M nodes.\n";
+    }
+
+    // chunks are the nodes at chunk depth, leaves above are drawn as they are
+    KeySet existingChunks;
+    for(typename TREE::tree_iterator it = tree.begin_tree(chunkDepth),
+          end=tree.end_tree(); it!= end; ++it) {
+      if (it.getDepth() == chunkDepth) {
+        const OcTreeKey& chunkKey = it.getKey();
+        existingChunks.insert(chunkKey);
+
+        if (incremental && drawnChunks.find(chunkKey) != drawnChunks.end()
+            && changedChunks.find(chunkKey) == changedChunks.end())
+          continue;
+
+        collectChunkCubes(tree, &(*it), chunkKey, chunkDepth, chunkDepth, maxDepth, showGrid,
+                          sharedLeaves, levelLeaves);
+        CubeChunk& chunk = m_back.chunks[chunkKey];
+        if (m_back.surfaces)
+          generateSurfaces(tree, chunkKey, chunkDepth, maxDepth, sharedLeaves, levelLeaves, chunk);
+        generateChunk(sharedLeaves, levelLeaves, cube_template, chunk, m_back.surfaces);
+      }
+      else if (it.isLeaf()) {
+        addLeafCube(&(*it), tree.isNodeOccupied(*it), tree.isNodeAtThreshold(*it),
+                    it.getCoordinate(), it.getSize(), coarseLeaves[0]);
+      }
+      else if (showGrid) { // inner node voxels (for grid structure only)
+        addGridVoxel(it.getCoordinate(), it.getSize());
+      }
+    }
+
+    // pruning or expansion above the chunk depth changes which subtrees exist
+    if (incremental) {
+      for (KeySet::const_iterator it = drawnChunks.begin(); it != drawnChunks.end(); ++it) {
+        if (existingChunks.find(*it) == existingChunks.end())
+          m_back.removedChunks.insert(*it);
+      }
+    }
+
+    // the coarse chunk is always drawn at level 0
+    generateChunk(coarseLeaves, levelLeaves, cube_template, m_back.coarseChunk);
+    m_back.pending = true;
+  }
+
+  template <class TREE>
+  void OcTreeDrawer::collectChunkCubes(const TREE& tree, const typename TREE::NodeType* node,
+                                       const OcTreeKey& key, unsigned int depth,
+                                       unsigned int chunkDepth, unsigned int maxDepth, bool addGrid,
+                                       LeafCubeList sharedLeaves[][NUM_CUBE_CATEGORIES],
+                                       LeafCubeList levelLeaves[][NUM_CUBE_CATEGORIES]) {
+    const bool hasChildren = (depth < maxDepth) && tree.nodeHasChildren(node);
+
+    // level l shows the tree cut at depth max(chunkDepth, maxDepth-l): inner nodes at
+    // the cut (with their aggregated occupancy) and all leaves above it
+    if (!hasChildren) {
+      // shown by all levels up to the coarsest one whose cut is not above the leaf
+      unsigned int level = NUM_LOD_LEVELS - 1;
+      if (depth > chunkDepth)
+        level = std::min(level, maxDepth - depth);
+      addLeafCube(node, tree.isNodeOccupied(node), tree.isNodeAtThreshold(node),
+                  tree.keyToCoord(key, depth), tree.getNodeSize(depth), sharedLeaves[level]);
+      return;
+    }
+
+    bool occupied = false, atThreshold = false, classified = false;
+    for (unsigned int l = 0; l < NUM_LOD_LEVELS; ++l) {
+      const unsigned int cut = std::max(int(chunkDepth), int(maxDepth) - int(l));
+      if (depth == cut) {
+        if (!classified) {
+          occupied = tree.isNodeOccupied(node);
+          atThreshold = tree.isNodeAtThreshold(node);
+          classified = true;
+        }
+        addLeafCube(node, occupied, atThreshold, tree.keyToCoord(key, depth),
+                    tree.getNodeSize(depth), levelLeaves[l]);
+      }
+    }
+
+    if (addGrid)
+      addGridVoxel(tree.keyToCoord(key, depth), tree.getNodeSize(depth));
+
+    const key_type center_offset_key = key_type(1 << (tree.getTreeDepth() - 1)) >> (depth + 1);
+    OcTreeKey childKey;
+    for (unsigned int i = 0; i < 8; ++i) {
+      if (tree.nodeChildExists(node, i)) {
+        computeChildKey(i, center_offset_key, key, childKey);
+        collectChunkCubes(tree, tree.getNodeChild(node, i), childKey, depth + 1,
+                          chunkDepth, maxDepth, addGrid, sharedLeaves, levelLeaves);
+      }
+    }
+  }
+
+  // whether the faces of two leaves can be merged: same category and color
+  static bool mergeableFaces(int leaf, int otherLeaf, const std::vector<unsigned int>& categories,
+                             const std::vector<GLubyte>& colors) {
+    if (leaf < 0 || otherLeaf < 0 || categories[leaf] != categories[otherLeaf])
+      return false;
+    for (unsigned int i = 0; i < 4; ++i) {
+      if (colors[4*leaf + i] != colors[4*otherLeaf + i])
+        return false;
+    }
+    return true;
+  }
+
+  template <class TREE>
+  void OcTreeDrawer::generateSurfaces(const TREE& tree, const OcTreeKey& chunkKey, unsigned int chunkDepth,
+                                      unsigned int maxDepth, LeafCubeList sharedLeaves[][NUM_CUBE_CATEGORIES],
+                                      LeafCubeList levelLeaves[][NUM_CUBE_CATEGORIES], CubeChunk& chunk) {
+    // face array i of generateCube() points along axis faceAxis[i] in direction faceDir[i]
+    static const unsigned int faceAxis[6] = {1, 1, 0, 0, 2, 2};
+    static const int faceDir[6] = {1, -1, 1, -1, -1, 1};
+    static const unsigned int occupiedCategories[2] = {CUBES_OCCUPIED_THRES, CUBES_OCCUPIED};
+    const double eps = 1e-5; // as in generateCube()
+
+    std::vector<octomath::Vector3> cube_template;
+    initCubeTemplate(m_back.origin, cube_template);
+
+    // chunk extent in keys and meters (in the tree frame)
+    const double resolution = tree.getResolution();
+    const long maxKey = (1L << tree.getTreeDepth()) - 1;
+    const int chunkSpan = 1 << (tree.getTreeDepth() - chunkDepth);
+    long minKey[3];
+    double minCoord[3];
+    for (unsigned int i = 0; i < 3; ++i) {
+      minKey[i] = long(chunkKey[i]) - chunkSpan / 2;
+      minCoord[i] = tree.keyToCoord(key_type(minKey[i])) - 0.5 * resolution;
+    }
+
+    std::vector<int> cells;      // leaf index per cell, -1 if not occupied
+    std::vector<int> mask;       // visible faces of one slice, by leaf index
+    std::vector<unsigned int> categories;
+    std::vector<GLubyte> colors; // RGBA per leaf
+    std::vector<GLfloat> faceVertices[2][6];
+    std::vector<GLubyte> faceColors[2][6];
+
+    for (unsigned int l = 0; l < NUM_LOD_LEVELS; ++l) {
+      // level l is a grid of n^3 cells at the depth of its tree cut (see collectChunkCubes())
+      const unsigned int cut = std::max(int(chunkDepth), int(maxDepth) - int(l));
+      const int n = 1 << (cut - chunkDepth);
+      const int step = chunkSpan / n;
+      const double cellSize = step * resolution;
+
+      cells.assign(n * n * n, -1);
+      categories.clear();
+      colors.clear();
+      // the cubes of level l: its own ones and the shared leaves of levels l and coarser
+      for (unsigned int c = 0; c < 2; ++c) {
+        for (unsigned int b = l; b <= NUM_LOD_LEVELS; ++b) {
+          const LeafCubeList& list = (b < NUM_LOD_LEVELS) ? sharedLeaves[b][occupiedCategories[c]]
+                                                          : levelLeaves[l][occupiedCategories[c]];
+          for (LeafCubeList::const_iterator it = list.begin(); it != list.end(); ++it) {
+            const int leaf = int(categories.size());
+            categories.push_back(c);
+            GLubyte leafColors[16];
+            GLubyte* leafColorArray = leafColors;
+            setCubeColor(*it->second, it->first, 0, &leafColorArray);
+            colors.insert(colors.end(), leafColors, leafColors + 4);
+
+            point3d center = it->first.first;
+            if (usesOrigin())
+              center = m_back.origin.rot().inv().rotate(center);
+            // key of the lowest leaf corner, from the center of its cell at maximum depth
+            const double halfSize = 0.5 * (it->first.second - resolution);
+            const int count = std::max(1, int(it->first.second / cellSize + 0.5));
+            int first[3];
+            for (unsigned int i = 0; i < 3; ++i)
+              first[i] = (int(tree.coordToKey(center(i) - halfSize)) - int(minKey[i])) / step;
+            for (int x = first[0]; x < first[0] + count; ++x)
+              for (int y = first[1]; y < first[1] + count; ++y)
+                for (int z = first[2]; z < first[2] + count; ++z)
+                  cells[(x * n + y) * n + z] = leaf;
           }
         }
-        else if (showAll) { // freespace voxels
-          if (octree.isNodeAtThreshold(*it)) {
-            idx_free_thres = generateCube(voxel, cube_template, idx_free_thres, &m_freeThresArray);
+      }
+      if (categories.empty())
+        continue;
+
+      for (unsigned int f = 0; f < 6; ++f) {
+        const unsigned int a = faceAxis[f], u = (a + 1) % 3, v = (a + 2) % 3;
+        for (int slice = 0; slice < n; ++slice) {
+          // a face is visible if the neighbor cell is free or unknown
+          mask.assign(n * n, -1);
+          bool visible = false;
+          for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < n; ++j) {
+              int cell[3];
+              cell[a] = slice; cell[u] = i; cell[v] = j;
+              const int leaf = cells[(cell[0] * n + cell[1]) * n + cell[2]];
+              if (leaf < 0)
+                continue;
+
+              cell[a] += faceDir[f];
+              bool covered = false;
+              if (cell[a] >= 0 && cell[a] < n) {
+                covered = (cells[(cell[0] * n + cell[1]) * n + cell[2]] >= 0);
+              }
+              else { // neighbor chunk, looked up at the same tree cut
+                OcTreeKey neighborKey;
+                bool inside = true;
+                for (unsigned int k = 0; k < 3; ++k) {
+                  const long key = minKey[k] + long(cell[k]) * step;
+                  inside = inside && key >= 0 && key <= maxKey;
+                  neighborKey[k] = key_type(key);
+                }
+                if (inside) {
+                  const typename TREE::NodeType* node = tree.search(neighborKey, cut);
+                  covered = (node != NULL && tree.isNodeOccupied(node));
+                }
+              }
+              if (!covered) {
+                mask[i * n + j] = leaf;
+                visible = true;
+              }
+            }
           }
-          else {
-            idx_free = generateCube(voxel, cube_template, idx_free, &m_freeArray);
+          if (!visible)
+            continue;
+
+          // greedy merging of visible faces into rectangles
+          for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < n; ) {
+              const int leaf = mask[i * n + j];
+              if (leaf < 0) {
+                ++j;
+                continue;
+              }
+              int width = 1;
+              while (j + width < n && mergeableFaces(mask[i * n + j + width], leaf, categories, colors))
+                ++width;
+              int height = 1;
+              for (bool mergeable = true; mergeable && i + height < n; ) {
+                for (int k = 0; k < width && mergeable; ++k)
+                  mergeable = mergeableFaces(mask[(i + height) * n + j + k], leaf, categories, colors);
+                if (mergeable)
+                  ++height;
+              }
+              for (int h = 0; h < height; ++h)
+                for (int k = 0; k < width; ++k)
+                  mask[(i + h) * n + j + k] = -1;
+
+              double bbxMin[3], bbxMax[3];
+              bbxMin[a] = minCoord[a] + slice * cellSize;
+              bbxMax[a] = bbxMin[a] + cellSize;
+              bbxMin[u] = minCoord[u] + i * cellSize;
+              bbxMax[u] = bbxMin[u] + height * cellSize;
+              bbxMin[v] = minCoord[v] + j * cellSize;
+              bbxMax[v] = bbxMin[v] + width * cellSize;
+
+              // vertices in the order of the cube template
+              const unsigned int c = categories[leaf];
+              for (unsigned int k = 0; k < 4; ++k) {
+                const octomath::Vector3& corner = cube_template[6 * k + f];
+                point3d p;
+                for (unsigned int d = 0; d < 3; ++d)
+                  p(d) = (corner(d) > 0) ? bbxMax[d] - eps : bbxMin[d] + eps;
+                if (usesOrigin())
+                  p = m_back.origin.rot().rotate(p);
+                faceVertices[c][f].push_back(p.x());
+                faceVertices[c][f].push_back(p.y());
+                faceVertices[c][f].push_back(p.z());
+                faceColors[c][f].insert(faceColors[c][f].end(), colors.begin() + 4 * leaf,
+                                        colors.begin() + 4 * leaf + 4);
+              }
+              j += width;
+            }
           }
         }
       }
-      
-      else { // inner node voxels (for grid structure only)
-        if (showAll) {
-          if (uses_origin)
-            voxel = OcTreeVolume(origin.rot().rotate(it.getCoordinate()), it.getSize());
-          else
-            voxel = OcTreeVolume(it.getCoordinate(), it.getSize());
-          m_grid_voxels.push_back(voxel);
+
+      for (unsigned int c = 0; c < 2; ++c) {
+        unsigned int size = 0;
+        for (unsigned int f = 0; f < 6; ++f)
+          size += faceVertices[c][f].size();
+        if (size == 0)
+          continue;
+
+        CubeArray& cubes = chunk.levelCubes[l][occupiedCategories[c]];
+        clearCubes(cubes);
+        cubes.colored = true;
+        cubes.surface = true;
+        cubes.size = size;
+        cubes.quads = new GLfloat* [6];
+        cubes.colors = new GLubyte[size / 3 * 4];
+        GLubyte* color = cubes.colors;
+        for (unsigned int f = 0; f < 6; ++f) {
+          cubes.faceSize[f] = faceVertices[c][f].size();
+          cubes.quads[f] = new GLfloat[cubes.faceSize[f]];
+          std::copy(faceVertices[c][f].begin(), faceVertices[c][f].end(), cubes.quads[f]);
+          color = std::copy(faceColors[c][f].begin(), faceColors[c][f].end(), color);
+          faceVertices[c][f].clear();
+          faceColors[c][f].clear();
         }
-      }      
-    } // end for all voxels
+      }
+    }
+  }
 
-    m_octree_grid_vis_initialized = false;
+  // explicit instantiations for the tree types with a drawer
+  template void OcTreeDrawer::generateChunks<OcTree>(const OcTree& tree, const pose6d& origin,
+                                                     int map_id_, bool incremental);
+  template void OcTreeDrawer::generateChunks<ColorOcTree>(const ColorOcTree& tree, const pose6d& origin,
+                                                          int map_id_, bool incremental);
+
+  void OcTreeDrawer::addLeafCube(const OcTreeNode* node, bool occupied, bool atThreshold,
+                                 const point3d& coord, double size, LeafCubeList* leaves) const {
+    OcTreeVolume voxel; // current voxel, possibly transformed
+    if (usesOrigin())
+      voxel = OcTreeVolume(m_back.origin.rot().rotate(coord), size);
+    else
+      voxel = OcTreeVolume(coord, size);
 
-    if(m_drawOcTreeGrid)
-      initOctreeGridVis();
+    if (occupied)
+      leaves[atThreshold ? CUBES_OCCUPIED_THRES : CUBES_OCCUPIED].push_back(std::make_pair(voxel, node));
+    else
+      leaves[atThreshold ? CUBES_FREE_THRES : CUBES_FREE].push_back(std::make_pair(voxel, node));
+  }
+
+  void OcTreeDrawer::addGridVoxel(const point3d& coord, double size) {
+    if (usesOrigin())
+      m_back.gridVoxels.push_back(OcTreeVolume(m_back.origin.rot().rotate(coord), size));
+    else
+      m_back.gridVoxels.push_back(OcTreeVolume(coord, size));
+  }
+
+  void OcTreeDrawer::generateChunk(LeafCubeList sharedLeaves[][NUM_CUBE_CATEGORIES],
+                                   LeafCubeList levelLeaves[][NUM_CUBE_CATEGORIES],
+                                   const std::vector<octomath::Vector3>& cube_template,
+                                   CubeChunk& chunk, bool occupiedSurfaces) {
+    bool empty = true;
+    for (unsigned int l = 0; l < NUM_LOD_LEVELS; ++l) {
+      for (unsigned int c = 0; c < NUM_CUBE_CATEGORIES; ++c) {
+        // only occupied cubes are colored
+        const bool occupied = (c == CUBES_OCCUPIED_THRES || c == CUBES_OCCUPIED);
+        const bool generate = !(occupied && occupiedSurfaces);
+        generateCubeArray(sharedLeaves[l][c], occupied, cube_template, chunk.sharedCubes[l][c],
+                          generate, chunk, empty);
+        generateCubeArray(levelLeaves[l][c], occupied, cube_template, chunk.levelCubes[l][c],
+                          generate, chunk, empty);
+      }
+    }
+  }
+
+  void OcTreeDrawer::generateCubeArray(LeafCubeList& leaves, bool occupied,
+                                       const std::vector<octomath::Vector3>& cube_template,
+                                       CubeArray& cubes, bool generate, CubeChunk& chunk, bool& empty) {
+    if (leaves.empty())
+      return;
+
+    if (generate) {
+      cubes.colored = occupied;
+      initGLArrays(leaves.size(), cubes.size, &cubes.quads, cubes.colored ? &cubes.colors : NULL);
+    }
+
+    unsigned int idx = 0, color_idx = 0;
+    for (LeafCubeList::const_iterator it = leaves.begin(); it != leaves.end(); ++it) {
+      if (generate) {
+        idx = generateCube(it->first, cube_template, idx, &cubes.quads);
+        if (cubes.colored)
+          color_idx = setCubeColor(*it->second, it->first, color_idx, &cubes.colors);
+      }
+
+      // bounding box for view frustum culling (all levels cover the same space)
+      double half_size = it->first.second / 2.0;
+      for (unsigned int i = 0; i < 3; ++i) {
+        if (empty || it->first.first(i) - half_size < chunk.bbxMin(i))
+          chunk.bbxMin(i) = it->first.first(i) - half_size;
+        if (empty || it->first.first(i) + half_size > chunk.bbxMax(i))
+          chunk.bbxMax(i) = it->first.first(i) + half_size;
+      }
+      empty = false;
+    }
+    leaves.clear();
   }
 
+
   void OcTreeDrawer::setOcTreeSelection(const std::list<octomap::OcTreeVolume>& selectedVoxels){
     m_update = true;
     generateCubes(selectedVoxels, &m_selectionArray, m_selectionSize, this->origin);
@@ -249,7 +763,7 @@ namespace octomap {
 
   void OcTreeDrawer::initGLArrays(const unsigned int& num_cubes,
                                   unsigned int& glArraySize,
-                                  GLfloat*** glArray, GLfloat** glColorArray) {
+                                  GLfloat*** glArray, GLubyte** glColorArray) {
 
     clearCubes(glArray, glArraySize, glColorArray);
 
@@ -261,9 +775,9 @@ namespace octomap {
     for (unsigned i = 0; i<6; ++i){
       (*glArray)[i] = new GLfloat[glArraySize];
     }
-    // setup quad color array, if given
+    // setup quad color array (RGBA for 4 vertices per cube), if given
     if (glColorArray != NULL)
-      *glColorArray = new GLfloat[glArraySize * 4 *4];
+      *glColorArray = new GLubyte[num_cubes * 4 * 4];
   }
 
   void OcTreeDrawer::initCubeTemplate(const octomath::Pose6D& origin,
@@ -447,22 +961,20 @@ namespace octomap {
 
   unsigned int OcTreeDrawer::setCubeColorHeightmap(const octomap::OcTreeVolume& v,
                                           const unsigned int& current_array_idx,
-                                          GLfloat** glColorArray) {
+                                          GLubyte** glColorArray) {
 
     if (glColorArray == NULL) return current_array_idx;
 
-    unsigned int colorIdx = current_array_idx;
+    GLfloat color[3];
+    if (m_colorMode == CM_GRAY_HEIGHT)
+      SceneObject::heightMapGray(v.first.z(), color);  // sets r,g,b
+    else
+      SceneObject::heightMapColor(v.first.z(), color);   // sets r,g,b
+
     // color for all 4 vertices (same height)
-    for (int k = 0; k < 4; ++k) {
-      if (m_colorMode == CM_GRAY_HEIGHT)
-        SceneObject::heightMapGray(v.first.z(), *glColorArray + colorIdx);  // sets r,g,b
-      else
-        SceneObject::heightMapColor(v.first.z(), *glColorArray + colorIdx);   // sets r,g,b
-      // set Alpha value:
-      (*glColorArray)[colorIdx + 3] = m_alphaOccupied;
-      colorIdx += 4;
-    }  
-    return colorIdx;
+    return setCubeColorRGBA((unsigned char) (color[0] * 255. + 0.5), (unsigned char) (color[1] * 255. + 0.5),
+                            (unsigned char) (color[2] * 255. + 0.5), (unsigned char) (m_alphaOccupied * 255. + 0.5),
+                            current_array_idx, glColorArray);
   }
 
   unsigned int OcTreeDrawer::setCubeColorRGBA(const unsigned char& r,
@@ -470,16 +982,16 @@ namespace octomap {
                                               const unsigned char& b,
                                               const unsigned char& a,
                                               const unsigned int& current_array_idx,
-                                              GLfloat** glColorArray) {
+                                              GLubyte** glColorArray) {
 
     if (glColorArray == NULL) return current_array_idx;
     unsigned int colorIdx = current_array_idx;
     // set color for next 4 vertices (=one quad)
     for (int k = 0; k < 4; ++k) {
-      (*glColorArray)[colorIdx    ] = (double) r/255.;
-      (*glColorArray)[colorIdx + 1] = (double) g/255.;
-      (*glColorArray)[colorIdx + 2] = (double) b/255.;
-      (*glColorArray)[colorIdx + 3] = (double) a/255.;
+      (*glColorArray)[colorIdx    ] = r;
+      (*glColorArray)[colorIdx + 1] = g;
+      (*glColorArray)[colorIdx + 2] = b;
+      (*glColorArray)[colorIdx + 3] = a;
       colorIdx += 4;
     }  
     return colorIdx;
@@ -488,7 +1000,7 @@ namespace octomap {
 
   void OcTreeDrawer::clearCubes(GLfloat*** glArray,
                                 unsigned int& glArraySize,
-                                GLfloat** glColorArray) {
+                                GLubyte** glColorArray) const {
     if (glArraySize != 0) {
       for (unsigned i = 0; i < 6; ++i) {
         delete[] (*glArray)[i];
@@ -504,11 +1016,85 @@ namespace octomap {
   }
 
 
+  void OcTreeDrawer::clearCubes(CubeArray& cubes) const {
+    if (cubes.quads != NULL)
+      clearCubes(&cubes.quads, cubes.size, &cubes.colors);
+    delete cubes.buffer;
+    cubes = CubeArray();
+  }
+
+  void OcTreeDrawer::clearChunk(CubeChunk& chunk) const {
+    for (unsigned int l = 0; l < NUM_LOD_LEVELS; ++l) {
+      for (unsigned int c = 0; c < NUM_CUBE_CATEGORIES; ++c) {
+        clearCubes(chunk.sharedCubes[l][c]);
+        clearCubes(chunk.levelCubes[l][c]);
+      }
+    }
+  }
+
+  void OcTreeDrawer::clearChunks() {
+    QMutexLocker lock(&m_chunksMutex);
+    m_visibleChunks.clear();
+    for (CubeChunkMap::iterator it = m_chunks.begin(); it != m_chunks.end(); ++it)
+      clearChunk(it->second);
+    m_chunks.clear();
+    clearChunk(m_coarseChunk);
+  }
+
+  void OcTreeDrawer::clearBuffer() {
+    for (CubeChunkMap::iterator it = m_back.chunks.begin(); it != m_back.chunks.end(); ++it)
+      clearChunk(it->second);
+    clearChunk(m_back.coarseChunk);
+    m_back = ChunkBuffer();
+  }
+
+  void OcTreeDrawer::uploadCubes(CubeArray& cubes) const {
+    if (!m_useBuffers || cubes.buffer != NULL || cubes.quads == NULL)
+      return;
+
+    QGLBuffer* buffer = new QGLBuffer(QGLBuffer::VertexBuffer);
+    if (!buffer->create()) {
+      std::cerr << "Warning: vertex buffer objects not supported, drawing cubes from host memory.\n";
+      delete buffer;
+      m_useBuffers = false;
+      return;
+    }
+
+    // buffer layout: the six face arrays, followed by the color array
+    int vertexBytes = 0;
+    for (unsigned int i = 0; i < 6; ++i)
+      vertexBytes += (cubes.surface ? cubes.faceSize[i] : cubes.size) * sizeof(GLfloat);
+    const int colorBytes = cubes.colored ? (cubes.size / 3) * 4 * sizeof(GLubyte) : 0;
+    buffer->setUsagePattern(QGLBuffer::StaticDraw);
+    buffer->bind();
+    buffer->allocate(vertexBytes + colorBytes);
+    int offset = 0;
+    for (unsigned int i = 0; i < 6; ++i) {
+      const int faceBytes = (cubes.surface ? cubes.faceSize[i] : cubes.size) * sizeof(GLfloat);
+      buffer->write(offset, cubes.quads[i], faceBytes);
+      offset += faceBytes;
+    }
+    if (cubes.colored)
+      buffer->write(vertexBytes, cubes.colors, colorBytes);
+    buffer->release();
+    cubes.buffer = buffer;
+
+    // host copy is no longer needed
+    unsigned int size = cubes.size;
+    clearCubes(&cubes.quads, size, &cubes.colors);
+  }
+
+  unsigned int OcTreeDrawer::setCubeColor(const OcTreeNode& /*node*/, const octomap::OcTreeVolume& v,
+                                          const unsigned int& current_array_idx,
+                                          GLubyte** glColorArray) {
+    return setCubeColorHeightmap(v, current_array_idx, glColorArray);
+  }
+
   // still used for "selection" nodes
   void OcTreeDrawer::generateCubes(const std::list<octomap::OcTreeVolume>& voxels,
                                    GLfloat*** glArray, unsigned int& glArraySize,
                                    octomath::Pose6D& origin,
-                                   GLfloat** glColorArray) {
+                                   GLubyte** glColorArray) {
     unsigned int i = 0;
     unsigned int colorIdx = 0;
 
@@ -663,10 +1249,8 @@ namespace octomap {
 
   void OcTreeDrawer::clear() {
     //clearOcTree();
-    clearCubes(&m_occupiedArray, m_occupiedSize, &m_occupiedColorArray);
-    clearCubes(&m_occupiedThresArray, m_occupiedThresSize, &m_occupiedThresColorArray);
-    clearCubes(&m_freeArray, m_freeSize);
-    clearCubes(&m_freeThresArray, m_freeThresSize);
+    clearChunks();
+    clearBuffer();
     clearCubes(&m_selectionArray, m_selectionSize);
     clearOcTreeStructure();
   }
@@ -685,7 +1269,7 @@ namespace octomap {
       else { // object
         glColor3f(0., 0.784f, 0.725f); // cyan
       }
-      drawCubes(m_occupiedThresArray, m_occupiedThresSize, m_occupiedThresColorArray);
+      drawCubes(CUBES_OCCUPIED_THRES);
     }
     else {      
       // colors for printout mode:
@@ -699,16 +1283,12 @@ namespace octomap {
       }
 
       // draw binary occupied cells
-      if (m_occupiedThresSize != 0) {
-        if (m_colorMode != CM_PRINTOUT) glColor4f(0.0f, 0.0f, 1.0f, m_alphaOccupied);
-        drawCubes(m_occupiedThresArray, m_occupiedThresSize, m_occupiedThresColorArray);
-      }
+      if (m_colorMode != CM_PRINTOUT) glColor4f(0.0f, 0.0f, 1.0f, m_alphaOccupied);
+      drawCubes(CUBES_OCCUPIED_THRES);
 
       // draw delta occupied cells
-      if (m_occupiedSize != 0) {
-        if (m_colorMode != CM_PRINTOUT) glColor4f(0.2f, 0.7f, 1.0f, m_alphaOccupied);
-        drawCubes(m_occupiedArray, m_occupiedSize, m_occupiedColorArray);
-      }
+      if (m_colorMode != CM_PRINTOUT) glColor4f(0.2f, 0.7f, 1.0f, m_alphaOccupied);
+      drawCubes(CUBES_OCCUPIED);
     }
   }
 
@@ -725,16 +1305,12 @@ namespace octomap {
     }
 
     // draw binary freespace cells
-    if (m_freeThresSize != 0) {
-      if (m_colorMode != CM_PRINTOUT) glColor4f(0.0f, 1.0f, 0.0f, 0.3f);
-      drawCubes(m_freeThresArray, m_freeThresSize);
-    }
+    if (m_colorMode != CM_PRINTOUT) glColor4f(0.0f, 1.0f, 0.0f, 0.3f);
+    drawCubes(CUBES_FREE_THRES);
 
     // draw delta freespace cells
-    if (m_freeSize != 0) {
-      if (m_colorMode != CM_PRINTOUT) glColor4f(0.5f, 1.0f, 0.1f, 0.3f);
-      drawCubes(m_freeArray, m_freeSize);
-    }
+    if (m_colorMode != CM_PRINTOUT) glColor4f(0.5f, 1.0f, 0.1f, 0.3f);
+    drawCubes(CUBES_FREE);
   }
 
   void OcTreeDrawer::drawSelection() const {
@@ -745,53 +1321,220 @@ namespace octomap {
   }
 
   void OcTreeDrawer::drawCubes(GLfloat** cubeArray, unsigned int cubeArraySize,
-                               GLfloat* cubeColorArray) const {
+                               GLubyte* cubeColorArray) const {
     if (cubeArraySize == 0 || cubeArray == NULL){
       std::cerr << "Warning: GLfloat array to draw cubes appears to be empty, nothing drawn.\n";
       return;
     }
+    unsigned int faceArraySizes[6];
+    const GLubyte* faceColorArrays[6];
+    for (unsigned int i = 0; i < 6; ++i) {
+      faceArraySizes[i] = cubeArraySize;
+      faceColorArrays[i] = cubeColorArray;
+    }
+    drawCubeFaces(cubeArray, faceArraySizes, (cubeColorArray != NULL) ? faceColorArrays : NULL);
+  }
+
+  void OcTreeDrawer::drawCubes(CubeCategory category) const {
+    for (unsigned int i = 0; i < m_visibleChunks.size(); ++i) {
+      CubeChunk& chunk = const_cast<CubeChunk&>(*m_visibleChunks[i].first);
+      const unsigned int level = m_visibleChunks[i].second;
+      uploadCubes(chunk.levelCubes[level][category]);
+      drawCubes(chunk.levelCubes[level][category]);
+      for (unsigned int l = level; l < NUM_LOD_LEVELS; ++l) {
+        uploadCubes(chunk.sharedCubes[l][category]);
+        drawCubes(chunk.sharedCubes[l][category]);
+      }
+    }
+  }
+
+  void OcTreeDrawer::selectVisibleChunks() const {
+    m_visibleChunks.clear();
+
+    // display lists are compiled once, independent of the view
+    if (m_alternativeDrawing) {
+      for (CubeChunkMap::const_iterator it = m_chunks.begin(); it != m_chunks.end(); ++it)
+        m_visibleChunks.push_back(std::make_pair(&it->second, 0u));
+      m_visibleChunks.push_back(std::make_pair(&m_coarseChunk, 0u));
+      return;
+    }
+
+    // view frustum planes from the current (object-local) modelview and projection
+    GLdouble modelview[16], projection[16];
+    GLint viewport[4];
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    double clip[16]; // projection * modelview, column-major
+    for (unsigned int c = 0; c < 4; ++c)
+      for (unsigned int r = 0; r < 4; ++r)
+        clip[4*c+r] = projection[r] * modelview[4*c] + projection[4+r] * modelview[4*c+1]
+            + projection[8+r] * modelview[4*c+2] + projection[12+r] * modelview[4*c+3];
+
+    double planes[6][4]; // left, right, bottom, top, near, far
+    for (unsigned int p = 0; p < 6; ++p) {
+      double sign = (p % 2 == 0) ? 1.0 : -1.0;
+      for (unsigned int i = 0; i < 4; ++i)
+        planes[p][i] = clip[4*i+3] + sign * clip[4*i + p/2];
+    }
+
+    std::vector<const CubeChunk*> chunks;
+    chunks.reserve(m_chunks.size() + 1);
+    for (CubeChunkMap::const_iterator it = m_chunks.begin(); it != m_chunks.end(); ++it)
+      chunks.push_back(&it->second);
+    chunks.push_back(&m_coarseChunk);
+
+    for (unsigned int i = 0; i < chunks.size(); ++i) {
+      const CubeChunk& chunk = *chunks[i];
+
+      // cull if the bbx is completely outside one of the planes
+      bool visible = true;
+      for (unsigned int p = 0; p < 6 && visible; ++p) {
+        double dist = planes[p][3];
+        for (unsigned int j = 0; j < 3; ++j)
+          dist += planes[p][j] * ((planes[p][j] > 0) ? chunk.bbxMax(j) : chunk.bbxMin(j));
+        visible = (dist >= 0);
+      }
+      if (!visible)
+        continue;
+
+      // coarsest level whose cubes are not larger than m_lodPixelSize on screen;
+      // the coarse chunk holds the leaves above chunk depth only
+      unsigned int level = 0;
+      if (m_lodEnabled && &chunk != &m_coarseChunk) {
+        point3d center = (chunk.bbxMin + chunk.bbxMax) * 0.5;
+        double radius = (chunk.bbxMax - chunk.bbxMin).norm() * 0.5;
+        double z = modelview[2] * center.x() + modelview[6] * center.y()
+            + modelview[10] * center.z() + modelview[14];
+        // clip w of the nearest point (-z for perspective, 1 for orthographic projections)
+        double w = projection[11] * (z + radius) + projection[15];
+        if (w > 0) {
+          double pixelsPerMeter = projection[5] * viewport[3] / (2.0 * w);
+          while (level + 1 < NUM_LOD_LEVELS
+                 && m_lodLeafSize * double(2 << level) * pixelsPerMeter <= m_lodPixelSize)
+            ++level;
+        }
+      }
+      m_visibleChunks.push_back(std::make_pair(&chunk, level));
+    }
+  }
+
+  void OcTreeDrawer::adaptLevelOfDetail(double frameTime) const {
+    if (frameTime > m_frameTimeBudget)
+      m_lodPixelSize = std::min(m_lodPixelSize * 1.5, OTD_MAX_LOD_PIXEL_SIZE);
+    else if (frameTime < 0.5 * m_frameTimeBudget)
+      m_lodPixelSize = std::max(m_lodPixelSize / 1.5, 1.0);
+  }
+
+  void OcTreeDrawer::beginFrameTiming() const {
+    const TimerQueryFunctions& gl = timerQueryFunctions();
+    if (!gl.supported) {
+      // includes the time until the previous frame was shown, longer pauses are idle time
+      if (m_frameInterval.isValid()) {
+        const qint64 interval = m_frameInterval.restart();
+        if (interval < OTD_MAX_FRAME_INTERVAL)
+          adaptLevelOfDetail(double(interval));
+      }
+      else
+        m_frameInterval.start();
+      return;
+    }
+
+    if (m_frameQuery == 0)
+      gl.genQueries(1, &m_frameQuery);
+
+    // the GPU time of an earlier frame is read once it is available, frames
+    // drawn in the meantime are not measured
+    if (m_frameQueryPending) {
+      GLuint available = 0;
+      gl.getQueryObjectuiv(m_frameQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available)
+        return;
+
+      GLuint gpuTime = 0; // ns
+      gl.getQueryObjectuiv(m_frameQuery, GL_QUERY_RESULT, &gpuTime);
+      m_frameQueryPending = false;
+      adaptLevelOfDetail(std::max(gpuTime * 1e-6, m_frameQueryCpuTime));
+    }
+    gl.beginQuery(GL_TIME_ELAPSED, m_frameQuery);
+  }
+
+  void OcTreeDrawer::endFrameTiming(double cpuTime) const {
+    const TimerQueryFunctions& gl = timerQueryFunctions();
+    if (!gl.supported || m_frameQueryPending)
+      return;
+
+    gl.endQuery(GL_TIME_ELAPSED);
+    m_frameQueryPending = true;
+    m_frameQueryCpuTime = cpuTime;
+  }
+
+  void OcTreeDrawer::drawCubes(const CubeArray& cubes) const {
+    if (cubes.size == 0)
+      return;
+
+    // all faces share the colors of their cubes, surfaces have colors per face
+    unsigned int faceArraySizes[6];
+    unsigned int vertexSize = 0;
+    for (unsigned int i = 0; i < 6; ++i) {
+      faceArraySizes[i] = cubes.surface ? cubes.faceSize[i] : cubes.size;
+      vertexSize += faceArraySizes[i];
+    }
+
+    // host arrays, or offsets into the bound vertex buffer object
+    const GLfloat* faceArrays[6];
+    const GLubyte* faceColorArrays[6];
+    unsigned int offset = 0;
+    for (unsigned int i = 0; i < 6; ++i) {
+      const unsigned int colorOffset = cubes.surface ? offset / 3 * 4 : 0;
+      if (cubes.buffer == NULL) {
+        faceArrays[i] = cubes.quads[i];
+        faceColorArrays[i] = cubes.colors + colorOffset;
+      }
+      else {
+        faceArrays[i] = (const GLfloat*) (offset * sizeof(GLfloat));
+        faceColorArrays[i] = (const GLubyte*) (vertexSize * sizeof(GLfloat) + colorOffset);
+      }
+      offset += faceArraySizes[i];
+    }
+
+    if (cubes.buffer != NULL)
+      cubes.buffer->bind();
+    drawCubeFaces(faceArrays, faceArraySizes, cubes.colored ? faceColorArrays : NULL);
+    if (cubes.buffer != NULL)
+      cubes.buffer->release();
+  }
+
+  void OcTreeDrawer::drawCubeFaces(const GLfloat* const* faceArrays, const unsigned int* faceArraySizes,
+                                   const GLubyte* const* faceColorArrays) const {
+
+    // normals of the top, bottom, right, left, back and front surfaces
+    static const GLfloat normals[6][3] = {{0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+                                          {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f},
+                                          {0.0f, 0.0f, -1.0f}, {0.0f, 0.0f, 1.0f}};
 
     // save current color
     GLfloat* curcol = new GLfloat[4];
     glGetFloatv(GL_CURRENT_COLOR, curcol);
 
     // enable color pointer when heightColorMode is enabled:
-
-    if ((m_colorMode == CM_COLOR_HEIGHT || m_colorMode == CM_GRAY_HEIGHT) && (cubeColorArray != NULL)){
+    const bool useColors = (m_colorMode == CM_COLOR_HEIGHT || m_colorMode == CM_GRAY_HEIGHT)
+        && (faceColorArrays != NULL);
+    if (useColors)
       glEnableClientState(GL_COLOR_ARRAY);
-      glColorPointer(4, GL_FLOAT, 0, cubeColorArray);
-    }
-
-    // top surfaces:
-    glNormal3f(0.0f, 1.0f, 0.0f);
-    glVertexPointer(3, GL_FLOAT, 0, cubeArray[0]);
-    glDrawArrays(GL_QUADS, 0, cubeArraySize / 3);
-    // bottom surfaces:
-    glNormal3f(0.0f, -1.0f, 0.0f);
-    glVertexPointer(3, GL_FLOAT, 0, cubeArray[1]);
-    glDrawArrays(GL_QUADS, 0, cubeArraySize / 3);
-    // right surfaces:
-    glNormal3f(1.0f, 0.0f, 0.0f);
-    glVertexPointer(3, GL_FLOAT, 0, cubeArray[2]);
-    glDrawArrays(GL_QUADS, 0, cubeArraySize / 3);
-    // left surfaces:
-    glNormal3f(-1.0f, 0.0f, 0.0f);
-    glVertexPointer(3, GL_FLOAT, 0, cubeArray[3]);
-    glDrawArrays(GL_QUADS, 0, cubeArraySize / 3);
-    // back surfaces:
-    glNormal3f(0.0f, 0.0f, -1.0f);
-    glVertexPointer(3, GL_FLOAT, 0, cubeArray[4]);
-    glDrawArrays(GL_QUADS, 0, cubeArraySize / 3);
-    // front surfaces:
-    glNormal3f(0.0f, 0.0f, 1.0f);
-    glVertexPointer(3, GL_FLOAT, 0, cubeArray[5]);
-    glDrawArrays(GL_QUADS, 0, cubeArraySize / 3);
-
-    if ((m_colorMode == CM_COLOR_HEIGHT || m_colorMode == CM_GRAY_HEIGHT)
-        && (cubeColorArray != NULL)){
-      glDisableClientState(GL_COLOR_ARRAY);
+
+    for (unsigned int i = 0; i < 6; ++i) {
+      glNormal3fv(normals[i]);
+      if (useColors)
+        glColorPointer(4, GL_UNSIGNED_BYTE, 0, faceColorArrays[i]);
+      glVertexPointer(3, GL_FLOAT, 0, faceArrays[i]);
+      glDrawArrays(GL_QUADS, 0, faceArraySizes[i] / 3);
     }
 
+    if (useColors)
+      glDisableClientState(GL_COLOR_ARRAY);
+
     // draw bounding linies of cubes in printout:
     if (m_colorMode == CM_PRINTOUT){
       glDisable(GL_LIGHTING);
@@ -803,22 +1546,12 @@ namespace octomap {
       glCullFace(GL_FRONT_AND_BACK);        // Don't draw any Polygons faces
       //glDepthFunc (GL_LEQUAL);
 
-      // top meshes:
-      glNormal3f(0.0f, 1.0f, 0.0f);
-      glVertexPointer(3, GL_FLOAT, 0, cubeArray[0]);
-      glDrawArrays(GL_QUADS, 0, cubeArraySize / 3);
-      // bottom meshes:
-      glNormal3f(0.0f, -1.0f, 0.0f);
-      glVertexPointer(3, GL_FLOAT, 0, cubeArray[1]);
-      glDrawArrays(GL_QUADS, 0, cubeArraySize / 3);
-      // right meshes:
-      glNormal3f(1.0f, 0.0f, 0.0f);
-      glVertexPointer(3, GL_FLOAT, 0, cubeArray[2]);
-      glDrawArrays(GL_QUADS, 0, cubeArraySize / 3);
-      // left meshes:
-      glNormal3f(-1.0f, 0.0f, 0.0f);
-      glVertexPointer(3, GL_FLOAT, 0, cubeArray[3]);
-      glDrawArrays(GL_QUADS, 0, cubeArraySize / 3);
+      // top, bottom, right and left meshes:
+      for (unsigned int i = 0; i < 4; ++i) {
+        glNormal3fv(normals[i]);
+        glVertexPointer(3, GL_FLOAT, 0, faceArrays[i]);
+        glDrawArrays(GL_QUADS, 0, faceArraySizes[i] / 3);
+      }
 
       // restore defaults:
       glCullFace(GL_BACK);
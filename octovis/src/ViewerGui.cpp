@@ -44,6 +44,8 @@ ViewerGui::ViewerGui(const std::string& filename, QWidget *parent, unsigned int
   m_max_tree_depth(initDepth > 0 && initDepth <= 16 ? initDepth : 16), 
   m_laserType(LASERTYPE_SICK),
   m_cameraStored(false),
+  m_loadCompleteGraph(true), m_resetViewAfterJob(false),
+  m_showOcTreePending(false), m_showOcTreePendingIncremental(false),
   m_filename("") 
 {
 
@@ -58,6 +60,7 @@ ViewerGui::ViewerGui(const std::string& filename, QWidget *parent, unsigned int
   settingsDock->setWidget(settingsPanel);
   this->addDockWidget(Qt::RightDockWidgetArea, settingsDock);
   ui.menuShow->addAction(settingsDock->toggleViewAction());
+  m_settingsDock = settingsDock;
 
   // Camera settings panel at the right side
   ViewerSettingsPanelCamera* settingsCameraPanel = new ViewerSettingsPanelCamera(this);
@@ -67,6 +70,7 @@ ViewerGui::ViewerGui(const std::string& filename, QWidget *parent, unsigned int
   this->tabifyDockWidget(settingsDock, settingsCameraDock);
   settingsDock->raise();
   ui.menuShow->addAction(settingsCameraDock->toggleViewAction());
+  m_settingsCameraDock = settingsCameraDock;
 
   // status bar
   m_mapSizeStatus = new QLabel("Map size", this);
@@ -75,9 +79,19 @@ ViewerGui::ViewerGui(const std::string& filename, QWidget *parent, unsigned int
   m_mapMemoryStatus->setFrameStyle(QFrame::Panel | QFrame::Sunken);
   statusBar()->addPermanentWidget(m_mapSizeStatus);
   statusBar()->addPermanentWidget(m_mapMemoryStatus);
+  m_jobProgressBar = new QProgressBar(this);
+  m_jobProgressBar->setMaximumWidth(200);
+  m_jobProgressBar->hide();
+  statusBar()->addPermanentWidget(m_jobProgressBar);
 
   m_cameraFollowMode = new CameraFollowMode();
 
+  // loading and cube generation run in the background
+  m_worker = new ViewerWorker(this);
+  connect(m_worker, SIGNAL(progress(QString, int, int)), this, SLOT(showJobProgress(QString, int, int)));
+  connect(m_worker, SIGNAL(finished()), this, SLOT(jobFinished()));
+  connect(m_worker, SIGNAL(failed(QString)), this, SLOT(jobFailed(QString)));
+
   connect(this, SIGNAL(updateStatusBar(QString, int)), statusBar(), SLOT(showMessage(QString, int)));
 
   connect(settingsPanel, SIGNAL(treeDepthChanged(int)), this, SLOT(changeTreeDepth(int)));
@@ -129,6 +143,9 @@ ViewerGui::ViewerGui(const std::string& filename, QWidget *parent, unsigned int
 }
 
 ViewerGui::~ViewerGui() {
+  // the running job may use the trees and drawers
+  m_worker->wait();
+
   if (m_trajectoryDrawer){
     m_glwidget->removeSceneObject(m_trajectoryDrawer);
     delete m_trajectoryDrawer;
@@ -231,7 +248,103 @@ void ViewerGui::addOctree(octomap::AbstractOcTree* tree, int id) {
   addOctree(tree, id, o);
 }
 
-void ViewerGui::showOcTree() {
+void ViewerGui::showOcTree(bool incremental) {
+  if (m_worker->isRunning()) {
+    // update once more after the running job
+    m_showOcTreePendingIncremental = incremental && (m_showOcTreePendingIncremental || !m_showOcTreePending);
+    m_showOcTreePending = true;
+    return;
+  }
+  startJob(incremental);
+}
+
+void ViewerGui::startJob(bool incremental) {
+  // generate cubes in the background, the drawers show the previous ones meanwhile
+  for (std::map<int, OcTreeRecord>::iterator it = m_octrees.begin(); it != m_octrees.end(); ++it) {
+    it->second.octree_drawer->setMax_tree_depth(m_max_tree_depth);
+    it->second.octree_drawer->enableSurfaceExtraction(ui.actionSurface_extraction->isChecked());
+    m_worker->addDrawer(it->second.octree_drawer, it->second.octree, it->second.origin, it->second.id,
+                        incremental);
+  }
+  setJobRunning(true);
+  m_worker->start();
+}
+
+void ViewerGui::setJobRunning(bool running) {
+  // the 3D view stays interactive
+  menuBar()->setEnabled(!running);
+  m_settingsDock->setEnabled(!running);
+  m_settingsCameraDock->setEnabled(!running);
+
+  if (running) {
+    QApplication::setOverrideCursor(Qt::BusyCursor);
+  } else {
+    QApplication::restoreOverrideCursor();
+    m_jobProgressBar->hide();
+  }
+}
+
+void ViewerGui::showJobProgress(QString message, int done, int total) {
+  m_jobProgressBar->setMaximum(total); // busy indicator if 0
+  m_jobProgressBar->setValue(done);
+  m_jobProgressBar->show();
+  emit updateStatusBar(message, 0);
+}
+
+void ViewerGui::jobFinished() {
+  // finished() is emitted right before the thread ends
+  m_worker->wait();
+
+  ViewerWorker::Task task = m_worker->getTask();
+  AbstractOcTree* tree = m_worker->takeTree();
+  ScanGraph* scanGraph = m_worker->takeScanGraph();
+  m_worker->clearJob();
+  setJobRunning(false);
+
+  // show the new cubes, changes are now reflected in the drawers
+  m_glwidget->makeCurrent();
+  for (std::map<int, OcTreeRecord>::iterator it = m_octrees.begin(); it != m_octrees.end(); ++it) {
+    it->second.octree_drawer->swapBuffers();
+
+    if (dynamic_cast<OcTree*>(it->second.octree))
+      ((OcTree*) it->second.octree)->resetChangeDetection();
+    else if (dynamic_cast<ColorOcTree*>(it->second.octree))
+      ((ColorOcTree*) it->second.octree)->resetChangeDetection();
+  }
+  updateMapStatistics();
+  if (m_resetViewAfterJob) {
+    m_resetViewAfterJob = false;
+    m_glwidget->resetView();
+  }
+  m_glwidget->updateGL();
+
+  if (task == ViewerWorker::TASK_READ_TREE) {
+    showLoadedOcTree(tree);
+  }
+  else if (task == ViewerWorker::TASK_READ_SCAN_GRAPH) {
+    // the current graph is kept if reading failed
+    if (scanGraph) {
+      if (m_scanGraph) delete m_scanGraph;
+      m_scanGraph = scanGraph;
+      loadGraph(m_loadCompleteGraph);
+    }
+  }
+  else if (task == ViewerWorker::TASK_INSERT_SCANS) {
+    showInfo("Done.", true);
+  }
+
+  if (m_showOcTreePending && !m_worker->isRunning()) {
+    m_showOcTreePending = false;
+    showOcTree(m_showOcTreePendingIncremental);
+  }
+}
+
+void ViewerGui::jobFailed(QString message) {
+  showInfo(message, true);
+  QMessageBox::warning(this, "File error", message, QMessageBox::Ok);
+}
+
+void ViewerGui::updateMapStatistics() {
 
   // update viewer stat
   double minX, minY, minZ, maxX, maxY, maxZ;
@@ -243,7 +356,6 @@ void ViewerGui::showOcTree() {
   size_t num_nodes = 0;
   size_t memorySingleNode = 0;
 
-
   for (std::map<int, OcTreeRecord>::iterator it = m_octrees.begin(); it != m_octrees.end(); ++it) {
     // get map bbx
     double lminX, lminY, lminZ, lmaxX, lmaxY, lmaxZ;
@@ -284,20 +396,6 @@ void ViewerGui::showOcTree() {
   m_mapSizeStatus->setText(size);
   //}
 
-  m_glwidget->updateGL();
-
-  // generate cubes -> display
-  // timeval start;
-  // timeval stop;
-  // gettimeofday(&start, NULL);  // start timer
-  for (std::map<int, OcTreeRecord>::iterator it = m_octrees.begin(); it != m_octrees.end(); ++it) {
-    it->second.octree_drawer->setMax_tree_depth(m_max_tree_depth);
-    it->second.octree_drawer->setOcTree(*it->second.octree, it->second.origin, it->second.id);
-  }
-  //    gettimeofday(&stop, NULL);  // stop timer
-  //    double time_to_generate = (stop.tv_sec - start.tv_sec) + 1.0e-6 *(stop.tv_usec - start.tv_usec);
-  //    fprintf(stderr, "setOcTree took %f sec\n", time_to_generate);
-  m_glwidget->updateGL();
 }
 
 
@@ -305,31 +403,15 @@ void ViewerGui::generateOctree() {
 
   if (m_scanGraph) {
 
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-
     showInfo("Generating OcTree... ");
     std::cerr << std::endl;
 
-    //if (m_ocTree) delete m_ocTree;
+    // the previous tree remains visible until the new one is inserted and drawn
     OcTree* tree = new octomap::OcTree(m_octreeResolution);
-
-    octomap::ScanGraph::iterator it;
-    unsigned numScans = m_scanGraph->size();
-    unsigned currentScan = 1;
-    for (it = m_scanGraph->begin(); it != m_nextScanToAdd; it++) {
-      tree->insertPointCloud(**it, m_laserMaxRange);
-      fprintf(stderr, "generateOctree:: inserting scan node with %d points, origin: %.2f  ,%.2f , %.2f.\n",
-              (unsigned int) (*it)->scan->size(), (*it)->pose.x(), (*it)->pose.y(), (*it)->pose.z()  );
-
-      std::cout << " S ("<<currentScan<<"/"<<numScans<<") " << std::flush;
-      currentScan++;
-    }
-
     this->addOctree(tree, DEFAULT_OCTREE_ID);
-    this->showOcTree();
 
-    showInfo("Done.", true);
-    QApplication::restoreOverrideCursor();
+    m_worker->insertScans(tree, m_scanGraph->begin(), m_nextScanToAdd, m_laserMaxRange);
+    startJob(false);
   }
   else {
     std::cerr << "generateOctree called but no ScanGraph present!\n";
@@ -340,51 +422,40 @@ void ViewerGui::generateOctree() {
 // ==  incremental graph generation   =======================
 
 void ViewerGui::gotoFirstScan(){
-  if (m_scanGraph){
+  if (m_scanGraph && !m_worker->isRunning()){
     showInfo("Inserting first scan node into tree... ", true);
-    QApplication::setOverrideCursor(Qt::WaitCursor);
 
     m_nextScanToAdd = m_scanGraph->begin();
 
     // if (m_ocTree) delete m_ocTree;
     // m_ocTree = new octomap::OcTree(m_octreeResolution);
     OcTree* tree = new octomap::OcTree(m_octreeResolution);
+    // track changes so that the drawer only regenerates modified subtrees
+    tree->enableChangeDetection(true);
     this->addOctree(tree, DEFAULT_OCTREE_ID);
 
-    addNextScan();
-
-    QApplication::restoreOverrideCursor();
-    showOcTree();
+    addNextScans(1);
   }
 }
 
-void ViewerGui::addNextScan(){
+void ViewerGui::addNextScans(unsigned scans){
 
-  if (m_scanGraph){
-    showInfo("Inserting next scan node into tree... ", true);
+  if (m_scanGraph && !m_worker->isRunning()){
+    showInfo("Inserting next scan nodes into tree... ", true);
 
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-    if (m_nextScanToAdd != m_scanGraph->end()){
-      OcTreeRecord* r;
-      if (!getOctreeRecord(DEFAULT_OCTREE_ID, r)) {
-        fprintf(stderr, "ERROR: OctreeRecord for id %d not found!\n", DEFAULT_OCTREE_ID);
-        return;
-      }
-      // not used with ColorOcTrees, omitting casts
-      ((OcTree*) r->octree)->insertPointCloud(**m_nextScanToAdd, m_laserMaxRange);
-      m_nextScanToAdd++;
+    OcTreeRecord* r;
+    if (!getOctreeRecord(DEFAULT_OCTREE_ID, r)) {
+      fprintf(stderr, "ERROR: OctreeRecord for id %d not found!\n", DEFAULT_OCTREE_ID);
+      return;
     }
 
-    QApplication::restoreOverrideCursor();
-    showOcTree();
-
-  }
-}
-
+    ScanGraph::iterator begin = m_nextScanToAdd;
+    for (unsigned i = 0; i < scans && m_nextScanToAdd != m_scanGraph->end(); ++i)
+      m_nextScanToAdd++;
 
-void ViewerGui::addNextScans(unsigned scans){
-  for (unsigned i = 0; i < scans; ++i){
-    addNextScan();
+    // not used with ColorOcTrees, omitting casts
+    m_worker->insertScans((OcTree*) r->octree, begin, m_nextScanToAdd, m_laserMaxRange);
+    startJob(true);
   }
 }
 
@@ -398,13 +469,9 @@ void ViewerGui::openFile(){
     QString temp = QString(m_filename.c_str());
     QFileInfo fileinfo(temp);
     this->setWindowTitle(fileinfo.fileName());
-    if (fileinfo.suffix() == "graph"){
+    if (fileinfo.suffix() == "graph" || fileinfo.suffix() == "igraph"){
       openGraph();
-    }else if (fileinfo.suffix() == "bt"){
-      openTree();
-    }
-    else if (fileinfo.suffix() == "ot")
-    {
+    }else if (fileinfo.suffix() == "bt" || fileinfo.suffix() == "ot"){
       openOcTree();
     }
     else if (fileinfo.suffix() == "hot"){
@@ -422,20 +489,18 @@ void ViewerGui::openFile(){
 
 void ViewerGui::openGraph(bool completeGraph){
 
-  QApplication::setOverrideCursor(Qt::WaitCursor);
   showInfo("Loading scan graph from file " + QString(m_filename.c_str()) );
 
-  if (m_scanGraph) delete m_scanGraph;
-  m_scanGraph = new octomap::ScanGraph();
-  m_scanGraph->readBinary(m_filename);
-
-  loadGraph(completeGraph);
+  // continued in loadGraph() when the graph is read
+  m_loadCompleteGraph = completeGraph;
+  m_worker->readScanGraph(m_filename);
+  setJobRunning(true);
+  m_worker->start();
 }
 
 
 void ViewerGui::openPointcloud(){
 
-  QApplication::setOverrideCursor(Qt::WaitCursor);
   showInfo("Loading ASCII pointcloud from file "+QString(m_filename.c_str()) + "...");
 
   if (m_scanGraph) delete m_scanGraph;
@@ -476,20 +541,14 @@ void ViewerGui::setOcTreeUISwitches() {
   ui.actionSettings->setEnabled(false);
 }
 
-void ViewerGui::openTree(){
-  OcTree* tree = new octomap::OcTree(m_filename);
-  this->addOctree(tree, DEFAULT_OCTREE_ID);
-
-  m_octreeResolution = tree->getResolution();
-  emit changeResolution(m_octreeResolution);
-
-  setOcTreeUISwitches();
-  showOcTree();
-  m_glwidget->resetView();
+void ViewerGui::openOcTree(){
+  // continued in showLoadedOcTree() when the tree is read
+  m_worker->readTree(m_filename);
+  setJobRunning(true);
+  m_worker->start();
 }
 
-void ViewerGui::openOcTree(){
-  AbstractOcTree* tree = AbstractOcTree::read(m_filename);
+void ViewerGui::showLoadedOcTree(AbstractOcTree* tree){
 
   if (tree){
     this->addOctree(tree, DEFAULT_OCTREE_ID);
@@ -498,8 +557,6 @@ void ViewerGui::openOcTree(){
     emit changeResolution(m_octreeResolution);
 
     setOcTreeUISwitches();
-    showOcTree();
-    m_glwidget->resetView();
 
     if (tree->getTreeType() == "ColorOcTree"){
       // map color and height map share the same color array and QAction
@@ -507,6 +564,10 @@ void ViewerGui::openOcTree(){
       this->on_actionHeight_map_toggled(true); // enable color view
       ui.actionHeight_map->setChecked(true);
     }
+
+    // the color mode is set before the cubes are generated
+    m_resetViewAfterJob = true;
+    showOcTree();
   }
   else {
     QMessageBox::warning(this, "File error", "Cannot open OcTree file", QMessageBox::Ok);
@@ -542,8 +603,8 @@ void ViewerGui::openMapCollection() {
     ++i;
   }
   setOcTreeUISwitches();
+  m_resetViewAfterJob = true;
   showOcTree();
-  m_glwidget->resetView();
   OCTOMAP_DEBUG("done\n");
 }
 
@@ -577,15 +638,17 @@ void ViewerGui::loadGraph(bool completeGraph) {
     //if (m_ocTree) delete m_ocTree;
     //m_ocTree = new octomap::OcTree(m_octreeResolution);
     OcTree* tree = new octomap::OcTree(m_octreeResolution);
+    // track changes so that the drawer only regenerates modified subtrees
+    tree->enableChangeDetection(true);
     this->addOctree(tree, DEFAULT_OCTREE_ID);
 
-    addNextScan();
+    addNextScans(1);
 
     currentScan = 1;
   }
 
-  m_glwidget->resetView();
-  QApplication::restoreOverrideCursor();
+  // after the scans are inserted
+  m_resetViewAfterJob = true;
 
   emit changeNumberOfScans(graphSize);
   emit changeCurrentScan(currentScan);
@@ -667,7 +730,7 @@ void ViewerGui::on_actionSettings_triggered(){
 void ViewerGui::on_actionOpen_file_triggered(){
   QString filename = QFileDialog::getOpenFileName(this,
                                                   tr("Open data file"), "",
-                                                  "All supported files (*.graph *.bt *.ot *.dat);;OcTree file (*.ot);;Bonsai tree file (*.bt);;Binary scan graph (*.graph);;Pointcloud (*.dat);;All files (*)");
+                                                  "All supported files (*.graph *.igraph *.bt *.ot *.dat);;OcTree file (*.ot);;Bonsai tree file (*.bt);;Binary scan graph (*.graph *.igraph);;Pointcloud (*.dat);;All files (*)");
   if (!filename.isEmpty()){
 #ifdef _WIN32      
     m_filename = std::string(filename.toLocal8Bit().data());
@@ -682,7 +745,7 @@ void ViewerGui::on_actionOpen_file_triggered(){
 void ViewerGui::on_actionOpen_graph_incremental_triggered(){
   QString filename = QFileDialog::getOpenFileName(this,
                                                   tr("Open graph file incrementally (at start)"), "",
-                                                  "Binary scan graph (*.graph)");
+                                                  "Binary scan graph (*.graph *.igraph)");
   if (!filename.isEmpty()){
     m_glwidget->clearAll();
 
@@ -1057,6 +1120,12 @@ void ViewerGui::on_actionAlternateRendering_toggled(bool checked) {
   }
 }
 
+void ViewerGui::on_actionSurface_extraction_toggled(bool /*checked*/) {
+  // the drawers switch modes when the cubes are regenerated
+  if (m_octrees.size() > 0)
+    showOcTree();
+}
+
 void ViewerGui::on_actionClear_triggered() {
   for (std::map<int, OcTreeRecord>::iterator it = m_octrees.begin();
       it != m_octrees.end(); ++it) {
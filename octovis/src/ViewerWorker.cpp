@@ -0,0 +1,149 @@
+/*
+ * This file is part of OctoMap - An Efficient Probabilistic 3D Mapping
+ * Framework Based on Octrees
+ * http://octomap.github.io
+ *
+ * Copyright (c) 2009-2014, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved. License for the viewer octovis: GNU GPL v2
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ */
+
+#include <octovis/ViewerWorker.h>
+#include <octomap/IndexedScanGraph.h>
+#include <cstdio>
+#include <iterator>
+
+namespace octomap {
+
+  ViewerWorker::ViewerWorker(QObject* parent)
+    : QThread(parent), m_task(TASK_NONE), m_insertTree(NULL), m_maxrange(-1.),
+      m_tree(NULL), m_scanGraph(NULL) {
+  }
+
+  ViewerWorker::~ViewerWorker() {
+    wait();
+    clearJob();
+  }
+
+  void ViewerWorker::readTree(const std::string& filename) {
+    m_task = TASK_READ_TREE;
+    m_filename = filename;
+  }
+
+  void ViewerWorker::readScanGraph(const std::string& filename) {
+    m_task = TASK_READ_SCAN_GRAPH;
+    m_filename = filename;
+  }
+
+  void ViewerWorker::insertScans(OcTree* tree, ScanGraph::iterator begin, ScanGraph::iterator end,
+                                 double maxrange) {
+    m_task = TASK_INSERT_SCANS;
+    m_insertTree = tree;
+    m_scansBegin = begin;
+    m_scansEnd = end;
+    m_maxrange = maxrange;
+  }
+
+  void ViewerWorker::addDrawer(OcTreeDrawer* drawer, const AbstractOcTree* tree,
+                               const pose6d& origin, int id, bool incremental) {
+    DrawerJob job;
+    job.drawer = drawer;
+    job.tree = tree;
+    job.origin = origin;
+    job.id = id;
+    job.incremental = incremental;
+    m_drawerJobs.push_back(job);
+  }
+
+  AbstractOcTree* ViewerWorker::takeTree() {
+    AbstractOcTree* tree = m_tree;
+    m_tree = NULL;
+    return tree;
+  }
+
+  ScanGraph* ViewerWorker::takeScanGraph() {
+    ScanGraph* graph = m_scanGraph;
+    m_scanGraph = NULL;
+    return graph;
+  }
+
+  void ViewerWorker::clearJob() {
+    delete m_tree;
+    m_tree = NULL;
+    delete m_scanGraph;
+    m_scanGraph = NULL;
+
+    m_task = TASK_NONE;
+    m_filename.clear();
+    m_insertTree = NULL;
+    m_drawerJobs.clear();
+  }
+
+  void ViewerWorker::run() {
+
+    switch (m_task) {
+    case TASK_READ_TREE:
+      emit progress("Loading octree from file " + QString(m_filename.c_str()) + "...", 0, 0);
+      if (m_filename.length() > 3 && m_filename.compare(m_filename.length() - 3, 3, ".bt") == 0)
+        m_tree = new OcTree(m_filename);
+      else
+        m_tree = AbstractOcTree::read(m_filename);
+      break;
+
+    case TASK_READ_SCAN_GRAPH: {
+      emit progress("Loading scan graph from file " + QString(m_filename.c_str()) + "...", 0, 0);
+      // reads regular and indexed graph files
+      IndexedScanGraph indexedGraph;
+      m_scanGraph = new ScanGraph();
+      if (!indexedGraph.open(m_filename) || !indexedGraph.readScanGraph(*m_scanGraph)) {
+        delete m_scanGraph;
+        m_scanGraph = NULL;
+        emit failed("Cannot read scan graph file " + QString(m_filename.c_str()));
+      }
+      break;
+    }
+
+    case TASK_INSERT_SCANS: {
+      int numScans = (int) std::distance(m_scansBegin, m_scansEnd);
+      int currentScan = 0;
+      for (ScanGraph::iterator it = m_scansBegin; it != m_scansEnd; ++it) {
+        emit progress(QString("Inserting scan %1 of %2...").arg(currentScan + 1).arg(numScans),
+                      currentScan, numScans);
+        m_insertTree->insertPointCloud(**it, m_maxrange);
+        fprintf(stderr, "ViewerWorker:: inserted scan node with %d points, origin: %.2f  ,%.2f , %.2f.\n",
+                (unsigned int) (*it)->scan->size(), (*it)->pose.x(), (*it)->pose.y(), (*it)->pose.z()  );
+        currentScan++;
+      }
+      break;
+    }
+
+    default:
+      break;
+    }
+
+    // the drawn cubes are only replaced when the GUI thread swaps the buffers
+    for (unsigned int i = 0; i < m_drawerJobs.size(); ++i) {
+      emit progress("Generating cubes...", i, m_drawerJobs.size());
+      const DrawerJob& job = m_drawerJobs[i];
+      if (job.incremental)
+        job.drawer->prepareOcTreeUpdate(*job.tree);
+      else
+        job.drawer->prepareOcTree(*job.tree, job.origin, job.id);
+    }
+  }
+
+} // namespace
@@ -0,0 +1,371 @@
+/*
+ * This file is part of OctoMap - An Efficient Probabilistic 3D Mapping
+ * Framework Based on Octrees
+ * http://octomap.github.io
+ *
+ * Copyright (c) 2009-2014, K.M. Wurm and A. Hornung, University of Freiburg
+ * All rights reserved. License for the viewer octovis: GNU GPL v2
+ * http://www.gnu.org/licenses/old-licenses/gpl-2.0.txt
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see http://www.gnu.org/licenses/.
+ */
+
+// Headless rendering of octrees into image files with the drawers of the viewer:
+// the OpenGL context is created with EGL, no X server or window is needed.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <octovis/OcTreeDrawer.h>
+#include <octovis/ColorOcTreeDrawer.h>
+#include <QImage>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <vector>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+using namespace std;
+using namespace octomap;
+
+void printUsage(char* self){
+  std::cerr << "\nUSAGE: " << self << " -i <InputFile.bt/.ot> [OPTIONS]\n\n";
+
+  std::cerr << "This tool renders an octree from the given camera poses into image files,\n"
+      "like the viewer octovis does but without a display (OpenGL context by EGL).\n"
+      "Each line of the pose file holds one camera pose 'x y z roll pitch yaw'\n"
+      "(meters and radians, in the map frame). The camera looks along its x axis\n"
+      "with z pointing up. Without a pose file, one overview of the map is rendered.\n\n";
+
+  std::cerr << "OPTIONS:\n"
+      "  -p <PoseFile> (camera poses, one per line)\n"
+      "  -o <OutputPattern> (image files by pose number, one %d or %0<width>d, default: view_%04d.png)\n"
+      "  -size <width> <height> (image size in pixels, default: 800 600)\n"
+      "  -fov <degrees> (vertical field of view, default: 45)\n"
+      "  -depth <depth> (maximum tree depth drawn, 1..16)\n"
+      "  -mode <height|gray|flat|printout> (color mode, default: height; ColorOcTrees use their colors with height)\n"
+      "  -free (also draw free voxels)\n"
+      "  -surfaces (draw only exposed faces of occupied voxels, see OcTreeDrawer::enableSurfaceExtraction)\n"
+      "  -alpha <alpha> (opacity of occupied voxels, default: 0.8)\n"
+      "\n";
+
+  exit(0);
+}
+
+/// splits an output pattern with exactly one integer conversion (%d, optionally with
+/// width and zero padding, e.g. %04d) into the text before and after it, "%%" is a
+/// literal '%'. \return false for other patterns
+bool parseOutputPattern(const string& pattern, string& prefix, string& suffix, int& width, char& fill){
+  bool found = false;
+  width = 0;
+  fill = ' ';
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    string& text = found ? suffix : prefix;
+    if (pattern[i] != '%') {
+      text += pattern[i];
+      continue;
+    }
+    if (++i < pattern.size() && pattern[i] == '%') {
+      text += '%';
+      continue;
+    }
+    if (found)
+      return false;
+    if (i < pattern.size() && pattern[i] == '0') {
+      fill = '0';
+      ++i;
+    }
+    for (; i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9'; ++i)
+      width = 10 * width + (pattern[i] - '0');
+    if (i >= pattern.size() || pattern[i] != 'd' || width > 64)
+      return false;
+    found = true;
+  }
+  return found;
+}
+
+/// creates an OpenGL context for offscreen rendering into a pbuffer of the given size
+bool createContext(int width, int height){
+  // devices without display server (e.g. Mesa's surfaceless platform) if there is no default display
+  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay == NULL)
+      return false;
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+      return false;
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API))
+    return false;
+
+  const EGLint configAttributes[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+    EGL_DEPTH_SIZE, 24,
+    EGL_NONE
+  };
+  EGLConfig config;
+  EGLint numConfigs = 0;
+  if (!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) || numConfigs < 1)
+    return false;
+
+  const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+  EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+  EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+  if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT)
+    return false;
+
+  return eglMakeCurrent(display, surface, surface, context);
+}
+
+/// loads the OpenGL view matrix of a camera at pose (looking along x, z up)
+void loadCameraPose(const pose6d& pose){
+  // camera axes in OpenGL: x right (= -y), y up (= z), z backwards (= -x)
+  const pose6d view = pose.inv();
+  point3d axes[3];
+  axes[0] = view.rot().rotate(point3d(1, 0, 0));
+  axes[1] = view.rot().rotate(point3d(0, 1, 0));
+  axes[2] = view.rot().rotate(point3d(0, 0, 1));
+  const point3d& t = view.trans();
+
+  GLdouble m[16]; // column-major
+  for (unsigned int c = 0; c < 3; ++c) {
+    m[4*c]     = -axes[c].y();
+    m[4*c + 1] =  axes[c].z();
+    m[4*c + 2] = -axes[c].x();
+    m[4*c + 3] = 0.0;
+  }
+  m[12] = -t.y();
+  m[13] =  t.z();
+  m[14] = -t.x();
+  m[15] = 1.0;
+
+  glMatrixMode(GL_MODELVIEW);
+  glLoadMatrixd(m);
+}
+
+/// renders the drawer from pose and reads back the image
+void render(const OcTreeDrawer& drawer, const pose6d& pose, int width, int height, double fov,
+            double zNear, double zFar, QImage& image){
+  glViewport(0, 0, width, height);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  gluPerspective(fov, double(width) / double(height), zNear, zFar);
+  loadCameraPose(pose);
+
+  // same state as in the viewer (ViewerWidget::draw())
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glEnable(GL_LIGHTING);
+  drawer.draw();
+  glFinish();
+
+  image = QImage(width, height, QImage::Format_RGB888);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  // OpenGL rows start at the bottom
+  std::vector<unsigned char> pixels(width * height * 3);
+  glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+  for (int y = 0; y < height; ++y)
+    memcpy(image.scanLine(height - 1 - y), &pixels[y * width * 3], width * 3);
+}
+
+int main(int argc, char** argv) {
+  // default values:
+  string inputFilename = "";
+  string poseFilename = "";
+  string outputPattern = "view_%04d.png";
+  int width = 800;
+  int height = 600;
+  double fov = 45.0;
+  int depth = 16;
+  SceneObject::ColorMode colorMode = SceneObject::CM_COLOR_HEIGHT;
+  bool drawFree = false;
+  bool surfaces = false;
+  double alpha = 0.8;
+
+  int arg = 0;
+  while (++arg < argc) {
+    if (! strcmp(argv[arg], "-i") && argc-arg > 1)
+      inputFilename = std::string(argv[++arg]);
+    else if (! strcmp(argv[arg], "-p") && argc-arg > 1)
+      poseFilename = std::string(argv[++arg]);
+    else if (! strcmp(argv[arg], "-o") && argc-arg > 1)
+      outputPattern = std::string(argv[++arg]);
+    else if (! strcmp(argv[arg], "-size") && argc-arg > 2) {
+      width = atoi(argv[++arg]);
+      height = atoi(argv[++arg]);
+    }
+    else if (! strcmp(argv[arg], "-fov") && argc-arg > 1)
+      fov = atof(argv[++arg]);
+    else if (! strcmp(argv[arg], "-depth") && argc-arg > 1)
+      depth = atoi(argv[++arg]);
+    else if (! strcmp(argv[arg], "-mode") && argc-arg > 1) {
+      std::string mode(argv[++arg]);
+      if (mode == "height")
+        colorMode = SceneObject::CM_COLOR_HEIGHT;
+      else if (mode == "gray")
+        colorMode = SceneObject::CM_GRAY_HEIGHT;
+      else if (mode == "flat")
+        colorMode = SceneObject::CM_FLAT;
+      else if (mode == "printout")
+        colorMode = SceneObject::CM_PRINTOUT;
+      else
+        printUsage(argv[0]);
+    }
+    else if (! strcmp(argv[arg], "-free"))
+      drawFree = true;
+    else if (! strcmp(argv[arg], "-surfaces"))
+      surfaces = true;
+    else if (! strcmp(argv[arg], "-alpha") && argc-arg > 1)
+      alpha = atof(argv[++arg]);
+    else
+      printUsage(argv[0]);
+  }
+
+  if (inputFilename == "")
+    printUsage(argv[0]);
+
+  // verify input:
+  if (width <= 0 || height <= 0 || fov <= 0.0 || fov >= 180.0) {
+    OCTOMAP_ERROR("Invalid image size or field of view\n");
+    exit(1);
+  }
+  if (depth < 1 || depth > 16) {
+    OCTOMAP_ERROR("Tree depth must be between 1 and 16\n");
+    exit(1);
+  }
+  string outputPrefix, outputSuffix;
+  int outputWidth;
+  char outputFill;
+  if (!parseOutputPattern(outputPattern, outputPrefix, outputSuffix, outputWidth, outputFill)) {
+    OCTOMAP_ERROR("Output pattern must contain exactly one %%d conversion (e.g. view_%%04d.png)\n");
+    exit(1);
+  }
+
+  AbstractOcTree* tree = NULL;
+  if (inputFilename.length() > 3 && inputFilename.compare(inputFilename.length() - 3, 3, ".bt") == 0) {
+    OcTree* bt = new OcTree(0.1);
+    if (bt->readBinary(inputFilename))
+      tree = bt;
+    else
+      delete bt;
+  }
+  else
+    tree = AbstractOcTree::read(inputFilename);
+
+  if (!tree) {
+    OCTOMAP_ERROR("Could not read octree from file %s\n", inputFilename.c_str());
+    exit(1);
+  }
+
+  OcTreeDrawer* drawer = NULL;
+  if (tree->getTreeType() == "ColorOcTree")
+    drawer = new ColorOcTreeDrawer();
+  else if (dynamic_cast<OcTree*>(tree))
+    drawer = new OcTreeDrawer();
+  else {
+    OCTOMAP_ERROR("Octree of type %s can not be drawn\n", tree->getTreeType().c_str());
+    exit(1);
+  }
+
+  // map extent for the overview and the clipping planes
+  double minX, minY, minZ, maxX, maxY, maxZ;
+  tree->getMetricMin(minX, minY, minZ);
+  tree->getMetricMax(maxX, maxY, maxZ);
+  const point3d center((minX + maxX) / 2.0, (minY + maxY) / 2.0, (minZ + maxZ) / 2.0);
+  const double radius = std::max(0.5 * point3d(maxX - minX, maxY - minY, maxZ - minZ).norm(), 1.0);
+
+  std::vector<pose6d> poses;
+  if (poseFilename != "") {
+    std::ifstream poseFile(poseFilename.c_str());
+    if (!poseFile.is_open()) {
+      OCTOMAP_ERROR("Could not open pose file %s\n", poseFilename.c_str());
+      exit(1);
+    }
+    std::string line;
+    while (std::getline(poseFile, line)) {
+      std::istringstream s(line);
+      double x, y, z, roll, pitch, yaw;
+      if (s >> x >> y >> z >> roll >> pitch >> yaw)
+        poses.push_back(pose6d(x, y, z, roll, pitch, yaw));
+    }
+  }
+  else {
+    // looking down at the map center from a distance fitting the map into the view
+    const double pitch = M_PI / 6.0, yaw = M_PI / 4.0;
+    const double distance = radius / sin(fov * M_PI / 360.0);
+    const point3d eye = center + point3d(-cos(pitch) * cos(yaw), -cos(pitch) * sin(yaw), sin(pitch)) * distance;
+    poses.push_back(pose6d(eye.x(), eye.y(), eye.z(), 0.0, pitch, yaw));
+  }
+
+  if (!createContext(width, height)) {
+    OCTOMAP_ERROR("Could not create an OpenGL context with EGL\n");
+    exit(1);
+  }
+
+  // same lighting and background as in the viewer (ViewerWidget::init())
+  glEnable(GL_LIGHT0);
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_COLOR_MATERIAL);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+  float lightPos[4] = {-1.0, 1.0, 1.0, 0.0};
+  glLightfv(GL_LIGHT0, GL_POSITION, lightPos);
+  glClearColor(1.0, 1.0, 1.0, 1.0);
+
+  // views are rendered independently of frame times
+  drawer->enableLevelOfDetail(false);
+  drawer->setColorMode(colorMode);
+  drawer->setAlphaOccupied(alpha);
+  drawer->enableFreespace(drawFree);
+  drawer->enableSurfaceExtraction(surfaces);
+  drawer->setMax_tree_depth(depth);
+  drawer->setOcTree(*tree);
+
+  cout << "Rendering " << poses.size() << " views of " << inputFilename << endl;
+  QImage image;
+  for (unsigned int i = 0; i < poses.size(); ++i) {
+    // clipping planes enclosing the map
+    const double distance = (poses[i].trans() - center).norm();
+    const double zFar = distance + radius;
+    const double zNear = std::max(distance - radius, zFar * 1e-4);
+
+    render(*drawer, poses[i], width, height, fov, zNear, zFar, image);
+
+    std::ostringstream filename;
+    filename << outputPrefix << std::setfill(outputFill) << std::setw(outputWidth) << i << outputSuffix;
+    if (!image.save(filename.str().c_str())) {
+      OCTOMAP_ERROR("Could not write image %s\n", filename.str().c_str());
+      exit(1);
+    }
+    cout << "Wrote " << filename.str() << endl;
+  }
+
+  delete drawer;
+  delete tree;
+  return 0;
+}